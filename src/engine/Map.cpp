@@ -22,10 +22,14 @@
 #include "graphics/mesh.h"
 #include "graphics/shaders.h"
 #include "graphics/texture_atlas.h"
+#include "loaders/loaders.h"
+#include "mod_support.h"
 
 using namespace openhow;
 
 Map::Map( MapManifest* manifest ) : manifest_( manifest ) {
+	hwResourceManager::LoadContext loadContext( "Map" );
+
 	std::string base_path = "maps/" + manifest_->filename + "/";
 
 	std::string tilePath = manifest_->tile_directory;
@@ -129,15 +133,6 @@ void Map::UpdateSkyModel( PLModel* model ) {
 }
 
 void Map::UpdateLighting() {
-	PLShaderProgram* program = Shaders_GetProgram( "generic_textured_lit" )->GetInternalProgram();
-	if ( program == nullptr ) {
-		return;
-	}
-
-	plSetNamedShaderUniformVector4( program, "fog_colour", manifest_->fog_colour.ToVec4() );
-	plSetNamedShaderUniformFloat( program, "fog_near", manifest_->fog_intensity );
-	plSetNamedShaderUniformFloat( program, "fog_far", manifest_->fog_distance );
-
 	PLVector3 sun_position( 1.0f, -manifest_->sun_pitch, 0 );
 	PLMatrix4 sun_matrix =
 		plMultiplyMatrix4(
@@ -148,56 +143,44 @@ void Map::UpdateLighting() {
 #if 0
 	debug_sun_position = sun_position;
 #endif
-	plSetNamedShaderUniformVector3( program, "sun_position", sun_position );
-	plSetNamedShaderUniformVector4( program, "sun_colour", manifest_->sun_colour.ToVec4() );
 
-	plSetNamedShaderUniformVector4( program, "ambient_colour", manifest_->ambient_colour.ToVec4() );
-}
+	// Terrain may be drawn with either of these, depending on how its tiles are stored
+	static const char* lit_programs[] = { "generic_textured_lit", "terrain_array" };
+	for ( const auto& name : lit_programs ) {
+		ShaderProgram* shaderProgram = Shaders_GetProgram( name );
+		PLShaderProgram* program = shaderProgram != nullptr ? shaderProgram->GetInternalProgram() : nullptr;
+		if ( program == nullptr ) {
+			continue;
+		}
 
-void Map::LoadSpawns( const std::string& path ) {
-	struct PogIndex {
-		char name[16];               // class name
-		char unused0[16];
-		int16_t position[3];            // position in the world
-		uint16_t index;                  // todo
-		int16_t angles[3];              // angles in the world
-		uint16_t type;                   // todo
-		int16_t bounds[3];              // collision bounds
-		uint16_t bounds_type;            // box, prism, sphere and none
-		int16_t energy;
-		uint8_t appearance;
-		uint8_t team;                   // uk, usa, german, french, japanese, soviet
-		uint16_t objective;
-		uint8_t objective_actor_id;
-		uint8_t objective_extra[2];
-		uint8_t unused1;
-		uint16_t unused2[8];
-		int16_t fallback_position[3];
-		int16_t extra;
-		int16_t attached_actor_num;
-		int16_t unused3;
-	};
-	static_assert( sizeof( PogIndex ) == 94, "Invalid size for PogIndex, should be 94 bytes!" );
-
-	const char* cPath = path.c_str();
-	PLFile* fp = plOpenFile( cPath, false );
-	if ( fp == NULL ) {
-		LogWarn( "Failed to open actor data, \"%s\" (%s)!\n", cPath, plGetError() );
-		return;
+		plSetNamedShaderUniformVector4( program, "fog_colour", manifest_->fog_colour.ToVec4() );
+		plSetNamedShaderUniformFloat( program, "fog_near", manifest_->fog_intensity );
+		plSetNamedShaderUniformFloat( program, "fog_far", manifest_->fog_distance );
+
+		plSetNamedShaderUniformVector3( program, "sun_position", sun_position );
+		plSetNamedShaderUniformVector4( program, "sun_colour", manifest_->sun_colour.ToVec4() );
+
+		plSetNamedShaderUniformVector4( program, "ambient_colour", manifest_->ambient_colour.ToVec4() );
 	}
+}
 
-	bool status = false;
-	uint16_t num_indices = plReadInt16( fp, false, &status );
-	if ( !status ) {
-		Error( "Failed to read Pog indices count in \"%s\" (%s)!\n", cPath, plGetError() );
+void Map::LoadSpawns( const std::string& path ) {
+	const void* data;
+	size_t size;
+	PogHandle* pog;
+	if ( Mod_MapFile( path.c_str(), &data, &size ) ) {
+		pog = Pog_LoadMemory( data, size, path.c_str(), nullptr );
+	} else {
+		pog = Pog_LoadFile( path.c_str(), nullptr );
 	}
 
-	std::vector<PogIndex> spawns( num_indices );
-	if ( plReadFile( fp, spawns.data(), sizeof( PogIndex ), num_indices ) != num_indices ) {
-		Error( "Failed to read Pog spawns in \"%s\" (%s)!\n", cPath, plGetError() );
+	if ( pog == nullptr ) {
+		LogWarn( "Failed to load actor data, \"%s\"!\n", path.c_str() );
+		return;
 	}
 
-	plCloseFile( fp );
+	PogSpawn* spawns = pog->spawns;
+	unsigned int num_indices = pog->num_spawns;
 
 	spawns_.resize( num_indices );
 
@@ -233,6 +216,8 @@ void Map::LoadSpawns( const std::string& path ) {
 		}
 		spawns_[ i ].bounds_type = spawns[ i ].bounds_type;
 	}
+
+	Pog_DestroyHandle( pog, nullptr );
 }
 
 void Map::Draw() {
@@ -0,0 +1,565 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include <PL/platform_filesystem.h>
+
+#include "engine.h"
+#include "animation.h"
+#include "loaders/loaders.h"
+#include "mod_support.h"
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define ANIMATION_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+static_assert( sizeof( PLQuaternion ) == sizeof( float ) * 4, "Unexpected PLQuaternion layout!" );
+
+static Animation animations[static_cast<unsigned int>(AnimationIndex::MAX_ANIMATIONS)];
+static unsigned int numAnimations = 0;
+
+static HirHandle *skeleton = nullptr;
+
+enum {
+	ANIMATION_STATE_UNCACHED,
+	ANIMATION_STATE_CACHED,
+	ANIMATION_STATE_FAILED,
+};
+
+// Actors think across the job workers, so any of them may be the first
+// to ask for the animations. Only one gets to load them, and the rest
+// wait until it's done rather than seeing them half loaded
+static std::atomic<int> animationState( ANIMATION_STATE_UNCACHED );
+static std::mutex animationMutex;
+
+static void Animation_ClearCache() {
+	for ( unsigned int i = 0; i < numAnimations; ++i ) {
+		u_free( animations[ i ].frames );
+	}
+	numAnimations = 0;
+
+	Hir_DestroyHandle( skeleton, nullptr );
+	skeleton = nullptr;
+}
+
+/**
+ * Vtx models are scaled and flipped on the x and y axes when
+ * loaded, so the skeleton and rotations need to match.
+ */
+static PLQuaternion Animation_FlipRotation( float x, float y, float z, float w ) {
+	PLQuaternion rotation;
+	rotation.x = -x;
+	rotation.y = -y;
+	rotation.z = z;
+	rotation.w = w;
+	return rotation;
+}
+
+static bool Animation_LoadMcap( const char *path ) {
+	PLFile *file = plOpenFile( path, false );
+	if ( file == nullptr ) {
+		LogWarn( "Failed to load \"%s\" (%s)!\n", path, plGetError() );
+		return false;
+	}
+
+	// basically a MAD package, but without the file name
+	typedef struct __attribute__((packed)) McapIndex {
+		uint32_t offset;
+		uint32_t length;
+	} McapIndex;
+
+	typedef struct __attribute__((packed)) McapKeyframe {
+		int16_t unused;
+
+		struct __attribute__((packed)) {
+			int8_t x;
+			int8_t y;
+			int8_t z;
+		} transforms[10];
+
+		struct __attribute__((packed)) {
+			float x;
+			float y;
+			float z;
+			float w;
+		} rotations[15];
+	} McapKeyframe;
+	static_assert( sizeof( McapKeyframe ) == 272, "Invalid McapKeyframe size!" );
+
+	size_t size = plGetFileSize( file );
+	std::vector<uint8_t> buf( size );
+	if ( size < sizeof( McapIndex ) || plReadFile( file, buf.data(), 1, size ) != size ) {
+		LogWarn( "Failed to read \"%s\"!\n", path );
+		plCloseFile( file );
+		return false;
+	}
+	plCloseFile( file );
+
+	// The index table runs up until the first animation
+	const McapIndex *indices = reinterpret_cast<const McapIndex *>(buf.data());
+	unsigned int numIndices = indices[ 0 ].offset / sizeof( McapIndex );
+	if ( numIndices == 0 || numIndices * sizeof( McapIndex ) > size ) {
+		LogWarn( "Invalid index table in \"%s\"!\n", path );
+		return false;
+	}
+
+	if ( numIndices > plArrayElements( animations ) ) {
+		LogWarn( "Too many animations in \"%s\", ignoring the remainder (%u/%u)!\n",
+				 path, numIndices, plArrayElements( animations ) );
+		numIndices = plArrayElements( animations );
+	}
+
+	for ( unsigned int i = 0; i < numIndices; ++i ) {
+		unsigned int numKeyframes = indices[ i ].length / sizeof( McapKeyframe );
+		if ( numKeyframes == 0 || indices[ i ].offset + indices[ i ].length > size ) {
+			LogWarn( "Invalid animation at index %u in \"%s\"!\n", i, path );
+			return false;
+		}
+
+		Animation *animation = &animations[ i ];
+		animation->id = i;
+		animation->name = Model_GetAnimationDescription( i );
+		animation->num_frames = numKeyframes;
+		animation->frames = static_cast<Keyframe *>(u_alloc( numKeyframes, sizeof( Keyframe ), true ));
+
+		const McapKeyframe *frames = reinterpret_cast<const McapKeyframe *>(buf.data() + indices[ i ].offset);
+		for ( unsigned int j = 0; j < numKeyframes; ++j ) {
+			for ( unsigned int k = 0; k < 10; ++k ) {
+				animation->frames[ j ].transforms[ k ] = PLVector3(
+					frames[ j ].transforms[ k ].x, frames[ j ].transforms[ k ].y, frames[ j ].transforms[ k ].z );
+			}
+
+			for ( unsigned int k = 0; k < 15; ++k ) {
+				animation->frames[ j ].rotations[ k ] = Animation_FlipRotation(
+					frames[ j ].rotations[ k ].x, frames[ j ].rotations[ k ].y,
+					frames[ j ].rotations[ k ].z, frames[ j ].rotations[ k ].w );
+			}
+		}
+
+		numAnimations++;
+	}
+
+	return true;
+}
+
+static bool Animation_LoadCache() {
+	const void* data;
+	size_t size;
+	if ( Mod_MapFile( "chars/pig.hir", &data, &size ) ) {
+		skeleton = Hir_LoadMemory( data, size, "chars/pig.hir", nullptr );
+	} else {
+		skeleton = Hir_LoadFile( "chars/pig.hir", nullptr );
+	}
+	if ( skeleton == nullptr ) {
+		LogWarn( "Failed to load skeleton, animations will be unavailable!\n" );
+		return false;
+	}
+
+	for ( unsigned int i = 0; i < skeleton->num_bones; ++i ) {
+		PLModelBone *bone = &skeleton->bones[ i ];
+		if ( bone->parent < 0 || static_cast<unsigned int>(bone->parent) > i ) {
+			LogWarn( "Unexpected parent for bone %u (%d), animations will be unavailable!\n", i, bone->parent );
+			Animation_ClearCache();
+			return false;
+		}
+
+		// Match the Vtx models, see Model_CookVtxFile
+		bone->position *= .5f;
+		bone->position.x *= -1;
+		bone->position.y *= -1;
+	}
+
+	if ( !Animation_LoadMcap( "chars/mcap.mad" ) ) {
+		LogWarn( "Failed to load animations!\n" );
+		Animation_ClearCache();
+		return false;
+	}
+
+	LogInfo( "Cached %u animations\n", numAnimations );
+	return true;
+}
+
+/**
+ * Loads the skeleton and animations on first use, since
+ * they're shared between every pig.
+ */
+static bool Animation_Cache() {
+	int state = animationState.load( std::memory_order_acquire );
+	if ( state != ANIMATION_STATE_UNCACHED ) {
+		return ( state == ANIMATION_STATE_CACHED );
+	}
+
+	std::lock_guard<std::mutex> lock( animationMutex );
+	state = animationState.load( std::memory_order_relaxed );
+	if ( state == ANIMATION_STATE_UNCACHED ) {
+		state = Animation_LoadCache() ? ANIMATION_STATE_CACHED : ANIMATION_STATE_FAILED;
+		animationState.store( state, std::memory_order_release );
+	}
+
+	return ( state == ANIMATION_STATE_CACHED );
+}
+
+bool Animation_IsAvailable() {
+	return Animation_Cache();
+}
+
+const Animation *Animation_GetAnimation( AnimationIndex index ) {
+	if ( !Animation_Cache() ) {
+		return nullptr;
+	}
+
+	unsigned int i = static_cast<unsigned int>(index);
+	if ( i >= numAnimations ) {
+		return nullptr;
+	}
+
+	return &animations[ i ];
+}
+
+/**
+ * Spherical interpolation between two sets of rotations,
+ * taking the shortest path.
+ */
+void Animation_SlerpRotations( const PLQuaternion *a, const PLQuaternion *b, float t, PLQuaternion *out,
+                               unsigned int count ) {
+	for ( unsigned int i = 0; i < count; ++i ) {
+#if defined( ANIMATION_USE_SSE )
+		__m128 qa = _mm_loadu_ps( &a[ i ].x );
+		__m128 qb = _mm_loadu_ps( &b[ i ].x );
+
+		__m128 d = _mm_mul_ps( qa, qb );
+		d = _mm_add_ps( d, _mm_shuffle_ps( d, d, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		d = _mm_add_ps( d, _mm_shuffle_ps( d, d, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		float dot = _mm_cvtss_f32( d );
+		if ( dot < 0.0f ) {
+			qb = _mm_sub_ps( _mm_setzero_ps(), qb );
+			dot = -dot;
+		}
+#else
+		PLQuaternion qb = b[ i ];
+		float dot = a[ i ].x * qb.x + a[ i ].y * qb.y + a[ i ].z * qb.z + a[ i ].w * qb.w;
+		if ( dot < 0.0f ) {
+			qb.x = -qb.x;
+			qb.y = -qb.y;
+			qb.z = -qb.z;
+			qb.w = -qb.w;
+			dot = -dot;
+		}
+#endif
+
+		// Fall back to a linear interpolation when they're close enough
+		float wa = 1.0f - t, wb = t;
+		if ( dot < 0.9995f ) {
+			float theta = acosf( dot );
+			float invSin = 1.0f / sinf( theta );
+			wa = sinf( wa * theta ) * invSin;
+			wb = sinf( wb * theta ) * invSin;
+		}
+
+#if defined( ANIMATION_USE_SSE )
+		__m128 r = _mm_add_ps( _mm_mul_ps( qa, _mm_set1_ps( wa ) ), _mm_mul_ps( qb, _mm_set1_ps( wb ) ) );
+
+		__m128 l = _mm_mul_ps( r, r );
+		l = _mm_add_ps( l, _mm_shuffle_ps( l, l, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		l = _mm_add_ps( l, _mm_shuffle_ps( l, l, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		r = _mm_div_ps( r, _mm_sqrt_ps( l ) );
+
+		_mm_storeu_ps( &out[ i ].x, r );
+#else
+		PLQuaternion r;
+		r.x = a[ i ].x * wa + qb.x * wb;
+		r.y = a[ i ].y * wa + qb.y * wb;
+		r.z = a[ i ].z * wa + qb.z * wb;
+		r.w = a[ i ].w * wa + qb.w * wb;
+
+		float invLength = 1.0f / sqrtf( r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w );
+		out[ i ].x = r.x * invLength;
+		out[ i ].y = r.y * invLength;
+		out[ i ].z = r.z * invLength;
+		out[ i ].w = r.w * invLength;
+#endif
+	}
+}
+
+/**
+ * Find the two keyframes either side of the given time, in seconds,
+ * and how far we are between them.
+ */
+static void Animation_GetKeyframes( const Animation *animation, float time, bool loop,
+									unsigned int *a, unsigned int *b, float *delta ) {
+	u_assert( animation != nullptr && animation->num_frames > 0 );
+
+	float frame = time * ANIMATION_FRAMES_PER_SECOND;
+	if ( frame < 0.0f ) {
+		frame = 0.0f;
+	}
+
+	unsigned int numFrames = animation->num_frames;
+	if ( loop ) {
+		frame = fmodf( frame, static_cast<float>(numFrames) );
+	} else if ( frame > static_cast<float>(numFrames - 1) ) {
+		frame = static_cast<float>(numFrames - 1);
+	}
+
+	*a = static_cast<unsigned int>(frame) % numFrames;
+	*b = *a + 1;
+	if ( *b >= numFrames ) {
+		*b = loop ? 0 : numFrames - 1;
+	}
+
+	*delta = frame - floorf( frame );
+}
+
+/**
+ * Sample the pose at the given time, in seconds, interpolating
+ * between the two closest keyframes.
+ */
+void Animation_SamplePose( const Animation *animation, float time, bool loop, AnimationPose *out ) {
+	unsigned int a, b;
+	float delta;
+	Animation_GetKeyframes( animation, time, loop, &a, &b, &delta );
+
+	Animation_SlerpRotations( animation->frames[ a ].rotations, animation->frames[ b ].rotations,
+							  delta, out->rotations, ANIMATION_MAX_BONES );
+}
+
+void Animation_BlendPoses( const AnimationPose *a, const AnimationPose *b, float weight, AnimationPose *out ) {
+	Animation_SlerpRotations( a->rotations, b->rotations, weight, out->rotations, ANIMATION_MAX_BONES );
+}
+
+/**
+ * Produces a column-major rotation and translation matrix.
+ */
+static void Animation_ComposeMatrix( const PLQuaternion &q, const PLVector3 &t, float *m ) {
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	m[ 0 ] = 1.0f - 2.0f * ( yy + zz );
+	m[ 1 ] = 2.0f * ( xy + wz );
+	m[ 2 ] = 2.0f * ( xz - wy );
+	m[ 3 ] = 0.0f;
+
+	m[ 4 ] = 2.0f * ( xy - wz );
+	m[ 5 ] = 1.0f - 2.0f * ( xx + zz );
+	m[ 6 ] = 2.0f * ( yz + wx );
+	m[ 7 ] = 0.0f;
+
+	m[ 8 ] = 2.0f * ( xz + wy );
+	m[ 9 ] = 2.0f * ( yz - wx );
+	m[ 10 ] = 1.0f - 2.0f * ( xx + yy );
+	m[ 11 ] = 0.0f;
+
+	m[ 12 ] = t.x;
+	m[ 13 ] = t.y;
+	m[ 14 ] = t.z;
+	m[ 15 ] = 1.0f;
+}
+
+static void Animation_MultiplyMatrix( const float *a, const float *b, float *out ) {
+	for ( unsigned int column = 0; column < 4; ++column ) {
+		for ( unsigned int row = 0; row < 4; ++row ) {
+			out[ column * 4 + row ] =
+				a[ row ] * b[ column * 4 ] +
+				a[ 4 + row ] * b[ column * 4 + 1 ] +
+				a[ 8 + row ] * b[ column * 4 + 2 ] +
+				a[ 12 + row ] * b[ column * 4 + 3 ];
+		}
+	}
+}
+
+/**
+ * Walk the skeleton to produce the final matrix for each bone.
+ * Vtx vertices are stored relative to the bone they're attached
+ * to, so there's no inverse bind pose to apply here.
+ */
+void Animation_BuildPalette( const AnimationPose *pose, AnimationPalette *out ) {
+	for ( unsigned int i = 0; i < ANIMATION_MAX_BONES; ++i ) {
+		out->bones[ i ].Identity();
+	}
+
+	if ( !Animation_Cache() ) {
+		return;
+	}
+
+	unsigned int numBones = std::min( skeleton->num_bones, ANIMATION_MAX_BONES );
+	for ( unsigned int i = 0; i < numBones; ++i ) {
+		const PLModelBone &bone = skeleton->bones[ i ];
+
+		float local[16];
+		Animation_ComposeMatrix( pose->rotations[ i ], bone.position, local );
+
+		if ( static_cast<unsigned int>(bone.parent) == i ) {
+			memcpy( out->bones[ i ].m, local, sizeof( local ) );
+			continue;
+		}
+
+		Animation_MultiplyMatrix( out->bones[ bone.parent ].m, local, out->bones[ i ].m );
+	}
+}
+
+/* Pose Cache
+ *
+ * Pigs tend to be playing the same few cycles at once, so the
+ * time between each keyframe is split into a number of buckets
+ * and the palette for each is only evaluated once per tick,
+ * then shared between every actor that lands in it.
+ */
+
+#define ANIMATION_POSE_BUCKETS 8
+
+static std::unordered_map<uint32_t, const AnimationPalette *> poseCacheLookup;
+static std::deque<AnimationPalette> poseCache;
+static unsigned int poseCacheTick = UINT32_MAX;
+
+static unsigned int poseCacheHits = 0;
+static unsigned int poseCacheMisses = 0;
+
+// Actors think in parallel, and may all be after the same palette
+static std::mutex poseCacheMutex;
+
+static void Animation_ClearPoseCache() {
+	poseCacheLookup.clear();
+	poseCache.clear();
+}
+
+/**
+ * Fetch the palette for the given time, evaluating it
+ * if nothing else has needed it yet this tick.
+ * @return Pointer to the palette, valid until the next tick.
+ */
+const AnimationPalette *Animation_GetCachedPalette( const Animation *animation, float time, bool loop ) {
+	std::lock_guard<std::mutex> lock( poseCacheMutex );
+
+	if ( poseCacheTick != g_state.sim_ticks ) {
+		Animation_ClearPoseCache();
+		poseCacheTick = g_state.sim_ticks;
+	}
+
+	unsigned int a, b;
+	float delta;
+	Animation_GetKeyframes( animation, time, loop, &a, &b, &delta );
+
+	unsigned int bucket = std::min( static_cast<unsigned int>(delta * ANIMATION_POSE_BUCKETS),
+									static_cast<unsigned int>(ANIMATION_POSE_BUCKETS - 1) );
+	uint32_t key = ( animation->id << 20 ) | ( ( a & 0xFFFF ) << 4 ) | ( bucket << 1 ) | ( loop ? 1 : 0 );
+
+	auto i = poseCacheLookup.find( key );
+	if ( i != poseCacheLookup.end() ) {
+		poseCacheHits++;
+		return i->second;
+	}
+
+	poseCacheMisses++;
+
+	AnimationPose pose;
+	Animation_SlerpRotations( animation->frames[ a ].rotations, animation->frames[ b ].rotations,
+							  static_cast<float>(bucket) / ANIMATION_POSE_BUCKETS, pose.rotations, ANIMATION_MAX_BONES );
+
+	poseCache.emplace_back();
+	AnimationPalette *palette = &poseCache.back();
+	Animation_BuildPalette( &pose, palette );
+
+	poseCacheLookup.emplace( key, palette );
+	return palette;
+}
+
+/* Benchmarking */
+
+static void BenchmarkAnimationCommand( unsigned int argc, char **argv ) {
+	unsigned int numActors = 64;
+	if ( argc > 1 ) {
+		numActors = std::max( 1, atoi( argv[ 1 ] ) );
+	}
+
+	unsigned int numTicks = TICKS_PER_SECOND * 10;
+	if ( argc > 2 ) {
+		numTicks = std::max( 1, atoi( argv[ 2 ] ) );
+	}
+
+	const Animation *idle = Animation_GetAnimation( AnimationIndex::ANI_IDLE1 );
+	const Animation *run = Animation_GetAnimation( AnimationIndex::ANI_RUN_NORMAL );
+	if ( idle == nullptr || run == nullptr ) {
+		LogWarn( "Animations are unavailable, can't run benchmark!\n" );
+		return;
+	}
+
+	// Most pigs idle, the rest run, and they've started at a handful
+	// of different times, much as they would in-game
+	struct BenchmarkActor {
+		const Animation *animation;
+		float time;
+	};
+	std::vector<BenchmarkActor> actors( numActors );
+	for ( unsigned int i = 0; i < numActors; ++i ) {
+		actors[ i ].animation = ( i % 4 == 0 ) ? run : idle;
+		actors[ i ].time = static_cast<float>(i % 5) * 0.37f;
+	}
+
+	std::vector<AnimationPalette> palettes( numActors );
+
+	auto start = std::chrono::steady_clock::now();
+	for ( unsigned int tick = 0; tick < numTicks; ++tick ) {
+		for ( unsigned int i = 0; i < numActors; ++i ) {
+			AnimationPose pose;
+			Animation_SamplePose( actors[ i ].animation, actors[ i ].time + tick * ( 1.0f / TICKS_PER_SECOND ), true, &pose );
+			Animation_BuildPalette( &pose, &palettes[ i ] );
+		}
+	}
+	std::chrono::duration<double, std::milli> actorMs = std::chrono::steady_clock::now() - start;
+
+	poseCacheHits = poseCacheMisses = 0;
+
+	start = std::chrono::steady_clock::now();
+	for ( unsigned int tick = 0; tick < numTicks; ++tick ) {
+		Animation_ClearPoseCache();
+		for ( unsigned int i = 0; i < numActors; ++i ) {
+			const AnimationPalette *palette = Animation_GetCachedPalette(
+				actors[ i ].animation, actors[ i ].time + tick * ( 1.0f / TICKS_PER_SECOND ), true );
+			palettes[ i ] = *palette;
+		}
+	}
+	std::chrono::duration<double, std::milli> cachedMs = std::chrono::steady_clock::now() - start;
+
+	// Don't leave anything behind for the game
+	Animation_ClearPoseCache();
+	poseCacheTick = UINT32_MAX;
+
+	LogInfo( "%u actors over %u ticks: per-actor %.4fms, cached %.4fms per tick (%u hits, %u misses)\n",
+			 numActors, numTicks, actorMs.count() / numTicks, cachedMs.count() / numTicks,
+			 poseCacheHits, poseCacheMisses );
+}
+
+void Animation_Initialize() {
+	plRegisterConsoleCommand( "BenchmarkAnimation", BenchmarkAnimationCommand,
+							  "Compare per-actor pose evaluation against the shared pose cache. "
+							  "BenchmarkAnimation [actors] [ticks]" );
+}
+
+void Animation_Shutdown() {
+	Animation_ClearPoseCache();
+	Animation_ClearCache();
+
+	animationState = ANIMATION_STATE_UNCACHED;
+}
@@ -0,0 +1,56 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "model.h"
+
+/* Animation
+ *
+ * Pig animations are all stored in a single mcap.mad, which is
+ * loaded once and shared between every pig, alongside the
+ * skeleton from pig.hir. Poses are sampled from the keyframes
+ * and turned into a palette of bone matrices for skinning
+ * on the GPU.
+ */
+
+#define ANIMATION_FRAMES_PER_SECOND 25
+
+#define ANIMATION_MAX_BONES         static_cast<unsigned int>(SkeletonBone::MAX_BONES)
+
+struct AnimationPose {
+	PLQuaternion rotations[ANIMATION_MAX_BONES];
+};
+
+struct AnimationPalette {
+	PLMatrix4 bones[ANIMATION_MAX_BONES];
+};
+
+bool Animation_IsAvailable();
+const Animation *Animation_GetAnimation( AnimationIndex index );
+
+void Animation_SamplePose( const Animation *animation, float time, bool loop, AnimationPose *out );
+void Animation_BlendPoses( const AnimationPose *a, const AnimationPose *b, float weight, AnimationPose *out );
+void Animation_BuildPalette( const AnimationPose *pose, AnimationPalette *out );
+
+const AnimationPalette *Animation_GetCachedPalette( const Animation *animation, float time, bool loop );
+
+void Animation_SlerpRotations( const PLQuaternion *a, const PLQuaternion *b, float t, PLQuaternion *out,
+                               unsigned int count );
+
+void Animation_Initialize();
+void Animation_Shutdown();
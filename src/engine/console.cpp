@@ -158,6 +158,7 @@ PLConsoleVariable* cv_debug_skeleton = nullptr;
 PLConsoleVariable* cv_debug_input = nullptr;
 PLConsoleVariable* cv_debug_cache = nullptr;
 PLConsoleVariable* cv_debug_shaders = nullptr;
+PLConsoleVariable* cv_debug_hot_reload = nullptr;
 
 PLConsoleVariable* cv_game_language = nullptr;
 
@@ -179,8 +180,11 @@ PLConsoleVariable* cv_graphics_draw_world = nullptr;
 PLConsoleVariable* cv_graphics_draw_sprites = nullptr;
 PLConsoleVariable* cv_graphics_draw_audio_sources = nullptr;
 PLConsoleVariable* cv_graphics_texture_filter = nullptr;
+PLConsoleVariable* cv_graphics_texture_compression = nullptr;
 PLConsoleVariable* cv_graphics_alpha_to_coverage = nullptr;
 PLConsoleVariable* cv_graphics_debug_normals = nullptr;
+PLConsoleVariable* cv_graphics_animation_cache = nullptr;
+PLConsoleVariable* cv_graphics_terrain_array = nullptr;
 
 PLConsoleVariable* cv_audio_volume = nullptr;
 PLConsoleVariable* cv_audio_volume_sfx = nullptr;
@@ -229,6 +233,8 @@ void Console_Initialize(void) {
   );
   rvar(cv_debug_cache, false, "0", pl_bool_var, nullptr, "display memory and other info");
   rvar(cv_debug_shaders, false, "-1", pl_int_var, nullptr, "Forces specified GLSL shader on all draw calls.");
+  rvar(cv_debug_hot_reload, true, "false", pl_bool_var, nullptr,
+       "Watch mounted mod directories and reload textures, models and shaders when they change on disk");
 
   rvar(cv_game_language, true, "eng", pl_string_var, &LanguageManager::SetLanguageCallback, "Set the language");
 
@@ -250,8 +256,16 @@ void Console_Initialize(void) {
 	rvar( cv_graphics_draw_sprites, false, "true", pl_bool_var, nullptr, "Toggles rendering of sprites." );
 	rvar( cv_graphics_draw_audio_sources, false, "false", pl_bool_var, nullptr, "toggles rendering of audio sources" );
 	rvar( cv_graphics_texture_filter, true, "false", pl_bool_var, nullptr, "Filter level/model textures?" );
+	rvar( cv_graphics_texture_compression, true, "0", pl_int_var, nullptr,
+		  "Use the compressed texture cache?\n"
+		  "0: disabled\n1: upload compressed textures\n2: decompress in software" );
 	rvar( cv_graphics_alpha_to_coverage, true, "false", pl_bool_var, nullptr, "Enable/disable alpha-to-coverage" );
 	rvar( cv_graphics_debug_normals, false, "false", pl_bool_var, nullptr, "Forces normals to be displayed" );
+	rvar( cv_graphics_animation_cache, false, "true", pl_bool_var, nullptr,
+		  "Share evaluated poses between actors playing the same animation" );
+	rvar( cv_graphics_terrain_array, true, "false", pl_bool_var, nullptr,
+		  "Store terrain tiles as layers of an array texture, rather than in an atlas\n"
+		  "Requires GL 3.0, takes effect on the next map load" );
 
 	rvar( cv_audio_volume, true, "1", pl_float_var, nullptr, "set global audio volume" );
 	rvar( cv_audio_volume_sfx, true, "1", pl_float_var, nullptr, "set sfx audio volume" );
@@ -25,6 +25,7 @@ extern PLConsoleVariable *cv_debug_skeleton;
 extern PLConsoleVariable *cv_debug_input;
 extern PLConsoleVariable *cv_debug_cache;
 extern PLConsoleVariable *cv_debug_shaders;
+extern PLConsoleVariable *cv_debug_hot_reload;
 
 extern PLConsoleVariable *cv_game_language;
 
@@ -46,8 +47,11 @@ extern PLConsoleVariable* cv_graphics_draw_world;
 extern PLConsoleVariable* cv_graphics_draw_sprites;
 extern PLConsoleVariable* cv_graphics_draw_audio_sources;
 extern PLConsoleVariable *cv_graphics_texture_filter;
+extern PLConsoleVariable *cv_graphics_texture_compression;
 extern PLConsoleVariable *cv_graphics_alpha_to_coverage;
 extern PLConsoleVariable *cv_graphics_debug_normals;
+extern PLConsoleVariable *cv_graphics_animation_cache;
+extern PLConsoleVariable *cv_graphics_terrain_array;
 
 extern PLConsoleVariable *cv_audio_volume;
 extern PLConsoleVariable *cv_audio_volume_sfx;
@@ -46,7 +46,7 @@ ModelViewer::ModelViewer() : BaseWindow() {
 }
 
 ModelViewer::~ModelViewer() {
-	plDestroyModel( modelPtr );
+	Model_Destroy( modelPtr );
 	plDestroyTexture( textureAttachment );
 	plDestroyFrameBuffer( drawBuffer );
 }
@@ -135,7 +135,7 @@ void ModelViewer::Display() {
 				}
 
 				if ( ImGui::Selectable( i.c_str(), selected ) ) {
-					plDestroyModel( modelPtr );
+					Model_Destroy( modelPtr );
 					modelPtr = nullptr;
 
 					modelPtr = plLoadModel( i.c_str() );
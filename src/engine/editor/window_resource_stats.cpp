@@ -0,0 +1,99 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../engine.h"
+#include "window_resource_stats.h"
+
+using namespace openhow;
+
+ResourceStatsWindow::ResourceStatsWindow() = default;
+ResourceStatsWindow::~ResourceStatsWindow() = default;
+
+void ResourceStatsWindow::Display() {
+	ImGui::SetNextWindowSize( ImVec2( 640, 480 ), ImGuiCond_Once );
+	ImGui::Begin( dname( "Resource Statistics" ), &status_, ED_DEFAULT_WINDOW_FLAGS );
+
+	std::vector<std::pair<std::string, hwResourceManager::ResourceStats>> stats =
+		Engine::Resource()->GetSortedStats();
+	if ( stats.empty() ) {
+		ImGui::TextColored( ImVec4( 1.0f, 0, 0, 1.0f ), "No resources loaded..." );
+		ImGui::End();
+		return;
+	}
+
+	unsigned int hits = 0, misses = 0;
+	double loadTime = 0;
+	size_t bytes = 0;
+	for ( const auto& i : stats ) {
+		hits += i.second.hits;
+		misses += i.second.misses;
+		loadTime += i.second.load_ms;
+		bytes += i.second.bytes;
+	}
+
+	ImGui::Text( "%u Resources, %u hits, %u misses", ( unsigned int ) stats.size(), hits, misses );
+	ImGui::Text( "Load Time: %.2fms", loadTime );
+	ImGui::Text( "Size: %ukB", ( unsigned int ) plBytesToKilobytes( bytes ) );
+
+	ImGui::Checkbox( "Textures", &showTextures );
+	ImGui::SameLine();
+	ImGui::Checkbox( "Models", &showModels );
+	ImGui::SameLine();
+	if ( ImGui::Button( "Dump" ) ) {
+		Engine::Resource()->DumpStats();
+	}
+
+	ImGui::Separator();
+
+	ImGui::BeginChild( "Resources" );
+	ImGui::Columns( 7 );
+	ImGui::Text( "Path" ); ImGui::NextColumn();
+	ImGui::Text( "Hits" ); ImGui::NextColumn();
+	ImGui::Text( "Misses" ); ImGui::NextColumn();
+	ImGui::Text( "Decode" ); ImGui::NextColumn();
+	ImGui::Text( "Upload" ); ImGui::NextColumn();
+	ImGui::Text( "Total" ); ImGui::NextColumn();
+	ImGui::Text( "Size" ); ImGui::NextColumn();
+	ImGui::Separator();
+
+	for ( const auto& i : stats ) {
+		const hwResourceManager::ResourceStats& resource = i.second;
+		if ( ( resource.type == hwResourceManager::ResourceStats::TEXTURE && !showTextures ) ||
+			( resource.type == hwResourceManager::ResourceStats::MODEL && !showModels ) ) {
+			continue;
+		}
+
+		ImGui::TextUnformatted( i.first.c_str() );
+		if ( ImGui::IsItemHovered() ) {
+			ImGui::BeginTooltip();
+			ImGui::Text( "Context: %s", resource.context.c_str() );
+			ImGui::EndTooltip();
+		}
+		ImGui::NextColumn();
+		ImGui::Text( "%u", resource.hits ); ImGui::NextColumn();
+		ImGui::Text( "%u", resource.misses ); ImGui::NextColumn();
+		ImGui::Text( "%.2fms", resource.decode_ms ); ImGui::NextColumn();
+		ImGui::Text( "%.2fms", resource.upload_ms ); ImGui::NextColumn();
+		ImGui::Text( "%.2fms", resource.load_ms ); ImGui::NextColumn();
+		ImGui::Text( "%ukB", ( unsigned int ) plBytesToKilobytes( resource.bytes ) ); ImGui::NextColumn();
+	}
+
+	ImGui::Columns( 1 );
+	ImGui::EndChild();
+
+	ImGui::End();
+}
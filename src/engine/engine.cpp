@@ -15,6 +15,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "engine.h"
 #include "language.h"
 #include "mod_support.h"
@@ -24,6 +26,9 @@
 #include "frontend.h"
 #include "Map.h"
 #include "imgui_layer.h"
+#include "hot_reload.h"
+#include "animation.h"
+#include "loaders/loaders.h"
 
 #include "graphics/display.h"
 #include "game/actor_manager.h"
@@ -46,28 +51,41 @@ openhow::Engine::Engine() {
 }
 
 openhow::Engine::~Engine() {
+	HotReload_Shutdown();
+
 	Display_Shutdown();
 
 	Config_Save( Config_GetUserConfigPath() );
 
 	delete game_manager_;
+	Animation_Shutdown();
 	delete audio_manager_;
 	delete resource_manager_;
 
 	IPhysicsInterface::DestroyInstance( physics_interface_ );
 	LanguageManager::DestroyInstance();
+
+	delete job_system_;
 }
 
 void openhow::Engine::Initialize() {
 	LogInfo( "Initializing Engine (%s)...\n", GetVersionString().c_str() );
 
+	const char *var;
+
 	Console_Initialize();
 
+	// The main thread helps out whenever it waits, so leave a core for it
+	unsigned int numWorkers = std::max( std::thread::hardware_concurrency(), 1U ) - 1;
+	if ( ( var = plGetCommandLineArgumentValue( "-jobs" ) ) != nullptr ) {
+		numWorkers = strtoul( var, nullptr, 10 );
+	}
+	job_system_ = new JobSystem( numWorkers );
+
 	// load in the manifests
 	Mod_RegisterMods();
 
 	// check for any command line arguments
-	const char *var;
 	if ( ( var = plGetCommandLineArgumentValue( "-mod" ) ) == nullptr ) {
 		// otherwise default to base campaign
 		var = "how";
@@ -88,6 +106,9 @@ void openhow::Engine::Initialize() {
 	Input_Initialize();
 	Display_Initialize();
 	resource_manager_ = new hwResourceManager();
+	HotReload_Initialize();
+	Animation_Initialize();
+	Loaders_Initialize();
 	audio_manager_ = new AudioManager();
 	game_manager_ = new GameManager();
 	FE_Initialize();
@@ -113,6 +134,8 @@ std::string openhow::Engine::GetVersionString() {
 bool openhow::Engine::IsRunning() {
 	System_PollEvents();
 
+	HotReload_Poll();
+
 	static unsigned int next_tick = 0;
 	if ( next_tick == 0 ) {
 		next_tick = System_GetTicks();
@@ -123,6 +146,13 @@ bool openhow::Engine::IsRunning() {
 		g_state.sys_ticks = System_GetTicks();
 		g_state.sim_ticks++;
 
+		// Keep hold of where everything was before this tick, so
+		// rendering can blend from there towards the new state
+		ActorManager::GetInstance()->SnapshotActors();
+		if ( Game()->GetCamera() != nullptr ) {
+			Game()->GetCamera()->Snapshot();
+		}
+
 		Client_ProcessInput(); // todo: kill this
 
 		Physics()->Tick();
@@ -134,8 +164,10 @@ bool openhow::Engine::IsRunning() {
 		loops++;
 	}
 
+	// Clamped, as we'll overshoot if the frameskip limit was hit
 	double deltaTime = ( double ) ( System_GetTicks() + SKIP_TICKS - next_tick ) / ( double ) ( SKIP_TICKS );
-	Display_Draw( deltaTime );
+	g_state.draw_delta = std::min( std::max( deltaTime, 0.0 ), 1.0 );
+	Display_Draw( g_state.draw_delta );
 
 	return true;
 }
@@ -52,6 +52,7 @@
 
 #ifdef __cplusplus
 #include "resource_manager.h"
+#include "job_system.h"
 
 #include "audio/audio.h"
 #include "game/game.h"
@@ -77,6 +78,9 @@ class Engine {
 	static IPhysicsInterface* Physics() {
 		return engine->physics_interface_;
 	}
+	static JobSystem* Jobs() {
+		return engine->job_system_;
+	}
 
   void Initialize();
 
@@ -89,6 +93,7 @@ class Engine {
 	AudioManager* audio_manager_{ nullptr };
 	hwResourceManager* resource_manager_{ nullptr };
 	IPhysicsInterface* physics_interface_{ nullptr };
+	JobSystem* job_system_{ nullptr };
 };
 }
 
@@ -109,6 +114,8 @@ typedef struct EngineState {
   unsigned int draw_ticks;
   unsigned int last_draw_ms;
 
+  double draw_delta;  // how far the frame is between the previous sim tick and the current one, 0-1
+
   struct {
     unsigned int num_chunks_drawn;
     unsigned int num_actors_drawn;
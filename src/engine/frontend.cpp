@@ -115,6 +115,8 @@ static void CacheFEMenuData() {
 /************************************************************/
 
 void FE_Initialize(void) {
+  hwResourceManager::LoadContext load_context("Frontend");
+
   CacheFontData();
   CacheFEMenuData();
   CacheFEGameData();
@@ -28,6 +28,8 @@ std::map<std::string, ActorManager::actor_ctor_func> ActorManager::actor_classes
     __attribute__((init_priority (1000)));
 
 Actor* ActorManager::CreateActor(const std::string& class_name) {
+  u_assert(!thinking_, "attempted to create an actor while thinking, use Defer!\n");
+
   auto i = actor_classes_.find(class_name);
   if (i == actor_classes_.end()) {
     // TODO: make this throw an error rather than continue...
@@ -42,17 +44,58 @@ Actor* ActorManager::CreateActor(const std::string& class_name) {
 
 void ActorManager::DestroyActor(Actor* actor) {
   u_assert(actor != nullptr, "attempted to delete a null actor!\n");
+  u_assert(!thinking_, "attempted to destroy an actor while thinking, use Defer!\n");
+
+  if (applying_) {
+    pending_destroy_.insert(actor);
+    return;
+  }
+
+  pending_destroy_.erase(actor);
   actors_.erase(actor);
   delete actor;
 }
 
+/**
+ * Every active actor thinks in parallel, and then anything they
+ * deferred, spawning, destroying and the like, is applied in order.
+ */
 void ActorManager::TickActors() {
+  std::vector<Actor*> active;
+  active.reserve(actors_.size());
   for (auto const& actor: actors_) {
-    if(!actor->IsActivated()) {
+    if (actor->IsActivated()) {
+      active.push_back(actor);
+    }
+  }
+
+  thinking_ = true;
+  openhow::Engine::Jobs()->ParallelFor(active.size(), 16, [&active](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      active[i]->Think();
+    }
+  });
+  thinking_ = false;
+
+  applying_ = true;
+  for (auto const& actor: active) {
+    if (pending_destroy_.find(actor) != pending_destroy_.end()) {
       continue;
     }
 
-    actor->Tick();
+    actor->ApplyDeferred();
+  }
+  applying_ = false;
+
+  // Destroying a parent takes its children with it, which may be pending too
+  while (!pending_destroy_.empty()) {
+    DestroyActor(*pending_destroy_.begin());
+  }
+}
+
+void ActorManager::SnapshotActors() {
+  for (auto const& actor: actors_) {
+    actor->SnapshotTransform();
   }
 }
 
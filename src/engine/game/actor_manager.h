@@ -38,6 +38,7 @@ class ActorManager {
   Actor* CreateActor(const std::string& class_name);
   void DestroyActor(Actor* actor);
 
+  void SnapshotActors();
   void TickActors();
   void DrawActors();
   void DestroyActors();
@@ -47,6 +48,8 @@ class ActorManager {
 
   const ActorSet& GetActors() const { return actors_; }
 
+  bool IsThinking() const { return thinking_; }
+
   class ActorClassRegistration {
    public:
     const std::string name_;
@@ -57,6 +60,12 @@ class ActorManager {
 
  private:
   static ActorSet actors_;
+
+  // Actors can't be created or destroyed while thinking, and destroying one
+  // while applying is held off until the end, so nothing's pulled out from under us
+  bool thinking_{false};
+  bool applying_{false};
+  ActorSet pending_destroy_;
 };
 
 #define REGISTER_ACTOR(NAME, CLASS) \
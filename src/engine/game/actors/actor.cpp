@@ -49,15 +49,39 @@ Actor::~Actor() {
 
 void Actor::SetAngles(PLVector3 angles) {
   VecAngleClamp(&angles);
-  old_angles_ = angles_;
   angles_ = angles;
 }
 
 void Actor::SetPosition(PLVector3 position) {
-  old_position_ = position_;
   position_ = position;
 }
 
+PLVector3 Actor::GetDrawPosition() {
+  return VecLerp(old_position_, position_, static_cast<float>(g_state.draw_delta));
+}
+
+PLVector3 Actor::GetDrawAngles() {
+  return VecAngleLerp(old_angles_, angles_, static_cast<float>(g_state.draw_delta));
+}
+
+/**
+ * Called at the start of every sim tick, however many times the
+ * transform is set during it, so drawing always has the full step.
+ */
+void Actor::SnapshotTransform() {
+  old_position_ = position_;
+  old_angles_ = angles_;
+}
+
+void Actor::ApplyDeferred() {
+  // Swapped out first, in case a command defers anything further
+  std::vector<std::function<void()>> commands;
+  commands.swap(deferred_);
+  for (const auto& command : commands) {
+    command();
+  }
+}
+
 void Actor::Deserialize(const ActorSpawn& spawn){
   SetPosition(spawn.position);
   SetAngles(spawn.angles);
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <functional>
+
 #include "../../property.h"
 
 enum ActorFlag {
@@ -85,9 +87,15 @@ class Actor: public PropertyOwner {
 
   virtual const char* GetClassName() { return "Actor"; }
 
-  virtual void Tick() {}  // simulation tick, called per-frame
+  // Simulation tick, run alongside every other actor's. Only read from the
+  // world and write to ourselves here, anything else goes through Defer
+  virtual void Think() {}
   virtual void Draw() {}  // draw tick, called per-frame
 
+  // Queue up something to run once every actor is done thinking, serially
+  void Defer(const std::function<void()>& command) { deferred_.push_back(command); }
+  void ApplyDeferred();
+
   virtual void SetHealth(int16_t health) { health_ = health; }
   virtual void AddHealth(int16_t health);
   int16_t GetHealth() { return health_; }
@@ -100,6 +108,11 @@ class Actor: public PropertyOwner {
   virtual PLVector3 GetAngles() { return angles_; }
   virtual void SetAngles(PLVector3 angles);
 
+  // Transform blended between the previous tick and this one, for drawing
+  PLVector3 GetDrawPosition();
+  PLVector3 GetDrawAngles();
+  void SnapshotTransform();
+
   virtual bool Possessed(const Player* player);
   virtual void Depossessed(const Player* player);
   virtual void HandleInput();   // handle any player input, if applicable
@@ -136,7 +149,7 @@ protected:
 	PLVector3 velocity_{ 0, 0, 0 }, old_velocity_{ 0, 0, 0 };
 
 	Vector3Property position_;
-	PLVector3 old_position_{ 0, 0, 0 };
+	PLVector3 old_position_{ 0, 0, 0 };  // as of the start of the last tick, see SnapshotTransform
 
 	Vector3Property fallback_position_;
 
@@ -157,4 +170,6 @@ private:
 
   Actor* parent_{nullptr};
   std::vector<Actor*> children_;
+
+  std::vector<std::function<void()>> deferred_;
 };
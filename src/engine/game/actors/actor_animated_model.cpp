@@ -16,11 +16,142 @@
  */
 
 #include "../../engine.h"
+#include "../../graphics/shaders.h"
 #include "actor_animated_model.h"
 
-AAnimatedModel::AAnimatedModel() : SuperClass() {}
-AAnimatedModel::~AAnimatedModel() = default;
+using namespace openhow;
+
+AAnimatedModel::AAnimatedModel() : SuperClass() {
+  for (auto& bone : palette_.bones) {
+    bone.Identity();
+  }
+}
+
+AAnimatedModel::~AAnimatedModel() {
+  Model_Destroy(skinned_model_);
+}
+
+void AAnimatedModel::Think() {
+  SuperClass::Think();
+
+  animation_time_ += 1.0f / TICKS_PER_SECOND;
+  if (blend_time_ < blend_duration_) {
+    blend_animation_time_ += 1.0f / TICKS_PER_SECOND;
+    blend_time_ += 1.0f / TICKS_PER_SECOND;
+  }
+
+  UpdatePose();
+}
+
+void AAnimatedModel::Draw() {
+  if (skinned_model_ == nullptr || !Animation_IsAvailable()) {
+    SuperClass::Draw();
+    return;
+  }
+
+  ShaderProgram* program = Shaders_GetProgram("generic_textured_skinned");
+  if (program == nullptr) {
+    SuperClass::Draw();
+    return;
+  }
+
+  static std::string uniform_names[ANIMATION_MAX_BONES];
+  if (uniform_names[0].empty()) {
+    for (unsigned int i = 0; i < ANIMATION_MAX_BONES; ++i) {
+      uniform_names[i] = "bones[" + std::to_string(i) + "]";
+    }
+  }
+
+  PLShaderProgram* save = plGetCurrentShaderProgram();
+  program->Enable();
+
+  for (unsigned int i = 0; i < ANIMATION_MAX_BONES; ++i) {
+    plSetNamedShaderUniformMatrix4(program->GetInternalProgram(), uniform_names[i].c_str(), palette_.bones[i], false);
+  }
+
+  PLModel* shared_model = model_;
+  model_ = skinned_model_;
+  SuperClass::Draw();
+  model_ = shared_model;
+
+  // Restore the previous shader program
+  plSetShaderProgram(save);
+}
 
 void AAnimatedModel::Deserialize(const ActorSpawn& spawn) {
   SuperClass::Deserialize(spawn);
 }
+
+void AAnimatedModel::SetModel(const std::string &path) {
+  SuperClass::SetModel(path);
+
+  // The cached model is shared with everyone else, so skin our own copy
+  Model_Destroy(skinned_model_);
+  skinned_model_ = nullptr;
+  if (model_ != Engine::Resource()->GetFallbackModel()) {
+    skinned_model_ = Model_CreateSkinnedCopy(model_);
+  }
+
+  // Load the shared animations now, while spawning on the main thread,
+  // rather than leaving it to whichever worker thinks first
+  Animation_IsAvailable();
+}
+
+/**
+ * Switch to the given animation, blending from the
+ * current one over the given number of seconds.
+ */
+void AAnimatedModel::SetAnimation(AnimationIndex index, bool loop, float blend_time) {
+  if (index == animation_ && loop == animation_loop_) {
+    return;
+  }
+
+  blend_animation_ = animation_;
+  blend_animation_time_ = animation_time_;
+  blend_loop_ = animation_loop_;
+  blend_time_ = 0;
+  blend_duration_ = blend_time;
+
+  animation_ = index;
+  animation_time_ = 0;
+  animation_loop_ = loop;
+}
+
+bool AAnimatedModel::IsAnimationFinished() const {
+  if (animation_loop_) {
+    return false;
+  }
+
+  const Animation* animation = Animation_GetAnimation(animation_);
+  if (animation == nullptr) {
+    return true;
+  }
+
+  return (animation_time_ * ANIMATION_FRAMES_PER_SECOND) >= (animation->num_frames - 1);
+}
+
+void AAnimatedModel::UpdatePose() {
+  const Animation* animation = Animation_GetAnimation(animation_);
+  if (animation == nullptr) {
+    return;
+  }
+
+  // Nothing unique about our pose unless we're blending, so share it
+  bool blending = (blend_time_ < blend_duration_);
+  if (!blending && cv_graphics_animation_cache->b_value) {
+    palette_ = *Animation_GetCachedPalette(animation, animation_time_, animation_loop_);
+    return;
+  }
+
+  AnimationPose pose;
+  Animation_SamplePose(animation, animation_time_, animation_loop_, &pose);
+
+  const Animation* blend_animation = Animation_GetAnimation(blend_animation_);
+  if (blend_animation != nullptr && blending) {
+    AnimationPose blend_pose;
+    Animation_SamplePose(blend_animation, blend_animation_time_, blend_loop_, &blend_pose);
+    Animation_BlendPoses(&blend_pose, &pose, blend_time_ / blend_duration_, &pose);
+  }
+
+  Animation_BuildPalette(&pose, &palette_);
+}
@@ -19,6 +19,7 @@
 
 #include "actor.h"
 #include "actor_model.h"
+#include "../../animation.h"
 
 class AAnimatedModel : public AModel {
   IMPLEMENT_ACTOR(AAnimatedModel, AModel)
@@ -27,8 +28,34 @@ class AAnimatedModel : public AModel {
   AAnimatedModel();
   ~AAnimatedModel() override;
 
+  void Think() override;
+  void Draw() override;
+
   void Deserialize(const ActorSpawn& spawn) override;
 
+  void SetModel(const std::string &path) override;
+
+  void SetAnimation(AnimationIndex index, bool loop = true, float blend_time = 0.2f);
+  AnimationIndex GetAnimation() const { return animation_; }
+  bool IsAnimationFinished() const;
+
  protected:
  private:
+  void UpdatePose();
+
+  AnimationIndex animation_{AnimationIndex::ANI_IDLE1};
+  float animation_time_{0};
+  bool animation_loop_{true};
+
+  // Previous animation, which we blend out of
+  AnimationIndex blend_animation_{AnimationIndex::ANI_IDLE1};
+  float blend_animation_time_{0};
+  bool blend_loop_{true};
+  float blend_time_{0};
+  float blend_duration_{0};
+
+  AnimationPalette palette_;
+
+  // Our own copy of the model, with the bone indices baked in for skinning
+  PLModel* skinned_model_{nullptr};
 };
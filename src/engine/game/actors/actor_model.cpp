@@ -31,22 +31,23 @@ void AModel::Draw() {
 		return;
 	}
 
-	PLVector3 angles(
-		plDegreesToRadians( angles_.GetValue().x ),
-		plDegreesToRadians( angles_.GetValue().y ),
-		plDegreesToRadians( angles_.GetValue().z ) );
+	PLVector3 angles = GetDrawAngles();
+	angles.x = plDegreesToRadians( angles.x );
+	angles.y = plDegreesToRadians( angles.y );
+	angles.z = plDegreesToRadians( angles.z );
 
 	PLMatrix4 mat;
 	mat.Identity();
 	mat.Rotate( angles.z, { 1, 0, 0 } );
 	mat.Rotate( -angles.y, { 0, 1, 0 } );
 	mat.Rotate( angles.x, { 0, 0, 1 } );
-	mat.Translate( position_ );
+	mat.Translate( GetDrawPosition() );
 
 	Model_Draw( model_, mat );
 }
 
 void AModel::SetModel( const std::string& path ) {
+	hwResourceManager::LoadContext loadContext( GetClassName() );
 	model_ = Engine::Resource()->LoadModel( "chars/" + path, false );
 	u_assert( model_ != nullptr );
 }
@@ -47,31 +47,15 @@ void APig::HandleInput() {
 	SuperClass::HandleInput();
 }
 
-void APig::Tick() {
-	SuperClass::Tick();
+void APig::Think() {
+	SuperClass::Think();
 
 	// temp
 	DropToFloor();
 
 	// a dead piggy
 	if ( GetHealth() <= 0 ) {
-		if ( speech_->IsPlaying() ) {
-			return;
-		}
-
-		// TODO: actor that produces explosion fx (AFXExplosion / effect_explosion) ?
-		Engine::Audio()->PlayLocalSound( "audio/e_1.wav", GetPosition(), { 0, 0, 0 }, true );
-
-		Actor* boots = ActorManager::GetInstance()->CreateActor( "boots" );
-		boots->SetPosition( GetPosition() );
-		boots->SetAngles( GetAngles() );
-		boots->DropToFloor();
-
-		// activate the boots (should begin smoke effect etc.)
-		boots->Activate();
-
-		// ensure our own destruction on next tick
-		ActorManager::GetInstance()->DestroyActor( this );
+		Defer( [ this ]() { Die(); } );
 		return;
 	}
 
@@ -100,7 +84,34 @@ void APig::Tick() {
 	SetPosition( nPosition );
 	SetAngles( nAngles );
 
-	speech_->SetPosition( GetPosition() );
+	SetAnimation( ( input_forward != 0.0f ) ? AnimationIndex::ANI_RUN_NORMAL : AnimationIndex::ANI_IDLE1 );
+
+	Defer( [ this ]() { speech_->SetPosition( GetPosition() ); } );
+}
+
+/**
+ * Swap ourselves out for a pair of boots, once we're done talking.
+ * Deferred from Think, since it spawns and destroys actors.
+ */
+void APig::Die() {
+	if ( speech_->IsPlaying() ) {
+		return;
+	}
+
+	// TODO: actor that produces explosion fx (AFXExplosion / effect_explosion) ?
+	Engine::Audio()->PlayLocalSound( "audio/e_1.wav", GetPosition(), { 0, 0, 0 }, true );
+
+	Actor* boots = ActorManager::GetInstance()->CreateActor( "boots" );
+	boots->SetPosition( GetPosition() );
+	boots->SetAngles( GetAngles() );
+	boots->DropToFloor();
+	boots->SnapshotTransform();
+
+	// activate the boots (should begin smoke effect etc.)
+	boots->Activate();
+
+	// the manager holds off on this until everyone's been applied
+	ActorManager::GetInstance()->DestroyActor( this );
 }
 
 void APig::SetClass( unsigned int pclass ) {
@@ -31,7 +31,8 @@ class APig : public AAnimatedModel, public InventoryManager {
   ~APig() override;
 
   void HandleInput() override;
-  void Tick() override;
+  void Think() override;
+  void Die();
 
   void SetClass(unsigned int pclass);
   unsigned int GetClass() { return class_; }
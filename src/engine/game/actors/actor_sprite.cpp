@@ -33,7 +33,7 @@ public:
 	ASprite();
 	~ASprite() override;
 
-	void Tick() override;
+	void Think() override;
 	void Draw() override;
 
 	virtual void SetSpriteTexture( const std::string& path );
@@ -66,14 +66,11 @@ void ASprite::SetSpriteTexture( PLTexture* texture ) {
 	sprite_->SetTexture( texture );
 }
 
-void ASprite::Tick() {
-	SuperClass::Tick();
+void ASprite::Think() {
+	SuperClass::Think();
 
 	SetAngles( angles_.GetValue() + 0.2f );
 
-	sprite_->SetPosition( position_ );
-	sprite_->SetAngles( angles_ );
-
 	// increment animation etc.
 	sprite_->Tick();
 }
@@ -81,5 +78,7 @@ void ASprite::Tick() {
 void ASprite::Draw() {
 	SuperClass::Draw();
 
+	sprite_->SetPosition( GetDrawPosition() );
+	sprite_->SetAngles( GetDrawAngles() );
 	sprite_->Draw();
 }
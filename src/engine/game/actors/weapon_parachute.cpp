@@ -30,8 +30,8 @@ AParachuteWeapon::AParachuteWeapon() : SuperClass() {
 
 AParachuteWeapon::~AParachuteWeapon() = default;
 
-void AParachuteWeapon::Tick() {
-  SuperClass::Tick();
+void AParachuteWeapon::Think() {
+  SuperClass::Think();
 
   if(!is_deployed_) {
     return;
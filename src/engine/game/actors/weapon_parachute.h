@@ -26,7 +26,7 @@ class AParachuteWeapon : public AWeapon {
   AParachuteWeapon();
   ~AParachuteWeapon() override;
 
-  void Tick() override;
+  void Think() override;
 
   void Fire(const PLVector3& pos, const PLVector3& dir) override;
   void Deploy() override;
@@ -89,6 +89,7 @@ GameManager::GameManager() {
 	plRegisterConsoleCommand( "SpawnModel", SpawnModelCommand, "Creates a model at your current position." );
 
 	// Load in all the data we'll retain in memory
+	hwResourceManager::LoadContext loadContext( "GameManager" );
 	Engine::Resource()->LoadModel( "chars/pigs/ac_hi", true, true );
 	Engine::Resource()->LoadModel( "chars/pigs/sb_hi", true, true );
 	Engine::Resource()->LoadModel( "chars/pigs/gr_hi", true, true );
@@ -442,6 +443,7 @@ void GameManager::SpawnModelCommand( unsigned int argc, char** argv ) {
 	model_actor->SetModel( argv[ 1 ] );
 	model_actor->SetPosition( actor->GetPosition() );
 	model_actor->SetAngles( actor->GetAngles() );
+	model_actor->SnapshotTransform();
 }
 
 void GameManager::StartMode( const std::string& map,
@@ -108,6 +108,9 @@ void BaseGameMode::SpawnActors() {
 
 		actor->Deserialize( spawn );
 
+		// Only once it's fully placed, so it doesn't blend in from wherever it started
+		actor->SnapshotTransform();
+
 		APig* pig = dynamic_cast<APig*>(actor);
 		if ( pig == nullptr ) {
 			continue;
@@ -133,6 +136,7 @@ void BaseGameMode::SpawnActors() {
 	model_actor->SetPosition( {
 								  TERRAIN_PIXEL_WIDTH / 2, TERRAIN_PIXEL_WIDTH / 2,
 								  Engine::Game()->GetCurrentMap()->GetTerrain()->GetMaxHeight() } );
+	model_actor->SnapshotTransform();
 
 	// TEMP END
 
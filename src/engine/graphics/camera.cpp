@@ -40,11 +40,11 @@ Camera::~Camera() {
 }
 
 void Camera::SetPosition( const PLVector3 &pos ) {
-	camera_->position = pos;
+	position_ = pos;
 }
 
 void Camera::SetAngles( const PLVector3 &angles ) {
-	camera_->angles = angles;
+	angles_ = angles;
 }
 
 void Camera::SetFieldOfView( float fov ) {
@@ -63,7 +63,19 @@ void Camera::SetViewport( const std::array<int, 2> &xy, const std::array<unsigne
 	camera_->viewport.h = wh[ 1 ];
 }
 
+/**
+ * Called at the start of every sim tick, same as the actors,
+ * so whatever the camera is following stays in step with it.
+ */
+void Camera::Snapshot() {
+	old_position_ = position_;
+	old_angles_ = angles_;
+}
+
 void Camera::MakeActive() {
+	camera_->position = VecLerp( old_position_, position_, static_cast<float>(g_state.draw_delta) );
+	camera_->angles = VecAngleLerp( old_angles_, angles_, static_cast<float>(g_state.draw_delta) );
+
 	// ensure camera matches current vars
 	//camera_->fov = cv_camera_fov->f_value;
 	camera_->near = cv_camera_near->f_value;
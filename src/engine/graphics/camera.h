@@ -28,8 +28,8 @@ public:
 	void SetAngles( const PLVector3 &angles );
 	void SetFieldOfView( float fov );
 
-	PLVector3 GetPosition() { return camera_->position; }
-	PLVector3 GetAngles() { return camera_->angles; }
+	PLVector3 GetPosition() { return position_; }
+	PLVector3 GetAngles() { return angles_; }
 	PLVector3 GetForward() { return camera_->forward; }
 
 	float GetFieldOfView() { return camera_->fov; }
@@ -39,9 +39,14 @@ public:
 	int GetViewportWidth() { return camera_->viewport.w; }
 	int GetViewportHeight() { return camera_->viewport.h; }
 
+	void Snapshot();
 	void MakeActive();
 
 protected:
 private:
 	PLCamera *camera_{ nullptr };
+
+	// Set during the sim tick, and blended between when drawn
+	PLVector3 position_{ 0, 0, 0 }, old_position_{ 0, 0, 0 };
+	PLVector3 angles_{ 0, 0, 0 }, old_angles_{ 0, 0, 0 };
 };
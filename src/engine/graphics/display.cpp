@@ -28,6 +28,8 @@
 
 #include "font.h"
 #include "shaders.h"
+#include "mesh.h"
+#include "texture_atlas.h"
 #include "display.h"
 
 using namespace openhow;
@@ -274,6 +276,8 @@ void Display_Initialize() {
 #endif
 
 	Shaders_Initialize();
+	Mesh_Initialize();
+	TextureAtlas_Initialize();
 
 	//////////////////////////////////////////////////////////
 
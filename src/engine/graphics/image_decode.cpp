@@ -0,0 +1,62 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../engine.h"
+
+#include "image_decode.h"
+
+using namespace openhow;
+
+/**
+ * Returns NULL on failure. The platform library's error isn't
+ * kept per thread, so it's not safe to fetch it from here.
+ *
+ * Failed loads still write that error from several workers at once.
+ * It's a fixed size buffer, so the worst that can come of it is a
+ * garbled message, and nothing reads it while a batch is decoding:
+ * the calling thread is waiting on ParallelFor, and nothing here or
+ * after relies on it. Taking a lock around plLoadImage instead would
+ * leave the workers decoding one image at a time.
+ */
+static PLImage* Image_Decode( const std::string& path ) {
+	auto* image = static_cast<PLImage*>(u_alloc( 1, sizeof( PLImage ), true ));
+	if ( !plLoadImage( path.c_str(), image ) ) {
+		u_free( image );
+		return nullptr;
+	}
+
+	plConvertPixelFormat( image, PL_IMAGEFORMAT_RGBA8 );
+	return image;
+}
+
+std::vector<PLImage*> Image_DecodeParallel( const std::vector<std::string>& paths ) {
+	std::vector<PLImage*> images( paths.size() );
+	Engine::Jobs()->ParallelFor( paths.size(), 1, [ &paths, &images ]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			images[ i ] = Image_Decode( paths[ i ] );
+		}
+	} );
+
+	// Reported afterwards and in order, so the log reads the same every time
+	for ( size_t i = 0; i < paths.size(); ++i ) {
+		if ( images[ i ] == nullptr ) {
+			LogWarn( "Failed to load \"%s\"!\n", paths[ i ].c_str() );
+		}
+	}
+
+	return images;
+}
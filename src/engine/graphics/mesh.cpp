@@ -15,14 +15,30 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <list>
 #include <map>
+#include <memory>
 #include <set>
+#include <vector>
+#include <cmath>
+
+#include "../engine.h"
 
 #include <PL/platform_mesh.h>
 #include <PL/pl_math_vector.h>
+#include <PL/platform_console.h>
+
+#include "mesh.h"
 
-void Mesh_GenerateFragmentedMeshNormals(const std::list<PLMesh*>& meshes) {
+/**
+ * Original implementation, only kept around for comparison
+ * by the BenchmarkNormals command.
+ */
+static void Mesh_GenerateFragmentedMeshNormalsLegacy(const std::list<PLMesh*>& meshes) {
     struct Position {
         PLVector3 sum_normals;
         std::set<PLVertex*> vertices;
@@ -73,3 +89,490 @@ void Mesh_GenerateFragmentedMeshNormals(const std::list<PLMesh*>& meshes) {
         }
     }
 }
+
+/* Normal Generation
+ *
+ * Vertices sharing the same position, across all the given meshes,
+ * are smoothed together. Positions are grouped with a flat open
+ * addressing hash, and face normals are summed into a contiguous
+ * array per group, rather than allocating per vertex.
+ */
+
+namespace {
+struct PositionHash {
+    explicit PositionHash(size_t num_elements) {
+        size_t size = 16;
+        while (size < num_elements * 2) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Returns the group for the given position, creating a new one if necessary
+    unsigned int GetGroup(const PLVector3 &position, unsigned int *num_groups) {
+        // Adding zero ensures -0 and 0 end up in the same slot
+        float key[3] = {position.x + 0.0f, position.y + 0.0f, position.z + 0.0f};
+
+        uint32_t bits[3];
+        memcpy(bits, key, sizeof(bits));
+        size_t h = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            Slot &slot = slots[i];
+            if (slot.group == UINT32_MAX) {
+                memcpy(slot.key, key, sizeof(key));
+                slot.group = (*num_groups)++;
+                return slot.group;
+            }
+
+            if (slot.key[0] == key[0] && slot.key[1] == key[1] && slot.key[2] == key[2]) {
+                return slot.group;
+            }
+        }
+    }
+
+    struct Slot {
+        float key[3];
+        unsigned int group{UINT32_MAX};
+    };
+    std::vector<Slot> slots;
+    size_t mask;
+};
+}
+
+/**
+ * Generates smooth normals for the given meshes.
+ * @param meshes Meshes to generate normals for.
+ * @param angle_threshold Faces meeting at a greater angle than this,
+ * in degrees, won't be smoothed together. Zero smooths everything.
+ */
+void Mesh_GenerateFragmentedMeshNormals(const std::list<PLMesh*>& meshes, float angle_threshold) {
+    size_t num_corners = 0;
+    for (auto &mesh : meshes) {
+        num_corners += mesh->num_triangles * 3;
+    }
+
+    if (num_corners == 0) {
+        return;
+    }
+
+    struct Corner {
+        PLVertex *vertex;
+        unsigned int vertex_index;  // across all of the meshes
+        unsigned int face;
+        unsigned int group;
+    };
+    std::vector<Corner> corners;
+    corners.reserve(num_corners);
+    std::vector<PLVector3> face_normals;
+    face_normals.reserve(num_corners / 3);
+
+    PositionHash hash(num_corners);
+    unsigned int num_groups = 0;
+    unsigned int num_vertices = 0;
+    for (auto &mesh : meshes) {
+        for (unsigned int i = 0, idx = 0; i < mesh->num_triangles; ++i, idx += 3) {
+            PLVertex *a = &mesh->vertices[mesh->indices[idx]];
+            PLVertex *b = &mesh->vertices[mesh->indices[idx + 1]];
+            PLVertex *c = &mesh->vertices[mesh->indices[idx + 2]];
+
+            unsigned int face = face_normals.size();
+            face_normals.push_back(plGenerateVertexNormal(a->position, b->position, c->position));
+
+            corners.push_back({a, num_vertices + mesh->indices[idx], face, hash.GetGroup(a->position, &num_groups)});
+            corners.push_back({b, num_vertices + mesh->indices[idx + 1], face, hash.GetGroup(b->position, &num_groups)});
+            corners.push_back({c, num_vertices + mesh->indices[idx + 2], face, hash.GetGroup(c->position, &num_groups)});
+        }
+        num_vertices += mesh->num_verts;
+    }
+
+    std::vector<PLVector3> sum_normals(num_groups);
+    std::vector<unsigned int> num_faces(num_groups, 0);
+    for (const auto &corner : corners) {
+        sum_normals[corner.group] += face_normals[corner.face];
+        num_faces[corner.group]++;
+    }
+
+    if (angle_threshold <= 0.0f) {
+        for (const auto &corner : corners) {
+            corner.vertex->normal = sum_normals[corner.group] / num_faces[corner.group];
+        }
+        return;
+    }
+
+    // Otherwise, we need the list of faces for each group, so each
+    // corner can pick out the ones within the threshold of its own
+    std::vector<unsigned int> group_offsets(num_groups + 1, 0);
+    for (unsigned int i = 0; i < num_groups; ++i) {
+        group_offsets[i + 1] = group_offsets[i] + num_faces[i];
+    }
+
+    std::vector<unsigned int> group_faces(num_corners);
+    std::vector<unsigned int> group_fill(group_offsets.begin(), group_offsets.end() - 1);
+    for (const auto &corner : corners) {
+        group_faces[group_fill[corner.group]++] = corner.face;
+    }
+
+    // Vertices may be shared between several corners, so average out
+    // whatever each of them come up with
+    std::vector<unsigned int> vertex_corners(num_vertices, 0);
+    for (const auto &corner : corners) {
+        corner.vertex->normal = PLVector3(0, 0, 0);
+    }
+
+    float threshold = cosf(plDegreesToRadians(angle_threshold));
+    for (const auto &corner : corners) {
+        const PLVector3 &face_normal = face_normals[corner.face];
+
+        PLVector3 sum(0, 0, 0);
+        unsigned int num = 0;
+        for (unsigned int i = group_offsets[corner.group]; i < group_offsets[corner.group + 1]; ++i) {
+            const PLVector3 &other = face_normals[group_faces[i]];
+            if (face_normal.x * other.x + face_normal.y * other.y + face_normal.z * other.z >= threshold) {
+                sum += other;
+                num++;
+            }
+        }
+
+        // A degenerate face isn't even within the threshold of itself
+        corner.vertex->normal += (num > 0) ? sum / num : face_normal;
+        vertex_corners[corner.vertex_index]++;
+    }
+
+    for (const auto &corner : corners) {
+        unsigned int &num = vertex_corners[corner.vertex_index];
+        if (num > 0) {
+            corner.vertex->normal = corner.vertex->normal / num;
+            num = 0;
+        }
+    }
+}
+
+/* Vertex Cache Optimisation
+ *
+ * Implementation of Tom Forsyth's "Linear-Speed Vertex Cache
+ * Optimisation", which greedily emits whichever triangle scores
+ * best given the vertices currently sitting in a simulated LRU cache.
+ */
+
+#define VERTEX_CACHE_SIZE 32
+
+static float Mesh_GetVertexScore(int cache_position, unsigned int remaining_triangles) {
+    if (remaining_triangles == 0) {
+        // No triangles left, so it's not worth anything
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // Used by the last triangle, so give it a fixed score to
+            // avoid favouring the same triangle again
+            score = 0.75f;
+        } else {
+            const float scaler = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cache_position - 3) * scaler, 1.5f);
+        }
+    }
+
+    // Boost vertices with few triangles remaining, so we clear them out
+    score += 2.0f * powf(static_cast<float>(remaining_triangles), -0.5f);
+    return score;
+}
+
+/**
+ * Reorders the given triangle list to improve post-transform
+ * vertex cache hits.
+ */
+void Mesh_OptimizeVertexCache(unsigned int *indices, unsigned int num_indices, unsigned int num_vertices) {
+    unsigned int num_triangles = num_indices / 3;
+    if (num_triangles < 2) {
+        return;
+    }
+
+    struct VertexData {
+        int cache_position{-1};
+        float score{0.0f};
+        unsigned int remaining{0};
+        unsigned int adjacency_offset{0};
+    };
+    std::vector<VertexData> vertices(num_vertices);
+    for (unsigned int i = 0; i < num_indices; ++i) {
+        vertices[indices[i]].remaining++;
+    }
+
+    // Build up a list of triangles used by each vertex
+    std::vector<unsigned int> adjacency(num_indices);
+    for (unsigned int i = 0, offset = 0; i < num_vertices; ++i) {
+        vertices[i].adjacency_offset = offset;
+        offset += vertices[i].remaining;
+    }
+
+    std::vector<unsigned int> num_adjacent(num_vertices, 0);
+    for (unsigned int i = 0; i < num_indices; ++i) {
+        unsigned int v = indices[i];
+        adjacency[vertices[v].adjacency_offset + num_adjacent[v]++] = i / 3;
+    }
+
+    for (auto &vertex : vertices) {
+        vertex.score = Mesh_GetVertexScore(-1, vertex.remaining);
+    }
+
+    std::vector<float> triangle_scores(num_triangles);
+    std::vector<bool> emitted(num_triangles, false);
+    for (unsigned int i = 0; i < num_triangles; ++i) {
+        triangle_scores[i] = vertices[indices[i * 3]].score +
+            vertices[indices[i * 3 + 1]].score +
+            vertices[indices[i * 3 + 2]].score;
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(num_indices);
+
+    unsigned int cache[VERTEX_CACHE_SIZE + 3];
+    unsigned int cache_size = 0;
+
+    int best_triangle = -1;
+    while (output.size() < num_indices) {
+        if (best_triangle < 0) {
+            // Nothing left in the cache, so find the best remaining triangle
+            float best_score = -1.0f;
+            for (unsigned int i = 0; i < num_triangles; ++i) {
+                if (!emitted[i] && triangle_scores[i] > best_score) {
+                    best_score = triangle_scores[i];
+                    best_triangle = static_cast<int>(i);
+                }
+            }
+        }
+
+        const unsigned int *triangle = &indices[best_triangle * 3];
+        emitted[best_triangle] = true;
+
+        unsigned int new_cache[VERTEX_CACHE_SIZE + 3];
+        unsigned int new_cache_size = 0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            unsigned int v = triangle[i];
+            output.push_back(v);
+            new_cache[new_cache_size++] = v;
+
+            // Remove the triangle from the vertex's list of remaining triangles
+            VertexData *vertex = &vertices[v];
+            unsigned int *list = &adjacency[vertex->adjacency_offset];
+            for (unsigned int j = 0; j < vertex->remaining; ++j) {
+                if (list[j] == static_cast<unsigned int>(best_triangle)) {
+                    list[j] = list[vertex->remaining - 1];
+                    break;
+                }
+            }
+            vertex->remaining--;
+        }
+
+        for (unsigned int i = 0; i < cache_size; ++i) {
+            unsigned int v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache[new_cache_size++] = v;
+            }
+        }
+
+        // Update the scores for everything that was, or still is, in the cache
+        for (unsigned int i = 0; i < new_cache_size; ++i) {
+            VertexData *vertex = &vertices[new_cache[i]];
+            vertex->cache_position = (i < VERTEX_CACHE_SIZE) ? static_cast<int>(i) : -1;
+            vertex->score = Mesh_GetVertexScore(vertex->cache_position, vertex->remaining);
+        }
+
+        best_triangle = -1;
+        float best_score = -1.0f;
+        for (unsigned int i = 0; i < new_cache_size; ++i) {
+            const VertexData *vertex = &vertices[new_cache[i]];
+            for (unsigned int j = 0; j < vertex->remaining; ++j) {
+                unsigned int t = adjacency[vertex->adjacency_offset + j];
+                float score = vertices[indices[t * 3]].score +
+                    vertices[indices[t * 3 + 1]].score +
+                    vertices[indices[t * 3 + 2]].score;
+                triangle_scores[t] = score;
+                if (score > best_score) {
+                    best_score = score;
+                    best_triangle = static_cast<int>(t);
+                }
+            }
+        }
+
+        cache_size = std::min(new_cache_size, static_cast<unsigned int>(VERTEX_CACHE_SIZE));
+        std::copy(new_cache, new_cache + cache_size, cache);
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+/**
+ * Returns the average number of vertices transformed per triangle,
+ * given a FIFO cache of the specified size.
+ */
+float Mesh_GetAverageCacheMissRatio(const unsigned int *indices, unsigned int num_indices, unsigned int cache_size) {
+    if (num_indices < 3) {
+        return 0.0f;
+    }
+
+    std::vector<unsigned int> fifo;
+    unsigned int misses = 0;
+    for (unsigned int i = 0; i < num_indices; ++i) {
+        if (std::find(fifo.begin(), fifo.end(), indices[i]) != fifo.end()) {
+            continue;
+        }
+
+        misses++;
+        fifo.push_back(indices[i]);
+        if (fifo.size() > cache_size) {
+            fifo.erase(fifo.begin());
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(num_indices / 3);
+}
+
+/* Benchmarking */
+
+namespace {
+struct BenchmarkMesh {
+    BenchmarkMesh(unsigned int num_vertices, unsigned int num_triangles) :
+        vertices(num_vertices), indices(num_triangles * 3) {
+        memset(&mesh, 0, sizeof(PLMesh));
+        mesh.vertices = vertices.data();
+        mesh.num_verts = num_vertices;
+        mesh.indices = indices.data();
+        mesh.num_indices = num_triangles * 3;
+        mesh.num_triangles = num_triangles;
+    }
+
+    PLMesh mesh;
+    std::vector<PLVertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+typedef std::vector<std::unique_ptr<BenchmarkMesh>> BenchmarkMeshes;
+
+/**
+ * Matches the layout generated for terrain chunks, 16 tiles
+ * per chunk with four vertices per tile, so positions along
+ * the tile and chunk edges are duplicated.
+ */
+void Mesh_CreateTerrainBenchmark(BenchmarkMeshes &meshes) {
+    for (unsigned int chunk_y = 0; chunk_y < 16; ++chunk_y) {
+        for (unsigned int chunk_x = 0; chunk_x < 16; ++chunk_x) {
+            BenchmarkMesh *chunk = new BenchmarkMesh(64, 32);
+            meshes.emplace_back(chunk);
+
+            unsigned int vertex = 0, index = 0;
+            for (unsigned int tile_y = 0; tile_y < 4; ++tile_y) {
+                for (unsigned int tile_x = 0; tile_x < 4; ++tile_x) {
+                    for (unsigned int corner = 0; corner < 4; ++corner) {
+                        unsigned int x = chunk_x * 4 + tile_x + (corner & 1);
+                        unsigned int y = chunk_y * 4 + tile_y + (corner >> 1);
+                        chunk->vertices[vertex + corner].position = PLVector3(
+                            x * 512.0f, sinf(x * 0.3f) * cosf(y * 0.2f) * 256.0f, y * 512.0f);
+                    }
+
+                    const unsigned int tile_indices[6] = {0, 1, 2, 3, 2, 1};
+                    for (unsigned int i : tile_indices) {
+                        chunk->indices[index++] = vertex + i;
+                    }
+                    vertex += 4;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Roughly the density of a pig, a sphere with a
+ * unique set of vertices for each face.
+ */
+void Mesh_CreateModelBenchmark(BenchmarkMeshes &meshes) {
+    const unsigned int rings = 16, segments = 24;
+    BenchmarkMesh *model = new BenchmarkMesh(rings * segments * 6, rings * segments * 2);
+    meshes.emplace_back(model);
+
+    auto position = [](unsigned int ring, unsigned int segment) {
+        float theta = plDegreesToRadians(ring * 180.0f / rings);
+        float phi = plDegreesToRadians((segment % segments) * 360.0f / segments);
+        return PLVector3(sinf(theta) * cosf(phi) * 64.0f, cosf(theta) * 64.0f, sinf(theta) * sinf(phi) * 64.0f);
+    };
+
+    unsigned int vertex = 0;
+    for (unsigned int ring = 0; ring < rings; ++ring) {
+        for (unsigned int segment = 0; segment < segments; ++segment) {
+            const PLVector3 quad[6] = {
+                position(ring, segment), position(ring + 1, segment), position(ring, segment + 1),
+                position(ring + 1, segment + 1), position(ring, segment + 1), position(ring + 1, segment),
+            };
+            for (const auto &i : quad) {
+                model->vertices[vertex].position = i;
+                model->indices[vertex] = vertex;
+                vertex++;
+            }
+        }
+    }
+}
+
+void Mesh_RunNormalsBenchmark(const char *name, const BenchmarkMeshes &meshes, unsigned int iterations) {
+    std::list<PLMesh*> list;
+    for (const auto &i : meshes) {
+        list.push_back(&i->mesh);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        Mesh_GenerateFragmentedMeshNormalsLegacy(list);
+    }
+    std::chrono::duration<double, std::milli> legacy_ms = std::chrono::steady_clock::now() - start;
+
+    std::vector<PLVector3> legacy_normals;
+    for (const auto &i : meshes) {
+        for (const auto &vertex : i->vertices) {
+            legacy_normals.push_back(vertex.normal);
+        }
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        Mesh_GenerateFragmentedMeshNormals(list);
+    }
+    std::chrono::duration<double, std::milli> hash_ms = std::chrono::steady_clock::now() - start;
+
+    float max_error = 0;
+    unsigned int n = 0;
+    for (const auto &i : meshes) {
+        for (const auto &vertex : i->vertices) {
+            PLVector3 difference = vertex.normal - legacy_normals[n++];
+            max_error = std::max(max_error, std::sqrt(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z));
+        }
+    }
+
+    LogInfo("%s (%u vertices): legacy %.3fms, hashed %.3fms per iteration (%.1fx), max difference %f\n",
+            name, static_cast<unsigned int>(legacy_normals.size()),
+            legacy_ms.count() / iterations, hash_ms.count() / iterations,
+            legacy_ms.count() / std::max(hash_ms.count(), 0.001), max_error);
+}
+
+void BenchmarkNormalsCommand(unsigned int argc, char **argv) {
+    unsigned int iterations = 10;
+    if (argc > 1) {
+        iterations = std::max(1, atoi(argv[1]));
+    }
+
+    BenchmarkMeshes terrain;
+    Mesh_CreateTerrainBenchmark(terrain);
+    Mesh_RunNormalsBenchmark("Terrain", terrain, iterations);
+
+    BenchmarkMeshes model;
+    Mesh_CreateModelBenchmark(model);
+    Mesh_RunNormalsBenchmark("Model", model, iterations);
+}
+}
+
+void Mesh_Initialize() {
+    plRegisterConsoleCommand("BenchmarkNormals", BenchmarkNormalsCommand,
+                             "Compare normal generation against the original implementation. "
+                             "BenchmarkNormals [iterations]");
+}
@@ -20,4 +20,9 @@
 #include <list>
 #include <PL/platform_mesh.h>
 
-void Mesh_GenerateFragmentedMeshNormals(const std::list<PLMesh*>& meshes);
+void Mesh_Initialize();
+
+void Mesh_GenerateFragmentedMeshNormals(const std::list<PLMesh*>& meshes, float angle_threshold = 0.0f);
+
+void Mesh_OptimizeVertexCache(unsigned int *indices, unsigned int num_indices, unsigned int num_vertices);
+float Mesh_GetAverageCacheMissRatio(const unsigned int *indices, unsigned int num_indices, unsigned int cache_size);
@@ -0,0 +1,193 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+#include "rect_packer.h"
+
+static bool IsContainedIn(const RectPacker::Rect &a, const RectPacker::Rect &b) {
+  return a.x >= b.x && a.y >= b.y && a.x + a.w <= b.x + b.w && a.y + a.h <= b.y + b.h;
+}
+
+static unsigned int NextPowerOfTwo(unsigned int v) {
+  unsigned int p = 1;
+  while(p < v) {
+    p <<= 1;
+  }
+  return p;
+}
+
+RectPacker::RectPacker(unsigned int w, unsigned int h) : width_(w), height_(h) {
+  free_rects_.push_back({0, 0, w, h});
+}
+
+bool RectPacker::Insert(unsigned int w, unsigned int h, unsigned int *x, unsigned int *y) {
+  if(w == 0 || h == 0) {
+    return false;
+  }
+
+  // Best short side fit
+  const Rect *best = nullptr;
+  unsigned int best_short = UINT_MAX, best_long = UINT_MAX;
+  for(const auto &i : free_rects_) {
+    if(i.w < w || i.h < h) {
+      continue;
+    }
+
+    unsigned int leftover_w = i.w - w, leftover_h = i.h - h;
+    unsigned int short_side = std::min(leftover_w, leftover_h);
+    unsigned int long_side = std::max(leftover_w, leftover_h);
+    if(short_side < best_short || (short_side == best_short && long_side < best_long)) {
+      best = &i;
+      best_short = short_side;
+      best_long = long_side;
+    }
+  }
+
+  if(best == nullptr) {
+    return false;
+  }
+
+  Rect used = {best->x, best->y, w, h};
+  for(size_t i = 0; i < free_rects_.size();) {
+    if(SplitFreeRect(free_rects_[i], used)) {
+      free_rects_[i] = free_rects_.back();
+      free_rects_.pop_back();
+    } else {
+      ++i;
+    }
+  }
+
+  PruneFreeRects();
+
+  used_area_ += static_cast<unsigned long>(w) * h;
+
+  *x = used.x;
+  *y = used.y;
+  return true;
+}
+
+/**
+ * Carves the used area out of the given free one, keeping whatever's
+ * left over on each side. Returns false if they don't overlap.
+ */
+bool RectPacker::SplitFreeRect(const Rect &free_rect, const Rect &used_rect) {
+  if(used_rect.x >= free_rect.x + free_rect.w || used_rect.x + used_rect.w <= free_rect.x ||
+     used_rect.y >= free_rect.y + free_rect.h || used_rect.y + used_rect.h <= free_rect.y) {
+    return false;
+  }
+
+  if(used_rect.x > free_rect.x) {
+    new_free_rects_.push_back({free_rect.x, free_rect.y, used_rect.x - free_rect.x, free_rect.h});
+  }
+  if(used_rect.x + used_rect.w < free_rect.x + free_rect.w) {
+    new_free_rects_.push_back({used_rect.x + used_rect.w, free_rect.y,
+                               free_rect.x + free_rect.w - (used_rect.x + used_rect.w), free_rect.h});
+  }
+  if(used_rect.y > free_rect.y) {
+    new_free_rects_.push_back({free_rect.x, free_rect.y, free_rect.w, used_rect.y - free_rect.y});
+  }
+  if(used_rect.y + used_rect.h < free_rect.y + free_rect.h) {
+    new_free_rects_.push_back({free_rect.x, used_rect.y + used_rect.h,
+                               free_rect.w, free_rect.y + free_rect.h - (used_rect.y + used_rect.h)});
+  }
+
+  return true;
+}
+
+/**
+ * Merges in the areas left over from the last split,
+ * dropping any that sit entirely within another.
+ */
+void RectPacker::PruneFreeRects() {
+  free_rects_.insert(free_rects_.end(), new_free_rects_.begin(), new_free_rects_.end());
+  new_free_rects_.clear();
+
+  for(size_t i = 0; i < free_rects_.size(); ++i) {
+    for(size_t j = i + 1; j < free_rects_.size(); ++j) {
+      if(IsContainedIn(free_rects_[i], free_rects_[j])) {
+        free_rects_.erase(free_rects_.begin() + i);
+        --i;
+        break;
+      }
+
+      if(IsContainedIn(free_rects_[j], free_rects_[i])) {
+        free_rects_.erase(free_rects_.begin() + j);
+        --j;
+      }
+    }
+  }
+}
+
+bool RectPacker::PackAll(std::vector<Rect> &rects, unsigned int min_w, unsigned int min_h, unsigned int max_size,
+                         unsigned int *w, unsigned int *h) {
+  unsigned long area = 0;
+  unsigned int max_w = 1, max_h = 1;
+  for(const auto &i : rects) {
+    area += static_cast<unsigned long>(i.w) * i.h;
+    max_w = std::max(max_w, i.w);
+    max_h = std::max(max_h, i.h);
+  }
+
+  // Largest first packs considerably tighter
+  std::vector<size_t> order(rects.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&rects](size_t a, size_t b) {
+    unsigned int side_a = std::max(rects[a].w, rects[a].h), side_b = std::max(rects[b].w, rects[b].h);
+    if(side_a != side_b) {
+      return side_a > side_b;
+    }
+    return rects[a].w * rects[a].h > rects[b].w * rects[b].h;
+  });
+
+  unsigned int bin_w = NextPowerOfTwo(std::max(min_w, max_w));
+  unsigned int bin_h = NextPowerOfTwo(std::max(min_h, max_h));
+  while(static_cast<unsigned long>(bin_w) * bin_h < area) {
+    if(bin_w <= bin_h) {
+      bin_w <<= 1;
+    } else {
+      bin_h <<= 1;
+    }
+  }
+
+  while(bin_w <= max_size && bin_h <= max_size) {
+    RectPacker packer(bin_w, bin_h);
+    bool status = true;
+    for(size_t i : order) {
+      if(!packer.Insert(rects[i].w, rects[i].h, &rects[i].x, &rects[i].y)) {
+        status = false;
+        break;
+      }
+    }
+
+    if(status) {
+      *w = bin_w;
+      *h = bin_h;
+      return true;
+    }
+
+    if(bin_w <= bin_h) {
+      bin_w <<= 1;
+    } else {
+      bin_h <<= 1;
+    }
+  }
+
+  return false;
+}
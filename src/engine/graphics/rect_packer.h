@@ -0,0 +1,53 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+/* MaxRects bin packer, after Jylänki's "A Thousand Ways to Pack the Bin".
+ * Each rectangle goes into whichever free area leaves the shortest side
+ * over, and the free list is split and pruned around it afterwards. */
+class RectPacker {
+ public:
+  struct Rect {
+    unsigned int x, y, w, h;
+  };
+
+  RectPacker(unsigned int w, unsigned int h);
+
+  bool Insert(unsigned int w, unsigned int h, unsigned int *x, unsigned int *y);
+
+  unsigned int GetWidth() const { return width_; }
+  unsigned int GetHeight() const { return height_; }
+  unsigned long GetUsedArea() const { return used_area_; }
+
+  // Positions all of the given rectangles within the smallest power of two bin
+  // that fits them, no smaller than min_w x min_h and no larger than max_size.
+  static bool PackAll(std::vector<Rect> &rects, unsigned int min_w, unsigned int min_h, unsigned int max_size,
+                      unsigned int *w, unsigned int *h);
+
+ private:
+  bool SplitFreeRect(const Rect &free_rect, const Rect &used_rect);
+  void PruneFreeRects();
+
+  unsigned int width_, height_;
+  unsigned long used_area_{0};
+
+  std::vector<Rect> free_rects_;
+  std::vector<Rect> new_free_rects_;
+};
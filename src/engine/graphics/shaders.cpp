@@ -182,6 +182,26 @@ ShaderProgram* Shaders_GetProgram( const std::string& name ) {
 	return i->second;
 }
 
+/**
+ * Rebuild any shader programs that make use of the given stage.
+ * @param path Path to the vertex or fragment stage.
+ */
+void Shaders_RebuildProgramsUsingStage( const std::string& path ) {
+	for ( const auto& program : programs ) {
+		if ( !program.second->UsesStage( path ) ) {
+			continue;
+		}
+
+		try {
+			program.second->Rebuild();
+		} catch ( const std::exception& exception ) {
+			LogWarn( "Failed to rebuild shader program, \"%s\" (%s)!\n", program.first.c_str(), exception.what() );
+		}
+	}
+
+	Shaders_SetProgramByName( lastProgramName );
+}
+
 void Shaders_SetProgramByName( const std::string& name ) {
 	ShaderProgram* shaderProgram = Shaders_GetProgram( name );
 	if ( shaderProgram == nullptr ) {
@@ -217,7 +237,7 @@ ShaderProgram::~ShaderProgram() {
 
 void ShaderProgram::Rebuild() {
 	PLShaderProgram* newShaderProgram = plCreateShaderProgram();
-	if ( newShaderProgram ) {
+	if ( newShaderProgram == nullptr ) {
 		throw std::runtime_error( plGetError());
 	}
 
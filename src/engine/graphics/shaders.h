@@ -26,6 +26,8 @@ public:
 
 	void Rebuild();
 
+	bool UsesStage( const std::string& path ) const { return ( path == vertPath || path == fragPath ); }
+
 	void Enable();
 	void Disable();
 
@@ -45,6 +47,7 @@ private:
 ShaderProgram* Shaders_GetProgram( const std::string& name );
 
 void Shaders_SetProgramByName( const std::string& name );
+void Shaders_RebuildProgramsUsingStage( const std::string& path );
 
 void Shaders_Initialize();
 void Shaders_Shutdown();
@@ -0,0 +1,144 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+// Needs to come before anything that pulls in gl.h
+#include <GL/glew.h>
+
+#include "../engine.h"
+
+#include "display.h"
+#include "image_decode.h"
+#include "texture_array.h"
+
+TextureArray::~TextureArray() {
+  if(texture_ != 0) {
+    glDeleteTextures(1, &texture_);
+  }
+}
+
+bool TextureArray::IsSupported() {
+  // EXT_texture_array alone isn't enough, we also need mipmap generation and GLSL 1.30
+  return GLEW_VERSION_3_0;
+}
+
+bool TextureArray::AddImage(const std::string &path) {
+  const char *find = u_find2(path.c_str(), supported_image_formats, false);
+  if(find == nullptr) {
+    return false;
+  }
+
+  sources_.emplace_back(find);
+  return true;
+}
+
+/**
+ * Nearest-neighbour resample, only here for the odd
+ * image that doesn't match the rest of the set.
+ */
+static void ResampleImage(const PLImage *image, unsigned int w, unsigned int h, uint8_t *dst) {
+  for(unsigned int y = 0; y < h; ++y) {
+    const uint8_t *row = image->data[0] + ((y * image->height) / h) * image->width * 4;
+    for(unsigned int x = 0; x < w; ++x) {
+      memcpy(dst, row + ((x * image->width) / w) * 4, 4);
+      dst += 4;
+    }
+  }
+}
+
+bool TextureArray::Finalize() {
+  if(sources_.empty()) {
+    LogWarn("Failed to finalize texture array, no textures added!\n");
+    return false;
+  }
+
+  if(!IsSupported()) {
+    LogWarn("Array textures are not supported by the current driver!\n");
+    return false;
+  }
+
+  GLint max_layers;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+  if(sources_.size() > static_cast<size_t>(max_layers)) {
+    LogWarn("Too many layers for texture array, %u vs %d!\n", GetNumLayers(), max_layers);
+    return false;
+  }
+
+  std::vector<PLImage *> images = Image_DecodeParallel(sources_);
+  if(std::find(images.begin(), images.end(), nullptr) != images.end()) {
+    for(auto &image : images) {
+      if(image != nullptr) {
+        plDestroyImage(image);
+      }
+    }
+    return false;
+  }
+
+  // The first image decides the size of every layer
+  width_ = images[0]->width;
+  height_ = images[0]->height;
+
+  std::vector<uint8_t> layers(static_cast<size_t>(width_) * height_ * 4 * images.size());
+  for(size_t i = 0; i < images.size(); ++i) {
+    uint8_t *dst = &layers[static_cast<size_t>(width_) * height_ * 4 * i];
+    if(images[i]->width == width_ && images[i]->height == height_) {
+      memcpy(dst, images[i]->data[0], static_cast<size_t>(width_) * height_ * 4);
+    } else {
+      LogWarn("Resampling \"%s\" from %ux%u to %ux%u for texture array!\n",
+              sources_[i].c_str(), images[i]->width, images[i]->height, width_, height_);
+      ResampleImage(images[i], width_, height_, dst);
+    }
+
+    plDestroyImage(images[i]);
+  }
+
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width_, height_, GetNumLayers(), 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, layers.data());
+
+  // Each layer is filtered down separately, so there's nothing to bleed
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+  bool filter = cv_graphics_texture_filter->b_value;
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter ? GL_LINEAR : GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  if(glGetError() != GL_NO_ERROR) {
+    LogWarn("Failed to upload texture array!\n");
+    glDeleteTextures(1, &texture_);
+    texture_ = 0;
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Binds the array to the first texture unit, alongside
+ * whatever 2D texture the draw call itself binds there.
+ */
+void TextureArray::Bind() const {
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+}
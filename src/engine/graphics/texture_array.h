@@ -0,0 +1,53 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Each image is given its own layer of a 2D array texture, so
+ * they're sampled and mipmapped in isolation from one another,
+ * with none of the gutters or coordinate remapping an atlas needs.
+ * Layers all share one size, anything else is resampled to match
+ * the first image added.
+ *
+ * The platform library only deals in 2D textures, so this talks to
+ * GL directly and needs GL 3.0 for array textures, glGenerateMipmap
+ * and sampler2DArray. Check IsSupported before choosing it over an
+ * atlas. */
+class TextureArray {
+ public:
+  TextureArray() = default;
+  ~TextureArray();
+
+  static bool IsSupported();
+
+  bool AddImage(const std::string &path);
+
+  bool Finalize();
+
+  void Bind() const;
+
+  unsigned int GetNumLayers() const { return static_cast<unsigned int>(sources_.size()); }
+
+ protected:
+ private:
+  std::vector<std::string> sources_;
+
+  unsigned int width_{0};
+  unsigned int height_{0};
+
+  unsigned int texture_{0};
+};
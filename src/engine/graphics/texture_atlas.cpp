@@ -15,24 +15,33 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include "../engine.h"
 
+#include "../mod_support.h"
+
+#include "../../shared/dxt.h"
+
 #include "display.h"
+#include "image_decode.h"
+#include "rect_packer.h"
 #include "texture_atlas.h"
 
+#include <sys/stat.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define ATLAS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace openhow;
 
-TextureAtlas::TextureAtlas(int w, int h) : width_(w), height_(h) {
+TextureAtlas::TextureAtlas(int w, int h, unsigned int padding) : width_(w), height_(h), padding_(padding) {
   texture_ = Engine::Resource()->GetFallbackTexture();
 }
 
 TextureAtlas::~TextureAtlas() {
-  for(auto& id : images_by_name_) {
-    PLImage *image = id.second;
-    plDestroyImage(image);
-    id.second = nullptr;
-  }
-
   if(texture_ != Engine::Resource()->GetFallbackTexture()) {
     // TODO: reintroduce once we have a wrapper around PLModel to hold this!
     //plDestroyTexture(texture_);
@@ -40,27 +49,26 @@ TextureAtlas::~TextureAtlas() {
 }
 
 bool TextureAtlas::AddImage(const std::string &path, bool absolute) {
-  const auto image = images_by_name_.find(path);
-  if(image != images_by_name_.end()) {
+  const auto image = sources_.find(path);
+  if(image != sources_.end()) {
     return true;
   }
 
-  char full_path[PL_SYSTEM_MAX_PATH];
+  std::string full_path;
   if(absolute) {
-    strncpy(full_path, path.c_str(), sizeof(full_path) - 1);
+    if(!plFileExists(path.c_str())) {
+      return false;
+    }
+    full_path = path;
   } else {
-    snprintf(full_path, sizeof(full_path) - 1, "%s", u_find2(path.c_str(), supported_image_formats, false));
-  }
-
-  auto* img = static_cast<PLImage *>(u_alloc(1, sizeof(PLImage), true));
-  if(!plLoadImage(full_path, img)) {
-    u_free(img);
-    return false;
+    const char *find = u_find2(path.c_str(), supported_image_formats, false);
+    if(find == nullptr) {
+      return false;
+    }
+    full_path = find;
   }
 
-  plConvertPixelFormat(img, PL_IMAGEFORMAT_RGBA8);
-  images_by_name_.emplace(path, img);
-  images_by_height_.emplace(img->height, img);
+  sources_.emplace(path, full_path);
   return true;
 }
 
@@ -70,55 +78,397 @@ void TextureAtlas::AddImages(const std::vector<std::string> &textures) {
   }
 }
 
-void TextureAtlas::Finalize() {
-  if(images_by_height_.empty()) {
-    LogWarn("Failed to finalize texture atlas, no textures loaded!\n");
-    return;
+/**
+ * Fills whatever part of the cell lies outside of the image by
+ * repeating the image's outermost texels. Bounds are exclusive.
+ */
+static void ExtrudeCell(uint8_t *data, unsigned int width,
+                        unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+                        unsigned int cell_x0, unsigned int cell_y0, unsigned int cell_x1, unsigned int cell_y1) {
+  const size_t stride = width * 4;
+  for(unsigned int y = y0; y < y1; ++y) {
+    uint8_t *row = data + y * stride;
+    for(unsigned int x = cell_x0; x < x0; ++x) {
+      memcpy(row + x * 4, row + x0 * 4, 4);
+    }
+    for(unsigned int x = x1; x < cell_x1; ++x) {
+      memcpy(row + x * 4, row + (x1 - 1) * 4, 4);
+    }
   }
 
-  // Figure out how we'll organise the atlas
-  unsigned int w = width_, h = height_;
-  unsigned int max_h = 0;
-  unsigned int cur_y = 0, cur_x = 0;
-  for(auto i = images_by_height_.rbegin(); i != images_by_height_.rend(); ++i) {
-    PLImage *image = i->second;
-    if(image->height > max_h) {
-      max_h = image->height;
+  // Rows above and below, which takes care of the corners too
+  const size_t row_size = (cell_x1 - cell_x0) * 4;
+  for(unsigned int y = cell_y0; y < y0; ++y) {
+    memcpy(data + y * stride + cell_x0 * 4, data + y0 * stride + cell_x0 * 4, row_size);
+  }
+  for(unsigned int y = y1; y < cell_y1; ++y) {
+    memcpy(data + y * stride + cell_x0 * 4, data + (y1 - 1) * stride + cell_x0 * 4, row_size);
+  }
+}
+
+/**
+ * Averages each 2x2 block across the two rows, writing out n texels.
+ */
+static void DownsampleRow(const uint8_t *row0, const uint8_t *row1, uint8_t *out, unsigned int n) {
+#if defined(ATLAS_USE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi16(2);
+  for(; n >= 2; n -= 2, row0 += 16, row1 += 16, out += 8) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1));
+    // Sum vertically, then fold each pair of neighbouring texels together
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+    __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), round), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(sum, sum));
+  }
+#endif
+
+  for(; n > 0; --n, row0 += 8, row1 += 8, out += 4) {
+    for(unsigned int i = 0; i < 4; ++i) {
+      out[i] = static_cast<uint8_t>((row0[i] + row0[4 + i] + row1[i] + row1[4 + i] + 2) / 4);
     }
+  }
+}
+
+static unsigned int AlignCell(unsigned int size) {
+  return (size + (ATLAS_MIP_ALIGNMENT - 1)) & ~(ATLAS_MIP_ALIGNMENT - 1u);
+}
 
-    if(cur_x == 0 && image->width > w) {
-      w = image->width;
-    } else if(cur_x + image->width > w) {
-      cur_y += max_h;
-      cur_x = max_h = 0;
+static inline unsigned int Clamp(unsigned int v, unsigned int min, unsigned int max) {
+  return v < min ? min : (v > max ? max : v);
+}
+
+void TextureAtlas::GenerateMipLevels(PLImage *cache) {
+  unsigned int clean_levels = 0;
+  while((1u << (clean_levels + 1)) <= ATLAS_MIP_ALIGNMENT) {
+    clean_levels++;
+  }
+
+  unsigned int width = cache->width, height = cache->height;
+  for(unsigned int level = 1; level < cache->levels; ++level) {
+    unsigned int src_width = width, src_height = height;
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+
+    const uint8_t *src = cache->data[level - 1];
+    cache->data[level] = static_cast<uint8_t *>(u_alloc(width * height, 4, true));
+    uint8_t *dst = cache->data[level];
+
+    // Cells are too small to stay apart by now, so just filter everything
+    if(level > clean_levels) {
+      Dxt_GenerateMipLevel(src, src_width, src_height, dst);
+      continue;
     }
 
-    if(cur_y + image->height > h) {
-      h = cur_y + image->height;
+    const unsigned int prev = level - 1;
+    for(const auto &i : textures_) {
+      const Index &texture = i.second;
+
+      // Texels covered by the image at the previous level and this one
+      unsigned int sx0 = texture.x >> prev, sx1 = (texture.x + texture.w + (1u << prev) - 1) >> prev;
+      unsigned int sy0 = texture.y >> prev, sy1 = (texture.y + texture.h + (1u << prev) - 1) >> prev;
+      unsigned int x0 = texture.x >> level, x1 = (texture.x + texture.w + (1u << level) - 1) >> level;
+      unsigned int y0 = texture.y >> level, y1 = (texture.y + texture.h + (1u << level) - 1) >> level;
+
+      // Texels sampled from outside of the image are clamped back to its edge,
+      // only those in the middle of the row can take the fast path
+      unsigned int fast_x0 = Clamp((sx0 + 1) / 2, x0, x1);
+      unsigned int fast_x1 = Clamp(sx1 / 2, fast_x0, x1);
+      for(unsigned int y = y0; y < y1; ++y) {
+        const uint8_t *row0 = src + Clamp(y * 2, sy0, sy1 - 1) * src_width * 4;
+        const uint8_t *row1 = src + Clamp(y * 2 + 1, sy0, sy1 - 1) * src_width * 4;
+        uint8_t *out = dst + y * width * 4;
+        for(unsigned int x = x0; x < x1; ++x) {
+          if(x == fast_x0 && fast_x1 > fast_x0) {
+            DownsampleRow(row0 + x * 8, row1 + x * 8, out + x * 4, fast_x1 - fast_x0);
+            x = fast_x1 - 1;
+            continue;
+          }
+
+          unsigned int c0 = Clamp(x * 2, sx0, sx1 - 1) * 4, c1 = Clamp(x * 2 + 1, sx0, sx1 - 1) * 4;
+          for(unsigned int j = 0; j < 4; ++j) {
+            out[x * 4 + j] = static_cast<uint8_t>((row0[c0 + j] + row0[c1 + j] + row1[c0 + j] + row1[c1 + j] + 2) / 4);
+          }
+        }
+      }
+
+      ExtrudeCell(dst, width, x0, y0, x1, y1,
+                  texture.cell_x >> level, texture.cell_y >> level,
+                  (texture.cell_x + texture.cell_w) >> level, (texture.cell_y + texture.cell_h) >> level);
     }
+  }
+}
 
-    u_assert(image->path[0] != '\0', "Invalid image name!");
-    const char *filename = plGetFileName(image->path);
-    const char *extension = plGetFileExtension(image->path);
-    std::string index_name = std::string(filename).substr(0, strlen(filename) - (strlen(extension) + 1));
-    textures_.emplace(index_name, Index {
-        .x = cur_x,
-        .y = cur_y,
-        .w = image->width,
-        .h = image->height,
-        .image = image
-    });
+static std::string GetIndexName(const char *path) {
+  const char *filename = plGetFileName(path);
+  const char *extension = plGetFileExtension(path);
+  return std::string(filename).substr(0, strlen(filename) - (strlen(extension) + 1));
+}
 
-    cur_x += image->width;
+/**
+ * Hashes the current version of the given image into the seed, going by
+ * its size and modification time, or otherwise its contents.
+ */
+static bool HashSourceImage(const char *path, uint32_t *seed) {
+  const void *data;
+  size_t size;
+  if(Mod_MapFile(path, &data, &size)) {
+    *seed = u_hash(data, size, *seed);
+    return true;
+  }
+
+  char local_path[PL_SYSTEM_MAX_PATH];
+  if(!Mod_GetLocalPath(path, local_path, sizeof(local_path))) {
+    snprintf(local_path, sizeof(local_path), "%s", path);
   }
 
-  // Ensure power of two for final atlas
-  h = static_cast<unsigned int>(pow(2, ceil(log(h) / log(2))));
-  w = static_cast<unsigned int>(pow(2, ceil(log(w) / log(2))));
+  struct stat buf;
+  if(stat(local_path, &buf) == 0) {
+    int64_t stamp[2] = {static_cast<int64_t>(buf.st_size), static_cast<int64_t>(buf.st_mtime)};
+    *seed = u_hash(stamp, sizeof(stamp), *seed);
+    return true;
+  }
+
+  PLFile *file = plOpenFile(path, false);
+  if(file == nullptr) {
+    return false;
+  }
+
+  std::vector<uint8_t> contents(plGetFileSize(file));
+  bool status = (plReadFile(file, contents.data(), 1, contents.size()) == contents.size());
+  plCloseFile(file);
+  *seed = u_hash(contents.data(), contents.size(), *seed);
+  return status;
+}
 
-  // Image pointers will be freed when we're done with textures list
-  images_by_name_.clear();
-  images_by_height_.clear();
+/**
+ * Generates the hashes identifying this atlas, from the images going into it
+ * and how they're to be laid out. The first names the cache file and the
+ * second is stored within it, to catch the odd collision.
+ */
+bool TextureAtlas::GetSourcesHash(uint32_t *name_hash, uint32_t *check_hash) const {
+  const uint32_t settings[] = {ATLAS_CACHE_VERSION, static_cast<uint32_t>(width_), static_cast<uint32_t>(height_),
+                               padding_, ATLAS_MIP_ALIGNMENT};
+  uint32_t stamps = u_hash(settings, sizeof(settings), U_HASH_SEED);
+  std::string names;
+  for(const auto &i : sources_) {
+    names += i.second + '\n';
+    if(!HashSourceImage(i.second.c_str(), &stamps)) {
+      return false;
+    }
+  }
+
+  *name_hash = u_hash(names.data(), names.size(), stamps);
+  *check_hash = u_hash(names.data(), names.size(), stamps ^ 0x9e3779b9u);
+  return true;
+}
+
+typedef struct __attribute__((packed)) AtlasCacheHeader {
+  char identifier[4]; /* ATLC */
+  uint32_t version;
+  uint32_t check_hash;
+  uint16_t width;
+  uint16_t height;
+  uint16_t levels;
+  uint16_t num_textures;
+  float efficiency;
+} AtlasCacheHeader;
+
+typedef struct __attribute__((packed)) AtlasCacheIndex {
+  char name[64];
+  uint32_t x, y, w, h;
+  uint32_t cell_x, cell_y, cell_w, cell_h;
+} AtlasCacheIndex;
+
+/**
+ * Restores the atlas from the cache, uploading the image straight
+ * from the mapping. Returns false if it's missing or out of date.
+ */
+bool TextureAtlas::LoadCache(const std::string &path, uint32_t check_hash) {
+  UMappedFile file;
+  if(!u_map_file(path.c_str(), &file)) {
+    return false;
+  }
+
+  const auto *header = static_cast<const AtlasCacheHeader *>(file.data);
+  if(file.size < sizeof(AtlasCacheHeader) ||
+     strncmp(header->identifier, "ATLC", 4) != 0 ||
+     header->version != ATLAS_CACHE_VERSION ||
+     header->check_hash != check_hash ||
+     header->width == 0 || header->height == 0 ||
+     header->levels == 0 || header->levels > DXT_MAX_LEVELS) {
+    u_unmap_file(&file);
+    return false;
+  }
+
+  size_t size = sizeof(AtlasCacheHeader) + header->num_textures * sizeof(AtlasCacheIndex);
+  uint8_t *levels[DXT_MAX_LEVELS];
+  unsigned int w = header->width, h = header->height;
+  for(unsigned int i = 0; i < header->levels; ++i) {
+    levels[i] = static_cast<uint8_t *>(file.data) + size;
+    size += w * h * 4;
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+
+  if(size != file.size) {
+    u_unmap_file(&file);
+    LogWarn("Invalid atlas cache, \"%s\"!\n", path.c_str());
+    return false;
+  }
+
+  const auto *indices = reinterpret_cast<const AtlasCacheIndex *>(header + 1);
+  for(unsigned int i = 0; i < header->num_textures; ++i) {
+    Index index;
+    index.x = indices[i].x;
+    index.y = indices[i].y;
+    index.w = indices[i].w;
+    index.h = indices[i].h;
+    index.cell_x = indices[i].cell_x;
+    index.cell_y = indices[i].cell_y;
+    index.cell_w = indices[i].cell_w;
+    index.cell_h = indices[i].cell_h;
+    index.image = nullptr;
+    textures_.emplace(std::string(indices[i].name, strnlen(indices[i].name, sizeof(indices[i].name))), index);
+  }
+
+  efficiency_ = header->efficiency;
+
+  PLImage cache;
+  memset(&cache, 0, sizeof(PLImage));
+  cache.width = header->width;
+  cache.height = header->height;
+  cache.levels = header->levels;
+  cache.colour_format = PL_COLOURFORMAT_RGBA;
+  cache.format = PL_IMAGEFORMAT_RGBA8;
+  cache.data = levels;
+  cache.size = cache.width * cache.height * 4;
+  snprintf(cache.path, sizeof(cache.path), "%s", path.c_str());
+  Upload(&cache);
+
+  u_unmap_file(&file);
+  return true;
+}
+
+void TextureAtlas::WriteCache(const std::string &path, uint32_t check_hash, const PLImage *cache) const {
+  size_t pos = path.find_last_of('/');
+  if(!plCreatePath(path.substr(0, pos).c_str())) {
+    return;
+  }
+
+  std::vector<AtlasCacheIndex> indices;
+  for(const auto &i : textures_) {
+    AtlasCacheIndex index;
+    memset(&index, 0, sizeof(AtlasCacheIndex));
+    if(i.first.length() >= sizeof(index.name)) {
+      LogWarn("Texture name is too long to cache, \"%s\"!\n", i.first.c_str());
+      return;
+    }
+
+    strcpy(index.name, i.first.c_str());
+    index.x = i.second.x;
+    index.y = i.second.y;
+    index.w = i.second.w;
+    index.h = i.second.h;
+    index.cell_x = i.second.cell_x;
+    index.cell_y = i.second.cell_y;
+    index.cell_w = i.second.cell_w;
+    index.cell_h = i.second.cell_h;
+    indices.push_back(index);
+  }
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if(fp == nullptr) {
+    LogWarn("Failed to open, \"%s\"!\n", path.c_str());
+    return;
+  }
+
+  AtlasCacheHeader header;
+  memset(&header, 0, sizeof(AtlasCacheHeader));
+  memcpy(header.identifier, "ATLC", 4);
+  header.version = ATLAS_CACHE_VERSION;
+  header.check_hash = check_hash;
+  header.width = static_cast<uint16_t>(cache->width);
+  header.height = static_cast<uint16_t>(cache->height);
+  header.levels = static_cast<uint16_t>(cache->levels);
+  header.num_textures = static_cast<uint16_t>(indices.size());
+  header.efficiency = efficiency_;
+
+  bool status = (fwrite(&header, sizeof(AtlasCacheHeader), 1, fp) == 1) &&
+                (fwrite(indices.data(), sizeof(AtlasCacheIndex), indices.size(), fp) == indices.size());
+  unsigned int w = cache->width, h = cache->height;
+  for(unsigned int i = 0; i < cache->levels && status; ++i) {
+    status = (fwrite(cache->data[i], 4, w * h, fp) == w * h);
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+
+  u_fclose(fp);
+
+  if(!status) {
+    LogWarn("Failed to write atlas cache, \"%s\"!\n", path.c_str());
+    plDeleteFile(path.c_str());
+  }
+}
+
+/**
+ * Decodes and packs all of the images, returning
+ * the finished atlas along with its mip chain.
+ */
+PLImage *TextureAtlas::BuildImage() {
+  // Sources are sorted by name, and come back in that same order
+  std::vector<std::string> paths;
+  paths.reserve(sources_.size());
+  for(const auto &i : sources_) {
+    paths.push_back(i.second);
+  }
+
+  std::vector<PLImage *> images = Image_DecodeParallel(paths);
+  images.erase(std::remove(images.begin(), images.end(), nullptr), images.end());
+
+  if(images.empty()) {
+    return nullptr;
+  }
+
+  // Figure out how we'll organise the atlas
+  std::vector<RectPacker::Rect> rects;
+  rects.reserve(images.size());
+  for(const auto &i : images) {
+    rects.push_back({0, 0, AlignCell(i->width + padding_ * 2), AlignCell(i->height + padding_ * 2)});
+  }
+
+  unsigned int w, h;
+  if(!RectPacker::PackAll(rects, width_, height_, ATLAS_MAX_SIZE, &w, &h)) {
+    LogWarn("Failed to fit %u images into texture atlas!\n", static_cast<unsigned int>(images.size()));
+    for(auto &image : images) {
+      plDestroyImage(image);
+    }
+    return nullptr;
+  }
+
+  unsigned long used_area = 0;
+  for(size_t i = 0; i < images.size(); ++i) {
+    PLImage *image = images[i];
+    u_assert(image->path[0] != '\0', "Invalid image name!");
+    Index index;
+    index.x = rects[i].x + padding_;
+    index.y = rects[i].y + padding_;
+    index.w = image->width;
+    index.h = image->height;
+    index.cell_x = rects[i].x;
+    index.cell_y = rects[i].y;
+    index.cell_w = rects[i].w;
+    index.cell_h = rects[i].h;
+    index.image = image;
+    textures_.emplace(GetIndexName(image->path), index);
+
+    used_area += static_cast<unsigned long>(image->width) * image->height;
+  }
+
+  efficiency_ = static_cast<float>(used_area) / static_cast<float>(static_cast<unsigned long>(w) * h);
 
   // Now create the atlas itself
   PLImage* cache = plCreateImage(nullptr, w, h, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8);
@@ -126,12 +476,15 @@ void TextureAtlas::Finalize() {
     Error("Failed to generate image cache for texture atlas (%s)!\n", plGetError());
   }
 
-  // todo: generate mipmap levels
+  // Generate the full chain ourselves, rather than leaving it to the driver
+  cache->levels = 1;
+  for(unsigned int i = std::max(w, h); i > 1; i >>= 1) {
+    cache->levels++;
+  }
+
   cache->data = (uint8_t**)u_alloc(cache->levels, sizeof(uint8_t *), true);
   cache->data[0] = (uint8_t*)u_alloc(cache->size, sizeof(uint8_t), true);
 
-  //plReplaceImageColour(cache, {0, 0, 0, 0}, {0, 0, 0, 255});
-
   for(auto& tarr : textures_) {
     Index *texture = &tarr.second;
     uint8_t* pos = cache->data[0] + ((texture->y * cache->width) + texture->x) * 4;
@@ -142,10 +495,18 @@ void TextureAtlas::Finalize() {
       pos += cache->width * 4;
     }
 
-    plFreeImage(texture->image);
+    ExtrudeCell(cache->data[0], cache->width, texture->x, texture->y, texture->x + texture->w, texture->y + texture->h,
+                texture->cell_x, texture->cell_y, texture->cell_x + texture->cell_w, texture->cell_y + texture->cell_h);
     texture->image = nullptr;
   }
 
+  // Duplicate names are only indexed once, so free from the list we loaded
+  for(auto& image : images) {
+    plDestroyImage(image);
+  }
+
+  GenerateMipLevels(cache);
+
 #ifdef _DEBUG
   static unsigned int gen_id = 0;
   if(plCreatePath("./debug/generated/")) {
@@ -156,6 +517,10 @@ void TextureAtlas::Finalize() {
   }
 #endif
 
+  return cache;
+}
+
+void TextureAtlas::Upload(PLImage *cache) {
 	if ( ( texture_ = plCreateTexture() ) == nullptr ) {
 		Error( "Failed to generate atlas texture (%s)!\n", plGetError() );
 	}
@@ -165,8 +530,40 @@ void TextureAtlas::Finalize() {
 	if ( !plUploadTextureImage( texture_, cache ) ) {
 		Error( "Failed to upload texture atlas (%s)!\n", plGetError() );
 	}
+}
+
+/**
+ * Packs all of the images added so far into the atlas' texture.
+ * @return False if there was nothing to pack, or it didn't all fit,
+ * in which case the atlas is left with the fallback texture.
+ */
+bool TextureAtlas::Finalize() {
+  if(sources_.empty()) {
+    LogWarn("Failed to finalize texture atlas, no textures loaded!\n");
+    return false;
+  }
+
+  uint32_t name_hash, check_hash;
+  bool cacheable = GetSourcesHash(&name_hash, &check_hash);
+  char cache_path[PL_SYSTEM_MAX_PATH];
+  snprintf(cache_path, sizeof(cache_path), ATLAS_CACHE_DIR "%08x.atlas", name_hash);
+  if(cacheable && LoadCache(cache_path, check_hash)) {
+    return true;
+  }
+
+  PLImage *cache = BuildImage();
+  if(cache == nullptr) {
+    LogWarn("Failed to finalize texture atlas!\n");
+    return false;
+  }
 
-	plFreeImage( cache );
+  if(cacheable) {
+    WriteCache(cache_path, check_hash, cache);
+  }
+
+  Upload(cache);
+  plFreeImage(cache);
+  return true;
 }
 
 bool TextureAtlas::GetTextureCoords(const std::string &name, float *x, float *y, float *w, float *h) {
@@ -177,16 +574,10 @@ bool TextureAtlas::GetTextureCoords(const std::string &name, float *x, float *y,
     return false;
   }
 
-  // HACK: work around texture leaking until we have a better solution!
-  int shift = 0;
-  if(texture_->filter == PL_TEXTURE_FILTER_MIPMAP_LINEAR) {
-    shift = 1;
-  }
-
-  *x = static_cast<float>(index->second.x + shift) / static_cast<float>(texture_->w);
-  *y = static_cast<float>(index->second.y + shift) / static_cast<float>(texture_->h);
-  *w = static_cast<float>(index->second.w - shift * 2) / static_cast<float>(texture_->w);
-  *h = static_cast<float>(index->second.h - shift * 2) / static_cast<float>(texture_->h);
+  *x = static_cast<float>(index->second.x) / static_cast<float>(texture_->w);
+  *y = static_cast<float>(index->second.y) / static_cast<float>(texture_->h);
+  *w = static_cast<float>(index->second.w) / static_cast<float>(texture_->w);
+  *h = static_cast<float>(index->second.h) / static_cast<float>(texture_->h);
   return true;
 }
 
@@ -198,3 +589,86 @@ std::pair<unsigned int, unsigned int> TextureAtlas::GetTextureSize(const std::st
 
   return std::make_pair(index->second.w, index->second.h);
 }
+
+/* Efficiency Report
+ *
+ * Packs the images in each directory of the current mod,
+ * such as a map's tileset or the textures sitting alongside
+ * a set of models, and reports how much of each atlas ends
+ * up covered by images rather than gutters or empty space.
+ */
+
+static std::map<std::string, std::vector<std::string>> reportImages;
+
+static void AppendReportImage(const char *path) {
+  std::string str = path;
+  size_t pos = str.find_last_of('/');
+  reportImages[pos == std::string::npos ? "" : str.substr(0, pos + 1)].push_back(str);
+}
+
+static void AtlasEfficiencyCommand(unsigned int argc, char **argv) {
+  unsigned int padding = ATLAS_DEFAULT_PADDING;
+  if(argc > 1) {
+    padding = strtoul(argv[1], nullptr, 10);
+  }
+
+  const modDirectory_t *mod = Mod_GetCurrentMod();
+  if(mod == nullptr) {
+    LogWarn("No mod is currently mounted!\n");
+    return;
+  }
+
+  reportImages.clear();
+  for(const auto &i : mod->mountPaths) {
+    for(const char **extension = supported_image_formats; *extension != nullptr; ++extension) {
+      plScanDirectory(i.c_str(), *extension, AppendReportImage, true);
+    }
+  }
+
+  unsigned long total_used = 0, total_area = 0;
+  for(const auto &directory : reportImages) {
+    std::vector<RectPacker::Rect> rects;
+    unsigned long used = 0;
+    for(const auto &path : directory.second) {
+      PLImage image;
+      if(!plLoadImage(path.c_str(), &image)) {
+        continue;
+      }
+
+      rects.push_back({0, 0, AlignCell(image.width + padding * 2), AlignCell(image.height + padding * 2)});
+      used += static_cast<unsigned long>(image.width) * image.height;
+      plFreeImage(&image);
+    }
+
+    if(rects.empty()) {
+      continue;
+    }
+
+    unsigned int w, h;
+    if(!RectPacker::PackAll(rects, 8, 8, ATLAS_MAX_SIZE, &w, &h)) {
+      LogWarn("%s: failed to pack %u images!\n", directory.first.c_str(), static_cast<unsigned int>(rects.size()));
+      continue;
+    }
+
+    unsigned long area = static_cast<unsigned long>(w) * h;
+    LogInfo("%s: %u images in %ux%u, %.1f%% used\n", directory.first.c_str(),
+            static_cast<unsigned int>(rects.size()), w, h, 100.0 * used / area);
+
+    total_used += used;
+    total_area += area;
+  }
+
+  if(total_area == 0) {
+    LogWarn("Found no images to pack!\n");
+    return;
+  }
+
+  LogInfo("%u atlases, %.1f%% used overall with %u texel gutters\n",
+          static_cast<unsigned int>(reportImages.size()), 100.0 * total_used / total_area, padding);
+}
+
+void TextureAtlas_Initialize() {
+  plRegisterConsoleCommand("AtlasEfficiency", AtlasEfficiencyCommand,
+                           "Reports how tightly the images in each directory of the current mod pack. "
+                           "AtlasEfficiency [padding]");
+}
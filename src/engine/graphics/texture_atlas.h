@@ -17,34 +17,68 @@
 
 #pragma once
 
+/* Images are surrounded by a gutter, filled by extruding their
+ * edges outwards, so filtering never picks up a neighbour. */
+#define ATLAS_DEFAULT_PADDING 2
+#define ATLAS_MAX_SIZE        8192
+
+/* Each image's cell is aligned to this, so the first few mip levels
+ * can be generated per image without any one bleeding into another.
+ * Levels past that are filtered across the whole atlas. */
+#define ATLAS_MIP_ALIGNMENT   8
+
+/* Finished atlases are written out here, keyed by the images
+ * that went into them, and reused until any of those change. */
+#define ATLAS_CACHE_DIR       "cache/atlases/"
+#define ATLAS_CACHE_VERSION   1
+
 class TextureAtlas {
  public:
-  TextureAtlas(int w, int h);
+  TextureAtlas(int w, int h, unsigned int padding = ATLAS_DEFAULT_PADDING);
   ~TextureAtlas();
 
+  bool HasTexture(const std::string &name) const { return textures_.find(name) != textures_.end(); }
   bool GetTextureCoords(const std::string &name, float *x, float *y, float *w, float *h);
   std::pair<unsigned int, unsigned int> GetTextureSize(const std::string &name);
 
   bool AddImage(const std::string &path, bool absolute = false);
   void AddImages(const std::vector<std::string> &textures);
 
-  void Finalize();
+  bool Finalize();
 
   PLTexture *GetTexture() { return texture_; }
 
+  // Proportion of the atlas covered by images, excluding their gutters
+  float GetEfficiency() const { return efficiency_; }
+
  protected:
  private:
   struct Index {
     unsigned int x, y, w, h;
+    unsigned int cell_x, cell_y, cell_w, cell_h;  // including the gutter
     PLImage *image;
   };
 
+  bool GetSourcesHash(uint32_t *name_hash, uint32_t *check_hash) const;
+  bool LoadCache(const std::string &path, uint32_t check_hash);
+  void WriteCache(const std::string &path, uint32_t check_hash, const PLImage *cache) const;
+
+  PLImage *BuildImage();
+  void GenerateMipLevels(PLImage *cache);
+  void Upload(PLImage *cache);
+
   int width_{512};
   int height_{8};
+  unsigned int padding_{ATLAS_DEFAULT_PADDING};
+  float efficiency_{0};
 
   std::map<std::string, Index> textures_;
-  std::map<std::string, PLImage *> images_by_name_;
-  std::multimap<unsigned int, PLImage *> images_by_height_;
+
+  // Path as given, and the path it resolved to. Images aren't decoded
+  // until Finalize, and then only if the cache is out of date
+  std::map<std::string, std::string> sources_;
 
   PLTexture *texture_{nullptr};
 };
+
+void TextureAtlas_Initialize();
@@ -0,0 +1,216 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <set>
+
+#include "engine.h"
+#include "mod_support.h"
+#include "hot_reload.h"
+#include "graphics/shaders.h"
+
+#if defined( __linux__ )
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace openhow;
+
+#if defined( __linux__ )
+
+static const modDirectory_t* watchedMod = nullptr;
+
+/**
+ * Reload whatever is cached under the given virtual path.
+ * Paths are relative to the mount point, same as the cache keys.
+ */
+static void HotReload_ProcessChange( const std::string& path ) {
+	const char* ext = plGetFileExtension( path.c_str() );
+	if ( plIsEmptyString( ext ) ) {
+		return;
+	}
+
+	std::string extension = u_stringtolower( ext );
+	std::string strippedPath = path.substr( 0, path.length() - extension.length() - 1 );
+	if ( extension == "png" || extension == "tga" || extension == "bmp" || extension == "tim" ) {
+		Engine::Resource()->ReloadTexture( path );
+
+		// Vtx models bake their textures into an atlas on load, so anything
+		// sitting in the same directory will need to be rebuilt too
+		size_t pos = path.find_last_of( '/' );
+		Engine::Resource()->ReloadModels( pos == std::string::npos ? "" : path.substr( 0, pos + 1 ) );
+	} else if ( extension == "vtx" || extension == "obj" || extension == "min" ) {
+		Engine::Resource()->ReloadModel( path );
+	} else if ( extension == "fac" || extension == "no2" ) {
+		Engine::Resource()->ReloadModel( strippedPath + ".vtx" );
+	} else if ( extension == "vert" || extension == "frag" ) {
+		Shaders_RebuildProgramsUsingStage( path );
+	}
+}
+
+#define WATCH_EVENT_MASK ( IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE )
+
+struct WatchLocation {
+	std::string mountPath;      /// e.g. "mods/how/"
+	std::string relativePath;   /// e.g. "chars/pigs/"
+};
+
+static int notifyDescriptor = -1;
+static std::map<int, WatchLocation> watchLocations;
+
+static void HotReload_AddWatch( const std::string& mountPath, const std::string& relativePath ) {
+	std::string fullPath = mountPath + relativePath;
+	int wd = inotify_add_watch( notifyDescriptor, fullPath.c_str(), WATCH_EVENT_MASK );
+	if ( wd == -1 ) {
+		LogWarn( "Failed to watch \"%s\" (%s)!\n", fullPath.c_str(), strerror( errno ) );
+		return;
+	}
+
+	watchLocations[ wd ] = { mountPath, relativePath };
+
+	DIR* dir = opendir( fullPath.c_str() );
+	if ( dir == nullptr ) {
+		return;
+	}
+
+	struct dirent* entry;
+	while ( ( entry = readdir( dir ) ) != nullptr ) {
+		if ( entry->d_name[ 0 ] == '.' ) {
+			continue;
+		}
+
+		std::string childPath = fullPath + entry->d_name;
+		struct stat buf;
+		if ( stat( childPath.c_str(), &buf ) != 0 || !S_ISDIR( buf.st_mode ) ) {
+			continue;
+		}
+
+		HotReload_AddWatch( mountPath, relativePath + entry->d_name + "/" );
+	}
+
+	closedir( dir );
+}
+
+static void HotReload_ClearWatches() {
+	for ( const auto& i : watchLocations ) {
+		inotify_rm_watch( notifyDescriptor, i.first );
+	}
+
+	watchLocations.clear();
+	watchedMod = nullptr;
+}
+
+static void HotReload_WatchMod( const modDirectory_t* mod ) {
+	watchedMod = mod;
+	if ( mod == nullptr ) {
+		return;
+	}
+
+	for ( const auto& i : mod->mountPaths ) {
+		HotReload_AddWatch( i, "" );
+	}
+
+	LogInfo( "Watching %u directories for changes\n", watchLocations.size() );
+}
+
+void HotReload_Initialize() {
+	notifyDescriptor = inotify_init1( IN_NONBLOCK );
+	if ( notifyDescriptor == -1 ) {
+		LogWarn( "Failed to initialize inotify, hot reloading will be unavailable (%s)!\n", strerror( errno ) );
+	}
+}
+
+void HotReload_Shutdown() {
+	if ( notifyDescriptor == -1 ) {
+		return;
+	}
+
+	HotReload_ClearWatches();
+
+	close( notifyDescriptor );
+	notifyDescriptor = -1;
+}
+
+void HotReload_Poll() {
+	if ( notifyDescriptor == -1 ) {
+		return;
+	}
+
+	if ( !cv_debug_hot_reload->b_value ) {
+		if ( !watchLocations.empty() ) {
+			HotReload_ClearWatches();
+		}
+		return;
+	}
+
+	const modDirectory_t* mod = Mod_GetCurrentMod();
+	if ( mod != watchedMod || watchLocations.empty() ) {
+		HotReload_ClearWatches();
+		HotReload_WatchMod( mod );
+	}
+
+	// Editors tend to produce several events for a single save, so
+	// collect everything first and only reload each path once
+	std::set<std::string> changes;
+
+	alignas( struct inotify_event ) char buf[ 4096 ];
+	ssize_t length;
+	while ( ( length = read( notifyDescriptor, buf, sizeof( buf ) ) ) > 0 ) {
+		for ( char* p = buf; p < buf + length; ) {
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+			p += sizeof( struct inotify_event ) + event->len;
+
+			auto location = watchLocations.find( event->wd );
+			if ( location == watchLocations.end() || event->len == 0 ) {
+				continue;
+			}
+
+			std::string relativePath = location->second.relativePath + event->name;
+			if ( event->mask & IN_ISDIR ) {
+				HotReload_AddWatch( location->second.mountPath, relativePath + "/" );
+				continue;
+			}
+
+			// Files are picked up on close, rather than creation
+			if ( event->mask & IN_CREATE ) {
+				continue;
+			}
+
+			changes.emplace( relativePath );
+		}
+	}
+
+	for ( const auto& i : changes ) {
+		LogInfo( "Detected change to \"%s\", reloading...\n", i.c_str() );
+		HotReload_ProcessChange( i );
+	}
+}
+
+#else
+
+void HotReload_Initialize() {
+	LogInfo( "Hot reloading is not supported on this platform\n" );
+}
+
+void HotReload_Shutdown() {}
+
+void HotReload_Poll() {}
+
+#endif
@@ -0,0 +1,31 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Hot Reload
+ *
+ * Watches the directories mounted by the current mod
+ * and reloads any cached textures, models or shader
+ * stages that change on disk. Currently only
+ * implemented on Linux, via inotify.
+ */
+
+void HotReload_Initialize();
+void HotReload_Shutdown();
+
+void HotReload_Poll();
@@ -32,6 +32,7 @@
 #include "editor/window_terrain_import.h"
 #include "editor/window_actor_tree.h"
 #include "editor/window_new_game.h"
+#include "editor/window_resource_stats.h"
 
 #include "language.h"
 
@@ -572,6 +573,7 @@ void UI_DisplayDebugMenu( void ) {
 				if ( ImGui::MenuItem( "Map Config Editor..." ) ) { windows.push_back( new MapConfigEditor() ); }
 			}
 			if ( ImGui::MenuItem( "Model Viewer..." ) ) { windows.push_back( new ModelViewer() ); }
+			if ( ImGui::MenuItem( "Resource Statistics..." ) ) { windows.push_back( new ResourceStatsWindow() ); }
 			ImGui::EndMenu();
 		}
 
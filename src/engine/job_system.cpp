@@ -0,0 +1,280 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+
+#include "engine.h"
+#include "job_system.h"
+
+using namespace openhow;
+
+// Index of the queue belonging to the current thread, zero for anything that isn't a worker
+static thread_local unsigned int workerIndex = 0;
+
+JobSystem::JobSystem( unsigned int numWorkers ) {
+	for ( unsigned int i = 0; i < numWorkers + 1; ++i ) {
+		queues_.emplace_back( new Queue() );
+	}
+
+	for ( unsigned int i = 0; i < numWorkers; ++i ) {
+		workers_.emplace_back( &JobSystem::WorkerThread, this, i + 1 );
+	}
+
+	LogInfo( "Started %u job worker threads\n", numWorkers );
+
+	plRegisterConsoleCommand( "BenchmarkJobs", &JobSystem::BenchmarkJobsCommand,
+							  "Measure the overhead of scheduling jobs, and how well a parallel-for "
+							  "scales. BenchmarkJobs [jobs]" );
+}
+
+/**
+ * Anything still queued at this point is dropped.
+ */
+JobSystem::~JobSystem() {
+	quit_ = true;
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex_ );
+	}
+	wakeCondition_.notify_all();
+
+	for ( auto& i : workers_ ) {
+		i.join();
+	}
+}
+
+void JobSystem::WorkerThread( unsigned int index ) {
+	workerIndex = index;
+
+	while ( !quit_ ) {
+		if ( TryRunJob() ) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( sleepMutex_ );
+		wakeCondition_.wait( lock, [ this ]() { return quit_ || numQueued_ > 0; } );
+	}
+
+	u_scratch_shutdown();
+}
+
+void JobSystem::Push( JobEntry&& entry ) {
+	// Without any workers, there'd be nobody to pick it up
+	if ( workers_.empty() ) {
+		Execute( entry );
+		return;
+	}
+
+	Queue* queue = queues_[ workerIndex ].get();
+	{
+		std::lock_guard<std::mutex> lock( queue->mutex );
+		queue->jobs.push_back( std::move( entry ) );
+	}
+	numQueued_++;
+
+	// Taken so a worker can't miss this between checking and going to sleep
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex_ );
+	}
+	wakeCondition_.notify_one();
+}
+
+/**
+ * Runs the newest job from our own queue, or failing
+ * that the oldest job from anyone else's.
+ */
+bool JobSystem::TryRunJob() {
+	JobEntry entry;
+	bool found = false;
+
+	size_t numQueues = queues_.size();
+	for ( size_t i = 0; i < numQueues && !found; ++i ) {
+		Queue* queue = queues_[ ( workerIndex + i ) % numQueues ].get();
+		std::lock_guard<std::mutex> lock( queue->mutex );
+		if ( queue->jobs.empty() ) {
+			continue;
+		}
+
+		if ( i == 0 ) {
+			entry = std::move( queue->jobs.back() );
+			queue->jobs.pop_back();
+		} else {
+			entry = std::move( queue->jobs.front() );
+			queue->jobs.pop_front();
+		}
+		found = true;
+	}
+
+	if ( !found ) {
+		return false;
+	}
+
+	numQueued_--;
+	Execute( entry );
+	return true;
+}
+
+void JobSystem::Execute( JobEntry& entry ) {
+	entry.job();
+
+	JobCounter* counter = entry.counter;
+	if ( counter == nullptr ) {
+		return;
+	}
+
+	// Last one out releases anything that was waiting on the group
+	std::vector<JobEntry> continuations;
+	{
+		std::lock_guard<std::mutex> lock( counter->mutex_ );
+		if ( --counter->pending_ > 0 ) {
+			return;
+		}
+		continuations.swap( counter->continuations_ );
+	}
+
+	for ( auto& i : continuations ) {
+		Push( std::move( i ) );
+	}
+}
+
+void JobSystem::Run( const Job& job, JobCounter* counter, JobCounter* dependency ) {
+	if ( counter != nullptr ) {
+		counter->pending_++;
+	}
+
+	JobEntry entry{ job, counter };
+	if ( dependency != nullptr ) {
+		std::lock_guard<std::mutex> lock( dependency->mutex_ );
+		if ( dependency->pending_ > 0 ) {
+			dependency->continuations_.push_back( std::move( entry ) );
+			return;
+		}
+	}
+
+	Push( std::move( entry ) );
+}
+
+/**
+ * Runs other jobs until everything tracked by the
+ * counter is done, so it's safe to call from a job.
+ */
+void JobSystem::Wait( JobCounter* counter ) {
+	if ( counter == nullptr ) {
+		return;
+	}
+
+	while ( !counter->IsDone() ) {
+		if ( !TryRunJob() ) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::ParallelFor( size_t count, size_t grain, const std::function<void( size_t, size_t )>& func ) {
+	if ( count == 0 ) {
+		return;
+	}
+
+	if ( grain == 0 ) {
+		grain = std::max( count / ( ( workers_.size() + 1 ) * 4 ), static_cast<size_t>(1) );
+	}
+
+	if ( workers_.empty() || count <= grain ) {
+		func( 0, count );
+		return;
+	}
+
+	JobCounter counter;
+	for ( size_t begin = 0; begin < count; begin += grain ) {
+		size_t end = std::min( begin + grain, count );
+		Run( [ &func, begin, end ]() { func( begin, end ); }, &counter );
+	}
+
+	Wait( &counter );
+}
+
+/************************************************************/
+/* Benchmark */
+
+typedef std::chrono::duration<double, std::micro> BenchmarkDuration;
+
+// Something with enough weight to it that splitting it up should pay off
+static uint32_t BenchmarkWork( size_t i ) {
+	uint32_t v = static_cast<uint32_t>(i) + 1;
+	for ( unsigned int j = 0; j < 256; ++j ) {
+		v ^= v << 13;
+		v ^= v >> 17;
+		v ^= v << 5;
+	}
+	return v;
+}
+
+void JobSystem::BenchmarkJobsCommand( unsigned int argc, char** argv ) {
+	size_t numJobs = 100000;
+	if ( argc > 1 ) {
+		numJobs = strtoul( argv[ 1 ], nullptr, 10 );
+	}
+	if ( numJobs == 0 ) {
+		numJobs = 1;
+	}
+
+	JobSystem* jobs = Engine::Jobs();
+
+	// Cost of getting an empty job through the queues and back again
+	JobCounter counter;
+	auto start = std::chrono::steady_clock::now();
+	for ( size_t i = 0; i < numJobs; ++i ) {
+		jobs->Run( []() {}, &counter );
+	}
+	jobs->Wait( &counter );
+	BenchmarkDuration emptyUs = std::chrono::steady_clock::now() - start;
+
+	// A chain where each job depends on the last, so it's all latency
+	size_t chainLength = std::min( numJobs, static_cast<size_t>(1000) );
+	std::vector<JobCounter> chain( chainLength );
+	start = std::chrono::steady_clock::now();
+	for ( size_t i = 0; i < chainLength; ++i ) {
+		jobs->Run( []() {}, &chain[ i ], i > 0 ? &chain[ i - 1 ] : nullptr );
+	}
+	jobs->Wait( &chain.back() );
+	BenchmarkDuration chainUs = std::chrono::steady_clock::now() - start;
+
+	// And then how well real work scales
+	std::vector<uint32_t> serial( numJobs ), parallel( numJobs );
+	start = std::chrono::steady_clock::now();
+	for ( size_t i = 0; i < numJobs; ++i ) {
+		serial[ i ] = BenchmarkWork( i );
+	}
+	BenchmarkDuration serialUs = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	jobs->ParallelFor( numJobs, 0, [ &parallel ]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			parallel[ i ] = BenchmarkWork( i );
+		}
+	} );
+	BenchmarkDuration parallelUs = std::chrono::steady_clock::now() - start;
+
+	LogInfo( "%u workers, %u jobs\n"
+			 "  empty job:        %.3fus per job\n"
+			 "  dependency chain: %.3fus per link (%u links)\n"
+			 "  parallel for:     serial %.2fms, parallel %.2fms (%.2fx)%s\n",
+			 jobs->GetNumWorkers(), ( unsigned int ) numJobs,
+			 emptyUs.count() / numJobs,
+			 chainUs.count() / chainLength, ( unsigned int ) chainLength,
+			 serialUs.count() / 1000.0, parallelUs.count() / 1000.0, serialUs.count() / parallelUs.count(),
+			 serial == parallel ? "" : ", MISMATCHED" );
+}
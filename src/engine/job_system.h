@@ -0,0 +1,113 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Job System
+ *
+ * A fixed pool of worker threads, each with its own queue of jobs.
+ * Workers take from the back of their own queue and, once that's
+ * empty, steal from the front of somebody else's. Waiting on a
+ * counter runs other jobs in the meantime rather than blocking,
+ * so jobs are free to spawn and wait on jobs of their own.
+ */
+
+namespace openhow {
+
+class JobCounter;
+
+struct JobEntry {
+	std::function<void()> job;
+	JobCounter* counter;
+};
+
+/**
+ * Tracks a group of jobs. Jobs can be made to depend on a
+ * counter, in which case they're held back until every job
+ * tracked by it has finished.
+ */
+class JobCounter {
+ public:
+	bool IsDone() const {
+		if ( pending_.load() > 0 ) {
+			return false;
+		}
+
+		// The last job out may still be releasing continuations, and
+		// we don't want the counter going away underneath it
+		std::lock_guard<std::mutex> lock( mutex_ );
+		return true;
+	}
+
+ private:
+	friend class JobSystem;
+
+	std::atomic<int> pending_{ 0 };
+
+	mutable std::mutex mutex_;
+	std::vector<JobEntry> continuations_;
+};
+
+class JobSystem {
+ public:
+	typedef std::function<void()> Job;
+
+	explicit JobSystem( unsigned int numWorkers );
+	~JobSystem();
+
+	unsigned int GetNumWorkers() const { return static_cast<unsigned int>(workers_.size()); }
+
+	void Run( const Job& job, JobCounter* counter = nullptr, JobCounter* dependency = nullptr );
+	void Wait( JobCounter* counter );
+
+	// Splits [0, count) into ranges of grain or so, and returns once all are done
+	void ParallelFor( size_t count, size_t grain, const std::function<void( size_t, size_t )>& func );
+
+ private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<JobEntry> jobs;
+	};
+
+	void WorkerThread( unsigned int index );
+
+	void Push( JobEntry&& entry );
+	bool TryRunJob();
+	void Execute( JobEntry& entry );
+
+	static void BenchmarkJobsCommand( unsigned int argc, char** argv );
+
+	// The first queue is shared by any thread that isn't a worker
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread> workers_;
+
+	std::atomic<int> numQueued_{ 0 };
+	std::atomic<bool> quit_{ false };
+
+	std::mutex sleepMutex_;
+	std::condition_variable wakeCondition_;
+};
+}
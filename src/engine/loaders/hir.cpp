@@ -23,36 +23,31 @@
 /************************************************************/
 /* Hir Skeleton Format */
 
-HirHandle* Hir_LoadFile(const char* path) {
-    PLFile *file = plOpenFile(path, false);
-    if(file == nullptr) {
-        LogWarn("Failed to load \"%s\", aborting!\n", path);
-        return nullptr;
-    }
+typedef struct __attribute__((packed)) HirBone {
+    int32_t parent;
+    int16_t coords[3];
+    int8_t  unknown[10];
+} HirBone;
 
-    size_t hir_size = plGetFileSize(file);
+static bool Hir_GetNumBones(size_t hir_size, const char* path, const ULoaderContext* context, unsigned int* num_bones) {
     if(hir_size == 0) {
-      plCloseFile(file);
-      LogWarn("Unexpected Hir size in \"%s\", aborting (%s)!\n", path, plGetError());
-      return nullptr;
+        LoaderError(context, "Unexpected Hir size in \"%s\", aborting!\n", path);
+        return false;
     }
 
-    typedef struct __attribute__((packed)) HirBone {
-        int32_t parent;
-        int16_t coords[3];
-        int8_t  unknown[10];
-    } HirBone;
-
-    auto num_bones = (unsigned int)(hir_size / sizeof(HirBone));
-    HirBone bones[num_bones];
-    unsigned int rnum_bones = plReadFile(file, bones, sizeof(HirBone), num_bones);
-    plCloseFile(file);
+    *num_bones = (unsigned int)(hir_size / sizeof(HirBone));
 
-    if(rnum_bones != num_bones) {
-        LogWarn("Failed to read in all bones, %d/%d, aborting!\n", rnum_bones, num_bones);
-        return nullptr;
+    /* in the long term, we won't have this here, we'll probably extend the format
+     * to include the names of each bone (.skeleton format?) */
+    if(*num_bones == 0 || static_cast<SkeletonBone>(*num_bones) > SkeletonBone::MAX_BONES) {
+        LoaderError(context, "Invalid number of bones in \"%s\", %d/%d, aborting!\n", path, *num_bones, SkeletonBone::MAX_BONES);
+        return false;
     }
 
+    return true;
+}
+
+static HirHandle* Hir_CreateHandle(const HirBone* bones, unsigned int num_bones, const char* path, const ULoaderContext* context) {
     /* for debugging */
     static const char* bone_names[static_cast<int>(SkeletonBone::MAX_BONES)]={
             "Pelvis",
@@ -64,28 +59,70 @@ HirHandle* Hir_LoadFile(const char* path) {
             "UpperLeg.R", "LowerLeg.R", "Foot.R",
     };
 
-    /* in the long term, we won't have this here, we'll probably extend the format
-     * to include the names of each bone (.skeleton format?) */
-    if(static_cast<SkeletonBone>(num_bones) >= SkeletonBone::MAX_BONES) {
-        LogWarn("Invalid number of bones, %d/%d, aborting!\n", num_bones, SkeletonBone::MAX_BONES);
+    auto* handle = static_cast<HirHandle *>(u_loader_alloc(context, 1, sizeof(HirHandle)));
+    auto* out = static_cast<PLModelBone *>(u_loader_alloc(context, num_bones, sizeof(PLModelBone)));
+    if(handle == nullptr || out == nullptr) {
+        u_loader_free(context, handle);
+        u_loader_free(context, out);
+        LoaderError(context, "Failed to allocate %d bones for \"%s\"!\n", num_bones, path);
         return nullptr;
     }
 
-    auto* handle = static_cast<HirHandle *>(u_alloc(1, sizeof(HirHandle), true));
-    handle->bones = static_cast<PLModelBone *>(u_alloc(num_bones, sizeof(PLModelBone), true));
+    handle->bones = out;
+    handle->num_bones = num_bones;
     for(unsigned int i = 0; i < num_bones; ++i) {
         handle->bones[i].position = PLVector3(bones[i].coords[0], bones[i].coords[1], bones[i].coords[2]);
         handle->bones[i].parent = bones[i].parent;
         strcpy(handle->bones[i].name, bone_names[i]);
     }
+
     return handle;
 }
 
-void Hir_DestroyHandle(HirHandle* handle) {
+HirHandle* Hir_LoadFile(const char* path, const ULoaderContext* context) {
+    PLFile *file = plOpenFile(path, false);
+    if(file == nullptr) {
+        LoaderError(context, "Failed to load \"%s\", aborting!\n", path);
+        return nullptr;
+    }
+
+    unsigned int num_bones;
+    if(!Hir_GetNumBones(plGetFileSize(file), path, context, &num_bones)) {
+        plCloseFile(file);
+        return nullptr;
+    }
+
+    UScratchMark mark = u_scratch_mark();
+    auto* bones = static_cast<HirBone *>(u_scratch_alloc(num_bones * sizeof(HirBone)));
+    unsigned int rnum_bones = plReadFile(file, bones, sizeof(HirBone), num_bones);
+    plCloseFile(file);
+
+    if(rnum_bones != num_bones) {
+        u_scratch_release(mark);
+        LoaderError(context, "Failed to read in all bones from \"%s\", %d/%d, aborting!\n", path, rnum_bones, num_bones);
+        return nullptr;
+    }
+
+    HirHandle* handle = Hir_CreateHandle(bones, num_bones, path, context);
+    u_scratch_release(mark);
+    return handle;
+}
+
+HirHandle* Hir_LoadMemory(const void* data, size_t size, const char* name, const ULoaderContext* context) {
+    unsigned int num_bones;
+    if(!Hir_GetNumBones(size, name, context, &num_bones)) {
+        return nullptr;
+    }
+
+    /* bones are packed, so they can be read straight out of the span */
+    return Hir_CreateHandle(static_cast<const HirBone *>(data), num_bones, name, context);
+}
+
+void Hir_DestroyHandle(HirHandle* handle, const ULoaderContext* context) {
     if(handle == nullptr) {
         return;
     }
 
-    u_free(handle->bones);
-    u_free(handle);
+    u_loader_free(context, handle->bones);
+    u_loader_free(context, handle);
 }
@@ -0,0 +1,189 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <PL/platform_filesystem.h>
+
+#include "../engine.h"
+#include "../mod_support.h"
+#include "loaders.h"
+
+/* Stress test for the format loaders, which decodes every
+ * model, skeleton and map file in the current mod across
+ * several threads and checks the results against a serial run. */
+
+struct LoaderResult {
+	bool status{ false };
+	uint32_t hash{ 0 };
+	std::string errors;
+};
+
+static std::vector<std::string> stressPaths;
+
+static void Loaders_AppendStressPath( const char* path ) {
+	stressPaths.emplace_back( path );
+}
+
+static void Loaders_CollectErrors( const char* message, void* user ) {
+	static_cast<std::string*>(user)->append( message );
+}
+
+/**
+ * Decodes the given file with the loader matching its extension,
+ * and hashes everything it produced.
+ */
+static LoaderResult Loaders_DecodeFile( const std::string& path ) {
+	LoaderResult result;
+
+	ULoaderContext context{};
+	context.error = Loaders_CollectErrors;
+	context.user = &result.errors;
+
+	const char* p = path.c_str();
+	std::string extension = u_stringtolower( plGetFileExtension( p ) );
+	uint32_t hash = U_HASH_SEED;
+	if ( extension == "vtx" ) {
+		VtxHandle* vtx = Vtx_LoadFile( p, &context );
+		if ( vtx != nullptr ) {
+			hash = u_hash( vtx->vertices, sizeof( PLVertex ) * vtx->num_vertices, hash );
+			result.status = true;
+		}
+		Vtx_DestroyHandle( vtx, &context );
+	} else if ( extension == "fac" ) {
+		FacHandle* fac = Fac_LoadFile( p, &context );
+		if ( fac != nullptr ) {
+			hash = u_hash( fac->triangles, sizeof( FacTriangle ) * fac->num_triangles, hash );
+			hash = u_hash( fac->texture_table, sizeof( FacTextureIndex ) * fac->texture_table_size, hash );
+			result.status = true;
+		}
+		Fac_DestroyHandle( fac, &context );
+	} else if ( extension == "no2" ) {
+		No2Handle* no2 = No2_LoadNormals( p, &context );
+		if ( no2 != nullptr ) {
+			hash = u_hash( no2->normals, sizeof( PLVector3 ) * no2->num_normals, hash );
+			result.status = true;
+		}
+		No2_DestroyHandle( no2, &context );
+	} else if ( extension == "hir" ) {
+		HirHandle* hir = Hir_LoadFile( p, &context );
+		if ( hir != nullptr ) {
+			hash = u_hash( hir->bones, sizeof( PLModelBone ) * hir->num_bones, hash );
+			result.status = true;
+		}
+		Hir_DestroyHandle( hir, &context );
+	} else if ( extension == "pmg" ) {
+		PmgHandle* pmg = Pmg_LoadFile( p, &context );
+		if ( pmg != nullptr ) {
+			hash = u_hash( pmg->chunks, sizeof( PmgChunk ) * pmg->num_chunks, hash );
+			result.status = true;
+		}
+		Pmg_DestroyHandle( pmg, &context );
+	} else if ( extension == "pog" ) {
+		PogHandle* pog = Pog_LoadFile( p, &context );
+		if ( pog != nullptr ) {
+			hash = u_hash( pog->spawns, sizeof( PogSpawn ) * pog->num_spawns, hash );
+			result.status = true;
+		}
+		Pog_DestroyHandle( pog, &context );
+	}
+
+	result.hash = hash;
+	return result;
+}
+
+static void StressLoadersCommand( unsigned int argc, char** argv ) {
+	unsigned int numThreads = std::thread::hardware_concurrency();
+	if ( argc > 1 ) {
+		numThreads = strtoul( argv[ 1 ], nullptr, 10 );
+	}
+	if ( numThreads == 0 ) {
+		numThreads = 4;
+	}
+
+	const modDirectory_t* mod = Mod_GetCurrentMod();
+	if ( mod == nullptr ) {
+		LogWarn( "No mod is currently mounted!\n" );
+		return;
+	}
+
+	static const char* extensions[] = { "vtx", "fac", "no2", "hir", "pmg", "pog" };
+	stressPaths.clear();
+	for ( const auto& i : mod->mountPaths ) {
+		for ( const char* extension : extensions ) {
+			plScanDirectory( i.c_str(), extension, Loaders_AppendStressPath, true );
+		}
+	}
+
+	if ( stressPaths.empty() ) {
+		LogWarn( "Found nothing to decode!\n" );
+		return;
+	}
+
+	std::vector<LoaderResult> serial( stressPaths.size() );
+	auto start = std::chrono::steady_clock::now();
+	for ( size_t i = 0; i < stressPaths.size(); ++i ) {
+		serial[ i ] = Loaders_DecodeFile( stressPaths[ i ] );
+	}
+	std::chrono::duration<double, std::milli> serialMs = std::chrono::steady_clock::now() - start;
+
+	std::vector<LoaderResult> parallel( stressPaths.size() );
+	std::atomic<size_t> next( 0 );
+	std::vector<std::thread> workers;
+	start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < numThreads; ++i ) {
+		workers.emplace_back( [ & ]() {
+			size_t j;
+			while ( ( j = next.fetch_add( 1 ) ) < stressPaths.size() ) {
+				parallel[ j ] = Loaders_DecodeFile( stressPaths[ j ] );
+			}
+			u_scratch_shutdown();
+		} );
+	}
+	for ( auto& i : workers ) {
+		i.join();
+	}
+	std::chrono::duration<double, std::milli> parallelMs = std::chrono::steady_clock::now() - start;
+
+	unsigned int numFailed = 0, numMismatched = 0;
+	for ( size_t i = 0; i < stressPaths.size(); ++i ) {
+		if ( !serial[ i ].status ) {
+			LogWarn( "Failed to decode \"%s\": %s", stressPaths[ i ].c_str(), serial[ i ].errors.c_str() );
+			numFailed++;
+		}
+
+		if ( serial[ i ].status != parallel[ i ].status || serial[ i ].hash != parallel[ i ].hash ||
+			serial[ i ].errors != parallel[ i ].errors ) {
+			LogWarn( "Mismatch between serial and parallel decode of \"%s\"!\n", stressPaths[ i ].c_str() );
+			numMismatched++;
+		}
+	}
+
+	LogInfo( "Decoded %u files (%u failed): serial %.2fms, %u threads %.2fms, %u mismatched\n",
+			 ( unsigned int ) stressPaths.size(), numFailed, serialMs.count(), numThreads, parallelMs.count(),
+			 numMismatched );
+
+	stressPaths.clear();
+}
+
+void Loaders_Initialize( void ) {
+	plRegisterConsoleCommand( "StressLoaders", StressLoadersCommand,
+							  "Decode every model and map file in the current mod serially and across several "
+							  "threads, and compare the results. StressLoaders [threads]" );
+}
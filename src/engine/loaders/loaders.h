@@ -27,7 +27,7 @@
  * MTD : Texture / model package            (done)
  * MMM : Mangled model package
  * MGL : Mangled texture data
- * MIN : PSX model data
+ * MIN : PSX model data                    (partial)
  * FAC : Model faces                        (done)
  * VTX : Model vertices                     (done)
  * NO2 : Model normals                      (done)
@@ -39,11 +39,14 @@
  * PMM : Mangled terrain data
  * PMG : Terrain data                       (done)
  * OFF : File offset sizes                  (done)
+ *
+ * MMF : Cooked model cache                 (done)
  */
 
 #include "../../shared/fac.h"
 #include "../../shared/vtx.h"
 #include "../../shared/no2.h"
+#include "../../shared/mmf.h"
 
 PL_EXTERN_C
 
@@ -51,12 +54,112 @@ typedef struct HirHandle {
   PLModelBone *bones;
   unsigned int num_bones;
 } HirHandle;
-HirHandle *Hir_LoadFile(const char *path);
-void Hir_DestroyHandle(HirHandle *handle);
+/* Reentrant, context may be NULL for the defaults. The LoadMemory
+ * variants parse a file that's already in memory, such as one
+ * mapped from a mod archive, name is only used for errors */
+HirHandle *Hir_LoadFile(const char *path, const ULoaderContext *context);
+HirHandle *Hir_LoadMemory(const void *data, size_t size, const char *name, const ULoaderContext *context);
+void Hir_DestroyHandle(HirHandle *handle, const ULoaderContext *context);
+
+/* Terrain is made up of 16x16 chunks, each with 4x4 tiles */
+#define PMG_CHUNK_ROW           16
+#define PMG_CHUNKS              (PMG_CHUNK_ROW * PMG_CHUNK_ROW)
+#define PMG_CHUNK_ROW_TILES     4
+#define PMG_CHUNK_TILES         (PMG_CHUNK_ROW_TILES * PMG_CHUNK_ROW_TILES)
+#define PMG_CHUNK_ROW_VERTICES  (PMG_CHUNK_ROW_TILES + 1)
+
+typedef struct __attribute__((packed)) PmgVertex {
+  int16_t height;
+  uint16_t lighting;
+} PmgVertex;
+
+typedef struct __attribute__((packed)) PmgTile {
+  int8_t unused0[6];
+  uint8_t type;
+  uint8_t slip;
+  int16_t unused1;
+  uint8_t rotation;
+  uint32_t texture;
+  uint8_t unused2;
+} PmgTile;
+
+typedef struct __attribute__((packed)) PmgChunk {
+  uint16_t offsets[3];
+  uint16_t unknown0;
+  PmgVertex vertices[PMG_CHUNK_ROW_VERTICES * PMG_CHUNK_ROW_VERTICES];
+  uint32_t unknown1;
+  PmgTile tiles[PMG_CHUNK_TILES];
+} PmgChunk;
+
+/* Chunks are stored row by row */
+typedef struct PmgHandle {
+  PmgChunk *chunks;
+  unsigned int num_chunks;
+} PmgHandle;
+PmgHandle *Pmg_LoadFile(const char *path, const ULoaderContext *context);
+PmgHandle *Pmg_LoadMemory(const void *data, size_t size, const char *name, const ULoaderContext *context);
+void Pmg_DestroyHandle(PmgHandle *handle, const ULoaderContext *context);
+
+typedef struct __attribute__((packed)) PogSpawn {
+  char name[16];                /* class name */
+  char unused0[16];
+  int16_t position[3];          /* position in the world */
+  uint16_t index;               /* todo */
+  int16_t angles[3];            /* angles in the world */
+  uint16_t type;                /* todo */
+  int16_t bounds[3];            /* collision bounds */
+  uint16_t bounds_type;         /* box, prism, sphere and none */
+  int16_t energy;
+  uint8_t appearance;
+  uint8_t team;                 /* uk, usa, german, french, japanese, soviet */
+  uint16_t objective;
+  uint8_t objective_actor_id;
+  uint8_t objective_extra[2];
+  uint8_t unused1;
+  uint16_t unused2[8];
+  int16_t fallback_position[3];
+  int16_t extra;
+  int16_t attached_actor_num;
+  int16_t unused3;
+} PogSpawn;
 
+typedef struct PogHandle {
+  PogSpawn *spawns;
+  unsigned int num_spawns;
+} PogHandle;
+PogHandle *Pog_LoadFile(const char *path, const ULoaderContext *context);
+PogHandle *Pog_LoadMemory(const void *data, size_t size, const char *name, const ULoaderContext *context);
+void Pog_DestroyHandle(PogHandle *handle, const ULoaderContext *context);
+
+/* Only partially understood, see doc/file-formats/MIN.md */
+typedef struct __attribute__((packed)) MinFace {
+  uint8_t uv_coords[6];
+  uint16_t vertex_indices[3];
+  uint16_t normal_indices[3];
+  uint16_t texture_index;
+  uint16_t unknown[2];
+} MinFace;
+
+typedef struct __attribute__((packed)) MinVertex {
+  int16_t position[3];
+  int16_t bone_index;
+  int16_t unknown[4];
+} MinVertex;
+
+/* Faces and vertices point directly into the file data */
 typedef struct MinHandle {
-  unsigned int blah;
+  uint8_t *data;
+  size_t size;
+
+  const MinFace *faces;
+  unsigned int num_faces;
+
+  const MinVertex *vertices;
+  unsigned int num_vertices;
 } MinHandle;
 MinHandle *Min_LoadFile(const char *path);
+void Min_DestroyHandle(MinHandle *handle);
+
+void Loaders_Initialize(void);
 
 PL_EXTERN_C_END
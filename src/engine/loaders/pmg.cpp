@@ -0,0 +1,91 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PL/platform_filesystem.h>
+#include "../engine.h"
+#include "loaders.h"
+
+/************************************************************/
+/* Pmg Terrain Format */
+
+static_assert(sizeof(PmgTile) == 16, "Invalid size for PmgTile, should be 16 bytes!");
+static_assert(sizeof(PmgChunk) == 368, "Invalid size for PmgChunk, should be 368 bytes!");
+
+PmgHandle* Pmg_LoadFile(const char* path, const ULoaderContext* context) {
+    PLFile* file = plOpenFile(path, false);
+    if(file == nullptr) {
+        LoaderError(context, "Failed to open tile data, \"%s\", aborting!\n", path);
+        return nullptr;
+    }
+
+    auto* handle = static_cast<PmgHandle *>(u_loader_alloc(context, 1, sizeof(PmgHandle)));
+    auto* chunks = static_cast<PmgChunk *>(u_loader_alloc(context, PMG_CHUNKS, sizeof(PmgChunk)));
+    if(handle == nullptr || chunks == nullptr) {
+        plCloseFile(file);
+        u_loader_free(context, handle);
+        u_loader_free(context, chunks);
+        LoaderError(context, "Failed to allocate chunks for \"%s\"!\n", path);
+        return nullptr;
+    }
+
+    /* chunks are stored exactly as they are on disk, so just read them straight in */
+    unsigned int num_chunks = plReadFile(file, chunks, sizeof(PmgChunk), PMG_CHUNKS);
+    plCloseFile(file);
+
+    if(num_chunks != PMG_CHUNKS) {
+        u_loader_free(context, handle);
+        u_loader_free(context, chunks);
+        LoaderError(context, "Unexpected end of file in \"%s\", %d/%d chunks, aborting!\n", path, num_chunks, PMG_CHUNKS);
+        return nullptr;
+    }
+
+    handle->chunks = chunks;
+    handle->num_chunks = num_chunks;
+    return handle;
+}
+
+PmgHandle* Pmg_LoadMemory(const void* data, size_t size, const char* name, const ULoaderContext* context) {
+    if(size < PMG_CHUNKS * sizeof(PmgChunk)) {
+        LoaderError(context, "Unexpected end of file in \"%s\", %u/%u bytes, aborting!\n", name,
+                    (unsigned int)size, (unsigned int)(PMG_CHUNKS * sizeof(PmgChunk)));
+        return nullptr;
+    }
+
+    auto* handle = static_cast<PmgHandle *>(u_loader_alloc(context, 1, sizeof(PmgHandle)));
+    auto* chunks = static_cast<PmgChunk *>(u_loader_alloc(context, PMG_CHUNKS, sizeof(PmgChunk)));
+    if(handle == nullptr || chunks == nullptr) {
+        u_loader_free(context, handle);
+        u_loader_free(context, chunks);
+        LoaderError(context, "Failed to allocate chunks for \"%s\"!\n", name);
+        return nullptr;
+    }
+
+    memcpy(chunks, data, PMG_CHUNKS * sizeof(PmgChunk));
+
+    handle->chunks = chunks;
+    handle->num_chunks = PMG_CHUNKS;
+    return handle;
+}
+
+void Pmg_DestroyHandle(PmgHandle* handle, const ULoaderContext* context) {
+    if(handle == nullptr) {
+        return;
+    }
+
+    u_loader_free(context, handle->chunks);
+    u_loader_free(context, handle);
+}
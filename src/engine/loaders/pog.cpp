@@ -0,0 +1,114 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PL/platform_filesystem.h>
+#include "../engine.h"
+#include "loaders.h"
+
+/************************************************************/
+/* Pog Actor Spawns Format */
+
+static_assert(sizeof(PogSpawn) == 94, "Invalid size for PogSpawn, should be 94 bytes!");
+
+PogHandle* Pog_LoadFile(const char* path, const ULoaderContext* context) {
+    PLFile* file = plOpenFile(path, false);
+    if(file == nullptr) {
+        LoaderError(context, "Failed to open actor data, \"%s\"!\n", path);
+        return nullptr;
+    }
+
+    bool status = false;
+    uint16_t num_spawns = plReadInt16(file, false, &status);
+    if(!status) {
+        plCloseFile(file);
+        LoaderError(context, "Failed to read Pog indices count in \"%s\"!\n", path);
+        return nullptr;
+    }
+
+    auto* handle = static_cast<PogHandle *>(u_loader_alloc(context, 1, sizeof(PogHandle)));
+    PogSpawn* spawns = nullptr;
+    if(num_spawns > 0) {
+        spawns = static_cast<PogSpawn *>(u_loader_alloc(context, num_spawns, sizeof(PogSpawn)));
+    }
+
+    if(handle == nullptr || (num_spawns > 0 && spawns == nullptr)) {
+        plCloseFile(file);
+        u_loader_free(context, handle);
+        u_loader_free(context, spawns);
+        LoaderError(context, "Failed to allocate %d spawns for \"%s\"!\n", num_spawns, path);
+        return nullptr;
+    }
+
+    unsigned int rnum_spawns = plReadFile(file, spawns, sizeof(PogSpawn), num_spawns);
+    plCloseFile(file);
+
+    if(rnum_spawns != num_spawns) {
+        u_loader_free(context, handle);
+        u_loader_free(context, spawns);
+        LoaderError(context, "Failed to read Pog spawns in \"%s\", %d/%d!\n", path, rnum_spawns, num_spawns);
+        return nullptr;
+    }
+
+    handle->spawns = spawns;
+    handle->num_spawns = num_spawns;
+    return handle;
+}
+
+PogHandle* Pog_LoadMemory(const void* data, size_t size, const char* name, const ULoaderContext* context) {
+    if(size < sizeof(uint16_t)) {
+        LoaderError(context, "Failed to read Pog indices count in \"%s\"!\n", name);
+        return nullptr;
+    }
+
+    const auto* bytes = static_cast<const uint8_t *>(data);
+    unsigned int num_spawns = bytes[0] | (bytes[1] << 8);
+    unsigned int rnum_spawns = (unsigned int)((size - sizeof(uint16_t)) / sizeof(PogSpawn));
+    if(rnum_spawns < num_spawns) {
+        LoaderError(context, "Failed to read Pog spawns in \"%s\", %d/%d!\n", name, rnum_spawns, num_spawns);
+        return nullptr;
+    }
+
+    auto* handle = static_cast<PogHandle *>(u_loader_alloc(context, 1, sizeof(PogHandle)));
+    PogSpawn* spawns = nullptr;
+    if(num_spawns > 0) {
+        spawns = static_cast<PogSpawn *>(u_loader_alloc(context, num_spawns, sizeof(PogSpawn)));
+    }
+
+    if(handle == nullptr || (num_spawns > 0 && spawns == nullptr)) {
+        u_loader_free(context, handle);
+        u_loader_free(context, spawns);
+        LoaderError(context, "Failed to allocate %d spawns for \"%s\"!\n", num_spawns, name);
+        return nullptr;
+    }
+
+    if(num_spawns > 0) {
+        memcpy(spawns, bytes + sizeof(uint16_t), num_spawns * sizeof(PogSpawn));
+    }
+
+    handle->spawns = spawns;
+    handle->num_spawns = num_spawns;
+    return handle;
+}
+
+void Pog_DestroyHandle(PogHandle* handle, const ULoaderContext* context) {
+    if(handle == nullptr) {
+        return;
+    }
+
+    u_loader_free(context, handle->spawns);
+    u_loader_free(context, handle);
+}
@@ -15,12 +15,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
 #include <PL/platform_filesystem.h>
 
 #include "engine.h"
 #include "mod_support.h"
 #include "script/script_config.h"
 
+#include "../shared/maf.h"
+
 using namespace openhow;
 
 /* Mod Management
@@ -101,6 +107,160 @@ const modDirectory_t* Mod_GetCurrentMod() {
 	return currentModification;
 }
 
+/* Mod Archives
+ *
+ * If the extractor was run with --pack, each mod directory also
+ * has a packed copy sat alongside it, e.g. "mods/how.maf". These
+ * are mapped into memory when the mod is mounted, so anything that
+ * can work from a block of memory can fetch its file straight from
+ * the mapping, rather than searching every mounted directory.
+ *
+ * Archives only stand in for a directory that's there loose too,
+ * as everything else is still resolved against the mounted
+ * directories. The archive is packed from that same directory, so
+ * it takes priority over it, and only loose files in a directory
+ * mounted after it can override what's archived. Whether they do is
+ * checked the first time each entry is looked up, and remembered.
+ */
+
+enum {
+	MOD_ENTRY_UNRESOLVED,
+	MOD_ENTRY_ARCHIVED,
+	MOD_ENTRY_OVERRIDDEN,   // a loose copy takes priority
+};
+
+struct ModArchive {
+	UMappedFile file;
+	MafArchive archive;
+	std::unique_ptr<std::atomic<uint8_t>[]> overrides;     /// Per entry, see above
+};
+
+static ModArchive* Mod_OpenArchive( const char* path ) {
+	if ( !plFileExists( path ) ) {
+		return nullptr;
+	}
+
+	auto* archive = new ModArchive();
+	if ( !u_map_file( path, &archive->file ) ) {
+		LogWarn( "Failed to map archive, \"%s\"!\n", path );
+		delete archive;
+		return nullptr;
+	}
+
+	if ( !Maf_OpenMemory( &archive->archive, archive->file.data, archive->file.size ) ) {
+		LogWarn( "Invalid archive, \"%s\"!\n", path );
+		u_unmap_file( &archive->file );
+		delete archive;
+		return nullptr;
+	}
+
+	archive->overrides.reset( new std::atomic<uint8_t>[archive->archive.num_entries] );
+	for ( unsigned int i = 0; i < archive->archive.num_entries; ++i ) {
+		archive->overrides[ i ] = MOD_ENTRY_UNRESOLVED;
+	}
+
+	LogInfo( "Mounted archive \"%s\" (%u files)\n", path, archive->archive.num_entries );
+	return archive;
+}
+
+static void Mod_CloseArchive( ModArchive* archive ) {
+	if ( archive == nullptr ) {
+		return;
+	}
+
+	u_unmap_file( &archive->file );
+	delete archive;
+}
+
+/**
+ * Checks whether any directory mounted after the given location
+ * has a loose copy of the file, which would take priority.
+ */
+static bool Mod_IsOverridden( const std::vector<modLocation_t>& locations, size_t location, const char* path ) {
+	for ( size_t i = location + 1; i < locations.size(); ++i ) {
+		if ( !locations[ i ].loose ) {
+			continue;
+		}
+
+		char loosePath[PL_SYSTEM_MAX_PATH];
+		snprintf( loosePath, sizeof( loosePath ), "%s%s", locations[ i ].path.c_str(), path );
+		if ( plFileExists( loosePath ) ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Fetches the given file from the archives mounted by the current mod,
+ * checking them in the same order the mod overrides its dependencies.
+ * The data points directly into the mapping and is only valid until
+ * the mod is changed.
+ * @param path Path relative to the mod, e.g. "chars/pigs/ac_med.hir".
+ * @return False if the file isn't archived, or a loose copy takes priority,
+ * in which case it should be opened as usual. Loose copies are only
+ * checked for once per file, so any added since won't be picked up
+ * until the mod is mounted again.
+ */
+bool Mod_MapFile( const char* path, const void** data, size_t* size ) {
+	if ( currentModification == nullptr ) {
+		return false;
+	}
+
+	const auto& locations = currentModification->locations;
+	for ( size_t i = locations.size(); i-- > 0; ) {
+		ModArchive* archive = locations[ i ].archive;
+		if ( archive == nullptr ) {
+			continue;
+		}
+
+		const MafEntry* entry = Maf_FindEntry( &archive->archive, path );
+		if ( entry == nullptr ) {
+			continue;
+		}
+
+		std::atomic<uint8_t>& state = archive->overrides[ entry - archive->archive.entries ];
+		if ( state == MOD_ENTRY_UNRESOLVED ) {
+			state = Mod_IsOverridden( locations, i, path ) ? MOD_ENTRY_OVERRIDDEN : MOD_ENTRY_ARCHIVED;
+		}
+
+		if ( state == MOD_ENTRY_OVERRIDDEN ) {
+			return false;
+		}
+
+		*data = Maf_GetEntryData( &archive->archive, entry );
+		*size = entry->size;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Resolves the given path to the loose file it refers to on disk, going
+ * by the same order as Mod_MapFile. Returns false if there's no loose copy.
+ */
+bool Mod_GetLocalPath( const char* path, char* out, size_t outSize ) {
+	if ( currentModification == nullptr ) {
+		return false;
+	}
+
+	const auto& locations = currentModification->locations;
+	for ( auto i = locations.rbegin(); i != locations.rend(); ++i ) {
+		if ( !i->loose ) {
+			continue;
+		}
+
+		snprintf( out, outSize, "%s%s", i->path.c_str(), path );
+		if ( plFileExists( out ) ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /**
  * Unmounts the specified modification.
  */
@@ -111,16 +271,25 @@ static void Mod_Unmount( modDirectory_t* mod ) {
 			plClearMountedLocation( i );
 		}
 
+		for ( const auto& i : mod->locations ) {
+			Mod_CloseArchive( i.archive );
+		}
+
 		mod->mountList.clear();
+		mod->mountPaths.clear();
+		mod->locations.clear();
 	}
 
 	Engine::Resource()->ClearAll();
 }
 
-void Mod_FetchDependencies( modDirectory_t* mod, std::set<std::string>& dirSet ) {
-	const auto& dir = dirSet.find( mod->directory );
-	if ( dir != dirSet.end() ) {
-		LogInfo( "%s is already mounted, skipping\n", mod->directory );
+/**
+ * Builds the list of directories the given mod depends upon, with
+ * each dependency placed ahead of those it's overridden by.
+ */
+void Mod_FetchDependencies( modDirectory_t* mod, std::vector<std::string>& dirList ) {
+	if ( std::find( dirList.begin(), dirList.end(), mod->directory ) != dirList.end() ) {
+		LogInfo( "%s is already mounted, skipping\n", mod->directory.c_str() );
 		return;
 	}
 
@@ -132,10 +301,12 @@ void Mod_FetchDependencies( modDirectory_t* mod, std::set<std::string>& dirSet )
 		}
 
 		if ( !dependency->dependencies.empty() ) {
-			Mod_FetchDependencies( dependency, dirSet );
+			Mod_FetchDependencies( dependency, dirList );
 		}
 
-		dirSet.emplace( dependency->directory );
+		if ( std::find( dirList.begin(), dirList.end(), dependency->directory ) == dirList.end() ) {
+			dirList.push_back( dependency->directory );
+		}
 	}
 }
 
@@ -164,20 +335,40 @@ void Mod_SetMod( const char* name ) {
 	}
 
 	// Generate a list of directories to mount based on the dependencies
-	std::set<std::string> dirSet;
-	Mod_FetchDependencies( mod, dirSet );
-	dirSet.emplace( mod->directory );
-
-	// Now attempt to mount everything
-	for ( const auto& i : dirSet ) {
-		char mountPath[PL_SYSTEM_MAX_PATH];
-		snprintf( mountPath, sizeof( mountPath ), "mods/%s", i.c_str() );
-		PLFileSystemMount* mount = plMountLocation( mountPath );
+	std::vector<std::string> dirList;
+	Mod_FetchDependencies( mod, dirList );
+	if ( std::find( dirList.begin(), dirList.end(), mod->directory ) == dirList.end() ) {
+		dirList.push_back( mod->directory );
+	}
+
+	// Now attempt to mount everything. Textures, models and the like are
+	// still only found through the mounted directories, so an archive can
+	// speed things up but can't stand in for a directory altogether
+	for ( const auto& i : dirList ) {
+		modLocation_t location;
+		location.path = "mods/" + i;
+
+		if ( !plPathExists( location.path.c_str() ) ) {
+			Mod_Unmount( mod );
+			LogWarn( "Failed to mount location, \"%s\" doesn't exist!\n", i.c_str() );
+			return;
+		}
+
+		PLFileSystemMount* mount = plMountLocation( location.path.c_str() );
 		if ( mount == nullptr ) {
 			Mod_Unmount( mod );
 			LogWarn( "Failed to mount location, \"%s\" (%s)!\n", i.c_str(), plGetError() );
 			return;
 		}
+
+		mod->mountList.push_back( mount );
+		mod->mountPaths.push_back( location.path );
+		location.loose = true;
+
+		std::string archivePath = location.path.substr( 0, location.path.length() - 1 ) + "." MAF_EXTENSION;
+		location.archive = Mod_OpenArchive( archivePath.c_str() );
+
+		mod->locations.push_back( location );
 	}
 
 	if ( currentModification != nullptr ) {
@@ -17,6 +17,18 @@
 
 #pragma once
 
+#include <map>
+#include <string>
+#include <vector>
+
+struct ModArchive;
+
+struct modLocation_t {
+	std::string path;                   /// e.g. "mods/how/"
+	bool loose = false;                 /// Whether the directory itself was mounted
+	ModArchive* archive = nullptr;      /// Packed copy of the directory, if there is one
+};
+
 struct modDirectory_t {
 	std::string fileName;
 	std::string internalName;
@@ -30,6 +42,8 @@ struct modDirectory_t {
 	bool isVisible = false; /// Whether or not the mod is selectable
 
 	std::vector<PLFileSystemMount*> mountList; /// Pointers to the mounted directory handle
+	std::vector<std::string> mountPaths; /// Paths of the mounted directories, in the same order as mountList
+	std::vector<modLocation_t> locations; /// Everything that was mounted, dependencies first, so later entries take priority
 };
 
 typedef std::map<std::string, modDirectory_t> modsMap_t;
@@ -41,3 +55,6 @@ const modDirectory_t* Mod_GetCurrentMod();
 void Mod_RegisterMods();
 void Mod_RegisterMod( const char* path );
 void Mod_SetMod( const char* name );
+
+bool Mod_MapFile( const char* path, const void** data, size_t* size );
+bool Mod_GetLocalPath( const char* path, char* out, size_t outSize );
@@ -15,13 +15,21 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
 #include <PL/platform_filesystem.h>
 #include <PL/platform_mesh.h>
 #include <PL/platform_model.h>
 
 #include "engine.h"
 #include "model.h"
+#include "animation.h"
 #include "loaders/loaders.h"
+#include "mod_support.h"
 
 #include "graphics/display.h"
 #include "graphics/shaders.h"
@@ -100,89 +108,281 @@ const char *Model_GetAnimationDescription( unsigned int i ) {
 	return animationNames[ i ];
 }
 
-PLModel *Model_LoadVtxFile( const char *path ) {
-	VtxHandle *vtx = Vtx_LoadFile( path );
-	if ( vtx == nullptr ) {
-		LogWarn( "Failed to load Vtx, \"%s\"!\n", path );
-		return nullptr;
-	}
+/* Model Cache
+ *
+ * Vtx models are cooked into the Machinor Model Format on first
+ * load and written out under the cache directory, so subsequent
+ * loads can skip parsing the Vtx/Fac/No2 and generating normals. The
+ * cache is rebuilt whenever any of the source files change, which is
+ * judged by their size and modification times, and only if those
+ * differ by hashing their contents.
+ */
 
-	/* now we load in all the faces */
-	char fac_path[PL_SYSTEM_MAX_PATH];
-	strncpy( fac_path, path, strlen( path ) - 3 );
-	fac_path[ strlen( path ) - 3 ] = '\0';
-	strcat( fac_path, "fac" );
-	FacHandle *fac = Fac_LoadFile( fac_path );
-	if ( fac == nullptr ) {
-		Vtx_DestroyHandle( vtx );
-		LogWarn( "Failed to load Fac, \"%s\"!\n", path );
-		return nullptr;
+#define MODEL_CACHE_DIR "cache/models/"
+
+struct CookedModel {
+	std::vector<MmfVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MmfTexture> textures;
+	MmfBounds bounds;
+
+	MmfModel GetModel() const {
+		MmfModel model;
+		model.vertices = vertices.data();
+		model.num_vertices = vertices.size();
+		model.indices = indices.data();
+		model.num_indices = indices.size();
+		model.textures = textures.data();
+		model.num_textures = textures.size();
+		model.bounds = bounds;
+		return model;
 	}
+};
 
-	const char *filename = plGetFileName( path );
-	// skydome is a special case, since we don't care about textures...
-	if ( pl_strcasecmp( filename, "skydome.vtx" ) == 0 || pl_strcasecmp( filename, "skydomeu.vtx" ) == 0 ) {
-		PLMesh *mesh = plCreateMesh( PL_MESH_TRIANGLES, PL_DRAW_STATIC, fac->num_triangles, vtx->num_vertices );
-		if ( mesh == nullptr ) {
-			Vtx_DestroyHandle( vtx );
-			Fac_DestroyHandle( fac );
-			LogWarn( "Failed to create mesh (%s)!\n", plGetError() );
-			return nullptr;
+static const char *vtxSourceExtensions[] = { "vtx", "fac", "no2" };
+
+/**
+ * Stamp the files the given Vtx model is built from by their size and
+ * modification times, which is enough to tell if the cooked copy is up
+ * to date in most cases, without having to read them.
+ */
+static bool Model_StampVtxSources( const std::string &path, MmfSourceStamp *stamp ) {
+	memset( stamp, 0, sizeof( MmfSourceStamp ) );
+
+	int64_t times[ plArrayElements( vtxSourceExtensions ) ] = {};
+	bool archived = false;
+
+	std::string basePath = path.substr( 0, path.length() - 3 );
+	for ( unsigned int i = 0; i < plArrayElements( vtxSourceExtensions ); ++i ) {
+		std::string sourcePath = basePath + vtxSourceExtensions[ i ];
+
+		// No times for anything archived, so those will have to be hashed
+		const void *data;
+		size_t size;
+		if ( Mod_MapFile( sourcePath.c_str(), &data, &size ) ) {
+			stamp->size += size;
+			archived = true;
+			continue;
 		}
 
-		for ( unsigned int j = 0; j < vtx->num_vertices; ++j ) {
-			plSetMeshVertexPosition( mesh, j, vtx->vertices[ j ].position * -1 * .5f );
+		char localPath[PL_SYSTEM_MAX_PATH];
+		if ( !Mod_GetLocalPath( sourcePath.c_str(), localPath, sizeof( localPath ) ) ) {
+			snprintf( localPath, sizeof( localPath ), "%s", sourcePath.c_str() );
 		}
 
-		unsigned int cur_index = 0;
-		for ( unsigned int j = 0; j < fac->num_triangles; ++j ) {
-			plSetMeshTrianglePosition( mesh, &cur_index,
-									   fac->triangles[ j ].vertex_indices[ 0 ],
-									   fac->triangles[ j ].vertex_indices[ 1 ],
-									   fac->triangles[ j ].vertex_indices[ 2 ]
-			);
+		struct stat buf;
+		if ( stat( localPath, &buf ) != 0 ) {
+			// no2 is optional
+			if ( i == 2 ) {
+				continue;
+			}
+
+			return false;
 		}
 
-		Vtx_DestroyHandle( vtx );
-		Fac_DestroyHandle( fac );
+		stamp->size += buf.st_size;
+		times[ i ] = static_cast<int64_t>( buf.st_mtime );
+	}
 
-		mesh->texture = Engine::Resource()->GetFallbackTexture();
+	if ( !archived ) {
+		stamp->time = u_hash( times, sizeof( times ), U_HASH_SEED );
+	}
 
-		PLModel *model = plCreateBasicStaticModel( mesh );
-		if ( model == nullptr ) {
-			LogWarn( "Failed to create model (%s)!\n", plGetError() );
-			return nullptr;
+	return true;
+}
+
+/**
+ * Hash the files the given Vtx model is built from, for when their
+ * stamp doesn't match the cooked copy, to see if they really changed.
+ */
+static bool Model_HashVtxSources( const std::string &path, MmfSourceStamp *stamp ) {
+	uint32_t size = 0;
+	uint32_t hash = U_HASH_SEED;
+
+	std::string basePath = path.substr( 0, path.length() - 3 );
+	for ( unsigned int i = 0; i < plArrayElements( vtxSourceExtensions ); ++i ) {
+		std::string sourcePath = basePath + vtxSourceExtensions[ i ];
+		if ( !plFileExists( sourcePath.c_str() ) ) {
+			// no2 is optional
+			if ( i == 2 ) {
+				continue;
+			}
+
+			return false;
 		}
 
-		return model;
+		PLFile *file = plOpenFile( sourcePath.c_str(), false );
+		if ( file == nullptr ) {
+			return false;
+		}
+
+		std::vector<uint8_t> buf( plGetFileSize( file ) );
+		bool status = ( plReadFile( file, buf.data(), 1, buf.size() ) == buf.size() );
+		plCloseFile( file );
+		if ( !status ) {
+			return false;
+		}
+
+		size += buf.size();
+		hash = u_hash( buf.data(), buf.size(), hash );
 	}
 
-	TextureAtlas atlas( 128, 8 );
-	if ( fac->texture_table_size > 0 ) {
-		for ( unsigned int i = 0; i < fac->texture_table_size; ++i ) {
-			if ( fac->texture_table[ i ].name[ 0 ] == '\0' ) {
-				LogWarn( "Invalid texture name in table, skipping (%d)!\n", i );
-				continue;
+	stamp->size = size;
+	stamp->hash = hash;
+	stamp->has_hash = true;
+	return true;
+}
+
+struct CookCorner {
+	PLVector3 position;
+	PLVector3 normal;
+	float st[2];
+	uint32_t texture_index;
+	uint16_t bone_index;
+};
+
+/**
+ * Weld and optimise the given triangles into their cooked form,
+ * shared between each of the formats we cook.
+ * @param get_corner Called for each corner of every triangle, to
+ * fetch it from the source data. Returns false if it's invalid.
+ */
+template<typename GetCornerFunction>
+static bool Model_CookTriangles( const char *path, unsigned int num_triangles, GetCornerFunction get_corner,
+								 CookedModel *out ) {
+	if ( num_triangles == 0 ) {
+		LogWarn( "No triangles in \"%s\"!\n", path );
+		return false;
+	}
+
+	// Weld together any vertices that are identical, rather than
+	// having three unique vertices for every triangle
+	struct __attribute__((packed)) WeldKey {
+		float position[3];
+		float normal[3];
+		float st[2];
+		uint32_t texture_index;
+		uint16_t bone_index;
+
+		bool operator==( const WeldKey &other ) const {
+			return memcmp( this, &other, sizeof( WeldKey ) ) == 0;
+		}
+	};
+	struct WeldKeyHash {
+		size_t operator()( const WeldKey &key ) const {
+			return u_hash( &key, sizeof( WeldKey ), U_HASH_SEED );
+		}
+	};
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> welded;
+	welded.reserve( num_triangles * 3 );
+
+	out->indices.reserve( num_triangles * 3 );
+	for ( unsigned int j = 0; j < num_triangles; ++j ) {
+		uint32_t triangle[3];
+		for ( unsigned int tri_vtx_i = 0; tri_vtx_i < 3; ++tri_vtx_i ) {
+			CookCorner corner;
+			if ( !get_corner( j, tri_vtx_i, &corner ) ) {
+				return false;
 			}
 
-			std::string str = path;
-			size_t pos = str.find_last_of( '/' );
-			std::string texture_path = str.erase( pos ) + "/";
-			if ( !atlas.AddImage( texture_path + fac->texture_table[ i ].name + ".png", true ) ) {
-				LogWarn( "Failed to add texture \"%s\" to atlas!\n", fac->texture_table[ i ].name );
+			if ( corner.texture_index > UINT16_MAX ) {
+				LogWarn( "Texture index out of range in \"%s\" (%u), aborting!\n", path, corner.texture_index );
+				return false;
 			}
+
+			const PLVector3 &position = corner.position;
+			const PLVector3 &normal = corner.normal;
+
+			WeldKey key;
+			key.position[ 0 ] = position.x;
+			key.position[ 1 ] = position.y;
+			key.position[ 2 ] = position.z;
+			key.normal[ 0 ] = normal.x;
+			key.normal[ 1 ] = normal.y;
+			key.normal[ 2 ] = normal.z;
+			key.st[ 0 ] = corner.st[ 0 ];
+			key.st[ 1 ] = corner.st[ 1 ];
+			key.texture_index = corner.texture_index;
+			key.bone_index = corner.bone_index;
+
+			auto i = welded.find( key );
+			if ( i != welded.end() ) {
+				triangle[ tri_vtx_i ] = i->second;
+				continue;
+			}
+
+			MmfVertex vertex;
+			memset( &vertex, 0, sizeof( MmfVertex ) );
+			vertex.position[ 0 ] = position.x;
+			vertex.position[ 1 ] = position.y;
+			vertex.position[ 2 ] = position.z;
+			vertex.normal[ 0 ] = normal.x;
+			vertex.normal[ 1 ] = normal.y;
+			vertex.normal[ 2 ] = normal.z;
+			vertex.colour[ 0 ] = vertex.colour[ 1 ] = vertex.colour[ 2 ] = vertex.colour[ 3 ] = 255;
+			vertex.bone_index = key.bone_index;
+			vertex.texture_index = key.texture_index;
+			vertex.st[ 0 ] = key.st[ 0 ];
+			vertex.st[ 1 ] = key.st[ 1 ];
+
+			triangle[ tri_vtx_i ] = out->vertices.size();
+			welded.emplace( key, triangle[ tri_vtx_i ] );
+			out->vertices.push_back( vertex );
 		}
-		atlas.Finalize();
-	} else {
-		LogWarn( "No texture table for \"%s\"!\n", path );
+
+		// Winding is flipped, same as the positions
+		out->indices.push_back( triangle[ 2 ] );
+		out->indices.push_back( triangle[ 1 ] );
+		out->indices.push_back( triangle[ 0 ] );
 	}
 
-	PLMesh *mesh = plCreateMesh( PL_MESH_TRIANGLES, PL_DRAW_DYNAMIC, fac->num_triangles, fac->num_triangles * 3 );
-	if ( mesh == nullptr ) {
-		Vtx_DestroyHandle( vtx );
-		Fac_DestroyHandle( fac );
-		LogWarn( "Failed to create mesh (%s)!\n", plGetError() );
-		return nullptr;
+	float acmr = Mesh_GetAverageCacheMissRatio( out->indices.data(), out->indices.size(), 32 );
+	Mesh_OptimizeVertexCache( out->indices.data(), out->indices.size(), out->vertices.size() );
+
+	// Now reorder the vertices by when they're first used, to match
+	std::vector<uint32_t> remap( out->vertices.size(), UINT32_MAX );
+	std::vector<MmfVertex> vertices;
+	vertices.reserve( out->vertices.size() );
+	for ( auto &index : out->indices ) {
+		if ( remap[ index ] == UINT32_MAX ) {
+			remap[ index ] = vertices.size();
+			vertices.push_back( out->vertices[ index ] );
+		}
+		index = remap[ index ];
+	}
+	out->vertices.swap( vertices );
+
+	LogDebug( "Welded \"%s\" from %u to %u vertices, ACMR %.2f -> %.2f\n", path,
+			  num_triangles * 3, ( unsigned int ) out->vertices.size(), acmr,
+			  Mesh_GetAverageCacheMissRatio( out->indices.data(), out->indices.size(), 32 ) );
+
+	for ( unsigned int i = 0; i < 3; ++i ) {
+		out->bounds.mins[ i ] = out->bounds.maxs[ i ] = out->vertices[ 0 ].position[ i ];
+	}
+	for ( const auto &vertex : out->vertices ) {
+		for ( unsigned int i = 0; i < 3; ++i ) {
+			if ( vertex.position[ i ] < out->bounds.mins[ i ] ) out->bounds.mins[ i ] = vertex.position[ i ];
+			if ( vertex.position[ i ] > out->bounds.maxs[ i ] ) out->bounds.maxs[ i ] = vertex.position[ i ];
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Convert the given Vtx/Fac into its cooked form. Normals are taken
+ * from the No2 if provided, otherwise they're left empty, since
+ * they're generated against the final mesh.
+ */
+static bool Model_CookVtxFile( const char *path, VtxHandle *vtx, FacHandle *fac, No2Handle *no2, CookedModel *out ) {
+	if ( fac->texture_table_size > 0 ) {
+		out->textures.resize( fac->texture_table_size );
+		for ( unsigned int i = 0; i < fac->texture_table_size; ++i ) {
+			memcpy( out->textures[ i ].name, fac->texture_table[ i ].name, sizeof( MmfTexture::name ) );
+			out->textures[ i ].name[ sizeof( MmfTexture::name ) - 1 ] = '\0';
+		}
+	} else {
+		LogWarn( "No texture table for \"%s\"!\n", path );
 	}
 
 	for ( unsigned int j = 0; j < vtx->num_vertices; ++j ) {
@@ -193,48 +393,291 @@ PLModel *Model_LoadVtxFile( const char *path ) {
 		vtx->vertices[ j ].position.x *= -1;
 	}
 
-	// automatically returns default if failed
-	mesh->texture = atlas.GetTexture();
+	if ( no2 != nullptr ) {
+		for ( unsigned int j = 0; j < no2->num_normals; ++j ) {
+			no2->normals[ j ].y *= -1;
+			no2->normals[ j ].x *= -1;
+		}
+	}
 
-	unsigned int cur_index = 0;
-	for ( unsigned int j = 0, next_vtx_i = 0; j < fac->num_triangles; ++j ) {
-		for ( unsigned int tri_vtx_i = 0; tri_vtx_i < 3; ++tri_vtx_i, ++next_vtx_i ) {
-			unsigned int tri_vtx = fac->triangles[ j ].vertex_indices[ tri_vtx_i ];
+	return Model_CookTriangles( path, fac->num_triangles, [ & ]( unsigned int triangle, unsigned int i, CookCorner *corner ) {
+		const FacTriangle &face = fac->triangles[ triangle ];
 
-			plSetMeshVertexColour( mesh, next_vtx_i, PL_COLOUR_WHITE );
-			plSetMeshVertexPosition( mesh, next_vtx_i, vtx->vertices[ tri_vtx ].position );
+		unsigned int tri_vtx = face.vertex_indices[ i ];
+		if ( tri_vtx >= vtx->num_vertices ) {
+			LogWarn( "Invalid vertex index in \"%s\" (%u/%u)!\n", path, tri_vtx, vtx->num_vertices );
+			return false;
+		}
 
-#if 0 // todo: only necessary for pigs?
-			mesh->vertices[next_vtx_i].bone_index = vtx->vertices[tri_vtx].bone_index;
-			mesh->vertices[next_vtx_i].bone_weight = 1.f;
-#endif
+		corner->normal = PLVector3( 0, 0, 0 );
+		if ( no2 != nullptr ) {
+			unsigned int tri_normal = face.normal_indices[ i ];
+			if ( tri_normal >= no2->num_normals ) {
+				LogWarn( "Invalid normal index in \"%s\" (%u/%u)!\n", path, tri_normal, no2->num_normals );
+				return false;
+			}
+
+			corner->normal = no2->normals[ tri_normal ];
+		}
+
+		corner->position = vtx->vertices[ tri_vtx ].position;
+		corner->st[ 0 ] = face.uv_coords[ i * 2 ];
+		corner->st[ 1 ] = face.uv_coords[ i * 2 + 1 ];
+		corner->texture_index = face.texture_index;
+		corner->bone_index = vtx->vertices[ tri_vtx ].bone_index;
+		return true;
+	}, out );
+}
+
+/* Model Atlases
+ *
+ * Models sitting in the same directory, such as those extracted
+ * from the same package, tend to share most of their textures.
+ * Rather than each building its own, the first model loaded from a
+ * directory builds one atlas from every texture the models in there
+ * refer to, going by their Fac tables, and the rest share it, so
+ * they also end up sharing the one texture when drawn. Any model
+ * needing a texture that isn't in there, or whose directory didn't
+ * fit into one atlas, just gets an atlas of its own.
+ *
+ * Each atlas is held by the models drawing with its texture, along
+ * with the directory for the shared ones, and is destroyed once the
+ * last of those lets go of it.
+ */
+
+struct ModelAtlas {
+	TextureAtlas *atlas{ nullptr };
+	std::set<std::string> textures;     /// Everything it was built from
+	unsigned int users{ 0 };
+};
+
+static std::map<std::string, ModelAtlas *> directoryAtlases;
+static std::unordered_map<const PLTexture *, ModelAtlas *> textureAtlases;
+
+static ModelAtlas *Model_BuildAtlas( const std::string &directory, const std::set<std::string> &textures ) {
+	auto *out = new ModelAtlas();
+	out->atlas = new TextureAtlas( 128, 8 );
+	out->textures = textures;
+	for ( const auto &i : textures ) {
+		out->atlas->AddImage( directory + i + ".png", true );
+	}
+
+	// Leaves the atlas with the fallback texture if it fails, which isn't ours to track
+	if ( out->atlas->Finalize() ) {
+		textureAtlases.emplace( out->atlas->GetTexture(), out );
+	}
+
+	return out;
+}
+
+static void Model_ReleaseAtlas( ModelAtlas *atlas ) {
+	u_assert( atlas->users > 0, "Released an atlas with no users!\n" );
+	if ( --atlas->users > 0 ) {
+		return;
+	}
+
+	if ( atlas->atlas != nullptr ) {
+		PLTexture *texture = atlas->atlas->GetTexture();
+		auto i = textureAtlases.find( texture );
+		if ( i != textureAtlases.end() && i->second == atlas ) {
+			textureAtlases.erase( i );
+			plDestroyTexture( texture );
+		}
+
+		delete atlas->atlas;
+	}
+
+	delete atlas;
+}
+
+static std::set<std::string> *packageTextures;
+
+static void Model_AppendPackageTextures( const char *path ) {
+	FacHandle *fac = Fac_LoadFile( path, nullptr );
+	if ( fac == nullptr ) {
+		return;
+	}
+
+	for ( unsigned int i = 0; i < fac->texture_table_size; ++i ) {
+		const char *name = fac->texture_table[ i ].name;
+		if ( name[ 0 ] != '\0' ) {
+			packageTextures->emplace( name, strnlen( name, sizeof( fac->texture_table[ i ].name ) ) );
+		}
+	}
+
+	Fac_DestroyHandle( fac, nullptr );
+}
+
+/**
+ * Builds the atlas shared by all of the models in the given directory.
+ */
+static ModelAtlas *Model_BuildDirectoryAtlas( const std::string &directory ) {
+	std::set<std::string> textures;
+	packageTextures = &textures;
+	const modDirectory_t *mod = Mod_GetCurrentMod();
+	if ( mod != nullptr ) {
+		for ( const auto &i : mod->locations ) {
+			std::string scanPath = i.path + directory;
+			if ( i.loose && plPathExists( scanPath.c_str() ) ) {
+				plScanDirectory( scanPath.c_str(), "fac", Model_AppendPackageTextures, false );
+			}
+		}
+	}
+	packageTextures = nullptr;
+
+	if ( textures.empty() ) {
+		return new ModelAtlas();
+	}
+
+	ModelAtlas *atlas = Model_BuildAtlas( directory, textures );
+	if ( atlas->atlas->GetTexture() == Engine::Resource()->GetFallbackTexture() ) {
+		LogWarn( "Failed to build shared texture atlas for \"%s\", models will build their own!\n",
+				 directory.c_str() );
+		atlas->textures.clear();
+	}
+
+	return atlas;
+}
+
+/**
+ * Fetches an atlas with all of the given model's textures, ideally the
+ * one shared by the models in its directory. The caller holds onto it
+ * until it's done with it, see Model_ReleaseAtlas.
+ */
+static ModelAtlas *Model_GetAtlas( const std::string &directory, const MmfModel *data ) {
+	ModelAtlas *&shared = directoryAtlases[ directory ];
+	if ( shared == nullptr ) {
+		shared = Model_BuildDirectoryAtlas( directory );
+		shared->users++;
+	}
+
+	std::set<std::string> textures;
+	bool missing = false;
+	for ( unsigned int i = 0; i < data->num_textures; ++i ) {
+		const char *name = data->textures[ i ].name;
+		if ( name[ 0 ] == '\0' ) {
+			continue;
+		}
+
+		std::string texture( name, strnlen( name, sizeof( data->textures[ i ].name ) ) );
+		if ( shared->textures.find( texture ) == shared->textures.end() ) {
+			missing = true;
+		}
+
+		textures.emplace( texture );
+	}
+
+	ModelAtlas *atlas = ( missing || shared->atlas == nullptr ) ? Model_BuildAtlas( directory, textures ) : shared;
+	atlas->users++;
+	return atlas;
+}
+
+/**
+ * Releases the shared atlases, so they're rebuilt for the next model
+ * loaded. Those still in use stick around until their models are gone.
+ * @param directory Only release the atlas for this directory, or all if NULL.
+ */
+void Model_ClearAtlases( const char *directory ) {
+	for ( auto i = directoryAtlases.begin(); i != directoryAtlases.end(); ) {
+		if ( directory != nullptr && i->first != directory ) {
+			++i;
+			continue;
+		}
+
+		Model_ReleaseAtlas( i->second );
+		i = directoryAtlases.erase( i );
+	}
+}
+
+/**
+ * Destroys a model loaded through here, releasing its atlas along with it.
+ */
+void Model_Destroy( PLModel *model ) {
+	if ( model == nullptr ) {
+		return;
+	}
+
+	PLModelLod *lod = plGetModelLodLevel( model, 0 );
+	if ( lod != nullptr && lod->num_meshes > 0 ) {
+		auto i = textureAtlases.find( lod->meshes[ 0 ]->texture );
+		if ( i != textureAtlases.end() ) {
+			Model_ReleaseAtlas( i->second );
 		}
+	}
+
+	plDestroyModel( model );
+}
 
-		plSetMeshTrianglePosition( mesh, &cur_index, next_vtx_i - 1, next_vtx_i - 2, next_vtx_i - 3 );
+/**
+ * Builds the model's mesh from its cooked data, mapping
+ * its texture coordinates into the given atlas.
+ */
+static PLModel *Model_BuildFromMmf( const char *path, const MmfModel *data, TextureAtlas *atlas,
+								   bool generate_normals ) {
+	if ( atlas != nullptr ) {
+		for ( unsigned int i = 0; i < data->num_textures; ++i ) {
+			if ( data->textures[ i ].name[ 0 ] == '\0' ) {
+				LogWarn( "Invalid texture name in table, skipping (%d)!\n", i );
+				continue;
+			}
 
-		if ( fac->texture_table != nullptr ) {
-			float tx_x, tx_y, tx_w, tx_h;
-			atlas.GetTextureCoords( fac->texture_table[ fac->triangles[ j ].texture_index ].name,
-									&tx_x,
-									&tx_y,
-									&tx_w,
-									&tx_h );
+			if ( !atlas->HasTexture( data->textures[ i ].name ) ) {
+				LogWarn( "Failed to find texture \"%s\" in atlas!\n", data->textures[ i ].name );
+			}
+		}
+	}
 
-			std::pair<unsigned int, unsigned int>
-				texture_size = atlas.GetTextureSize( fac->texture_table[ fac->triangles[ j ].texture_index ].name );
+	PLMesh *mesh = plCreateMesh( PL_MESH_TRIANGLES, PL_DRAW_DYNAMIC, data->num_indices / 3, data->num_vertices );
+	if ( mesh == nullptr ) {
+		LogWarn( "Failed to create mesh (%s)!\n", plGetError() );
+		return nullptr;
+	}
 
-			for ( unsigned int k = 0, u = 0; k < 3; ++k, u += 2 ) {
-				plSetMeshVertexST( mesh, next_vtx_i - ( 3 - k ),
-								   tx_x + ( tx_w * ( 1.0f / ( float ) ( texture_size.first ) )
-									   * ( float ) ( fac->triangles[ j ].uv_coords[ u ] ) ),
-								   tx_y + ( tx_h * ( 1.0f / ( float ) ( texture_size.second ) )
-									   * ( float ) ( fac->triangles[ j ].uv_coords[ u + 1 ] ) ) );
+	// atlas automatically returns default if failed
+	mesh->texture = ( atlas != nullptr ) ? atlas->GetTexture() : Engine::Resource()->GetFallbackTexture();
+
+	bool invalid_bones = false;
+	for ( unsigned int i = 0; i < data->num_vertices; ++i ) {
+		const MmfVertex *vertex = &data->vertices[ i ];
+		plSetMeshVertexPosition( mesh, i, PLVector3( vertex->position[ 0 ], vertex->position[ 1 ], vertex->position[ 2 ] ) );
+		mesh->vertices[ i ].normal = PLVector3( vertex->normal[ 0 ], vertex->normal[ 1 ], vertex->normal[ 2 ] );
+		plSetMeshVertexColour( mesh, i, PLColour( vertex->colour[ 0 ], vertex->colour[ 1 ], vertex->colour[ 2 ],
+												  vertex->colour[ 3 ] ) );
+		if ( vertex->bone_index >= ANIMATION_MAX_BONES ) {
+			if ( !invalid_bones ) {
+				LogWarn( "Bone index out of range in \"%s\" (%u/%u), using root!\n",
+						 path, vertex->bone_index, ANIMATION_MAX_BONES );
+				invalid_bones = true;
 			}
+			mesh->vertices[ i ].bone_index = 0;
+		} else {
+			mesh->vertices[ i ].bone_index = vertex->bone_index;
 		}
+
+		if ( vertex->texture_index >= data->num_textures ) {
+			continue;
+		}
+
+		const char *texture_name = data->textures[ vertex->texture_index ].name;
+
+		float tx_x, tx_y, tx_w, tx_h;
+		atlas->GetTextureCoords( texture_name, &tx_x, &tx_y, &tx_w, &tx_h );
+
+		std::pair<unsigned int, unsigned int> texture_size = atlas->GetTextureSize( texture_name );
+		plSetMeshVertexST( mesh, i,
+						   tx_x + ( tx_w * ( 1.0f / ( float ) ( texture_size.first ) ) * vertex->st[ 0 ] ),
+						   tx_y + ( tx_h * ( 1.0f / ( float ) ( texture_size.second ) ) * vertex->st[ 1 ] ) );
+	}
+
+	unsigned int cur_index = 0;
+	for ( unsigned int i = 0; i < data->num_indices; i += 3 ) {
+		plSetMeshTrianglePosition( mesh, &cur_index, data->indices[ i ], data->indices[ i + 1 ], data->indices[ i + 2 ] );
 	}
 
-	std::list<PLMesh *> meshes( &mesh, &mesh + 1 );
-	Mesh_GenerateFragmentedMeshNormals( meshes );
+	if ( generate_normals ) {
+		std::list<PLMesh *> meshes( &mesh, &mesh + 1 );
+		Mesh_GenerateFragmentedMeshNormals( meshes );
+	}
 
 #if 0
 	auto *skeleton =
@@ -255,188 +698,207 @@ PLModel *Model_LoadVtxFile( const char *path ) {
 	return model;
 }
 
-PLModel *Model_LoadMinFile( const char *path ) {
-	u_assert( 0, "TODO" );
-	return nullptr;
+/**
+ * Creates the model from its cooked data, using the texture
+ * atlas shared with the other models sitting alongside it.
+ */
+static PLModel *Model_CreateFromMmf( const char *path, const MmfModel *data, bool generate_normals ) {
+	if ( data->num_textures == 0 ) {
+		return Model_BuildFromMmf( path, data, nullptr, generate_normals );
+	}
+
+	std::string str = path;
+	size_t pos = str.find_last_of( '/' );
+	std::string texture_path = str.erase( pos ) + "/";
+	ModelAtlas *atlas = Model_GetAtlas( texture_path, data );
+
+	PLModel *model = Model_BuildFromMmf( path, data, atlas->atlas, generate_normals );
+
+	// Hold onto it for as long as the model's drawing with its texture, see Model_Destroy
+	if ( model == nullptr || textureAtlases.find( atlas->atlas->GetTexture() ) == textureAtlases.end() ) {
+		Model_ReleaseAtlas( atlas );
+	}
+
+	return model;
 }
 
-/************************************************************/
+PLModel *Model_LoadVtxFile( const char *path ) {
+	// Check for a cooked copy first, and use that if it's still valid
+	MmfSourceStamp stamp;
+	bool stamped = Model_StampVtxSources( path, &stamp );
+	std::string cache_path = std::string( MODEL_CACHE_DIR ) + path + ".mmf";
+	if ( stamped ) {
+		MmfHandle *mmf = Mmf_OpenFile( cache_path.c_str(), &stamp );
+		bool restamp = false;
+		if ( mmf == nullptr ) {
+			// Times don't match, so check whether they've really changed
+			stamped = Model_HashVtxSources( path, &stamp );
+			if ( stamped && ( mmf = Mmf_OpenFile( cache_path.c_str(), &stamp ) ) != nullptr ) {
+				restamp = true;
+			}
+		}
 
-#if 0
-/* cache the pigs data into memory, since we
- * share it between all of them anyway :) */
-void CacheModelData() {
-  memset(&model_cache, 0, sizeof(model_cache));
-
-  model_cache.pig_skeleton = Hir_LoadFile(u_find("chars/pig.hir"));
-  if (model_cache.pig_skeleton == nullptr) {
-	Error("Failed to load skeleton, aborting!\n")
-  }
+		if ( mmf != nullptr ) {
+			PLModel *model = Model_CreateFromMmf( path, &mmf->model, false );
+			Mmf_CloseFile( mmf );
 
-  // animations
+			// So we don't need to hash them again next time
+			if ( restamp ) {
+				Mmf_UpdateStamp( cache_path.c_str(), &stamp );
+			}
 
-  LogInfo("Caching mcap.mad\n");
+			return model;
+		}
+	}
 
-  char mcap_path[PL_SYSTEM_MAX_PATH];
-  strncpy(mcap_path, u_find("chars/mcap.mad"), sizeof(mcap_path));
+	VtxHandle *vtx = Vtx_LoadFile( path, nullptr );
+	if ( vtx == nullptr ) {
+		LogWarn( "Failed to load Vtx, \"%s\"!\n", path );
+		return nullptr;
+	}
 
-  // check the number of bytes making up the mcap; we'll use this
-  // to determine the length of animations later
-  size_t mcap_bytes = plGetFileSize(mcap_path);
-  if (mcap_bytes < 272) {
-	Error("Unexpected \"mcap.mad\" size, %d, aborting!\n", mcap_bytes)
-  }
+	/* now we load in all the faces */
+	char fac_path[PL_SYSTEM_MAX_PATH];
+	strncpy( fac_path, path, strlen( path ) - 3 );
+	fac_path[ strlen( path ) - 3 ] = '\0';
+	strcat( fac_path, "fac" );
+	FacHandle *fac = Fac_LoadFile( fac_path, nullptr );
+	if ( fac == nullptr ) {
+		Vtx_DestroyHandle( vtx, nullptr );
+		LogWarn( "Failed to load Fac, \"%s\"!\n", path );
+		return nullptr;
+	}
 
-  FILE *file = fopen(mcap_path, "rb");
-  if (file == nullptr) {
-	Error("Failed to load \"%s\", aborting!\n", mcap_path)
-  }
+	const char *filename = plGetFileName( path );
+	// skydome is a special case, since we don't care about textures...
+	if ( pl_strcasecmp( filename, "skydome.vtx" ) == 0 || pl_strcasecmp( filename, "skydomeu.vtx" ) == 0 ) {
+		PLMesh *mesh = plCreateMesh( PL_MESH_TRIANGLES, PL_DRAW_STATIC, fac->num_triangles, vtx->num_vertices );
+		if ( mesh == nullptr ) {
+			Vtx_DestroyHandle( vtx, nullptr );
+			Fac_DestroyHandle( fac, nullptr );
+			LogWarn( "Failed to create mesh (%s)!\n", plGetError() );
+			return nullptr;
+		}
+
+		for ( unsigned int j = 0; j < vtx->num_vertices; ++j ) {
+			plSetMeshVertexPosition( mesh, j, vtx->vertices[ j ].position * -1 * .5f );
+		}
+
+		unsigned int cur_index = 0;
+		for ( unsigned int j = 0; j < fac->num_triangles; ++j ) {
+			plSetMeshTrianglePosition( mesh, &cur_index,
+									   fac->triangles[ j ].vertex_indices[ 0 ],
+									   fac->triangles[ j ].vertex_indices[ 1 ],
+									   fac->triangles[ j ].vertex_indices[ 2 ]
+			);
+		}
+
+		Vtx_DestroyHandle( vtx, nullptr );
+		Fac_DestroyHandle( fac, nullptr );
+
+		mesh->texture = Engine::Resource()->GetFallbackTexture();
+
+		PLModel *model = plCreateBasicStaticModel( mesh );
+		if ( model == nullptr ) {
+			LogWarn( "Failed to create model (%s)!\n", plGetError() );
+			return nullptr;
+		}
 
-  /* todo, split this up, as the psx version deals with these as separate files */
-  static const char *animation_names[] = {
-	  "Run cycle (normal)", "Run cycle (wounded)", "Run cycle (more wounded)", "Walk cycle (backwards)",
-	  "Turning on Spot",
-	  "Swimming", "Swimming like Rick",
-	  "Getting into Vehicles",
-	  "Jumping - Start", "Jumping - Middle", "Jumping - End",
-	  "Scramble",
-	  "Getting out Handgun", "Getting out Rifle", "Getting out Machine gun", "Getting out Heavy weapon",
-	  "Getting out Punch", "Getting out Grenade", "Getting out Sword / Knife",
-	  "Using Grenade", "Using Punch",
-	  "Sword / Knife",
-	  "Bayonet",
-	  "Aiming Handgun", "Aiming Rifle", "Aiming Machine gun", "Aiming Heavy weapon",
-	  "Standing around cycle 1", "Standing around cycle 2",
-	  "Very Wounded",
-	  "Lord Flash-Heart Pose",
-	  "Looking around", "Looking gormless",
-	  "Cowering",
-	  "Brushoff 1", "Brushoff 2", "Brushoff 3",
-	  "Sneeze",
-	  "Flying through air/falling",
-	  "Bouncing on B-Hind",
-	  "Getting to feet",
-	  "Celebration #1", "Celebration #2", "Celebration #3",
-	  "Salute",
-	  "Look back",
-	  "Thinking",
-	  "Dying #1", "Dying #2", "Dying #3",
-	  "Drowning",
-	  "Idle Cold", "Idle Hot",
-	  "Lay Mine",
-	  "Heal",
-	  "Pick pocket",
-	  "Air strike",
-	  "Hari Kiri",
-	  "Parachuting",
-  };
-
-  // run through each animation and copy it
-  // into our global animation list
-  for (unsigned int i = 0; i < MAX_ANIMATIONS; ++i) {
-	// basically a MAD package, but without the
-	// file name
-	struct __attribute__((packed)) {
-	  uint32_t offset;
-	  uint32_t length;
-	} index{};
-	if (fread(&index, sizeof(index), 1, file) != 1) {
-	  Error("Failed to read index, aborting!\n")
-	}
-
-	// position we'll return to for the next index
-	long position = ftell(file);
-
-	/* MCAP Format Specification
-	 * Used to store our piggy animations. */
-	typedef struct __attribute__((packed)) McapKeyframe {
-	  int16_t unused;
-
-	  struct __attribute__((packed)) {
-		int8_t x;
-		int8_t y;
-		int8_t z;
-	  } transforms[10];
-
-	  struct __attribute__((packed)) {
-		float x;
-		float y;
-		float z;
-		float w;
-	  } rotations[15];
-	} McapKeyframe;
-
-	auto num_keyframes = (unsigned int) (index.length / sizeof(McapKeyframe));
-	if (num_keyframes == 0) {
-	  Error("Odd keyframe at index, aborting!\n")
-	}
-
-	// copy everything into our global animations array
-
-	model_cache.animations[i].frames = static_cast<Keyframe *>(u_alloc(num_keyframes, sizeof(Keyframe), true));
-
-	// move to where the first keyframe is
-	if (fseek(file, index.offset, SEEK_SET) != 0) {
-	  Error("Failed to seek to offset %d in file, aborting!\n", index.offset)
-	}
-
-	for (unsigned int j = 0; j < num_keyframes; ++j) {
-	  // read in the keyframe data
-	  McapKeyframe frame;
-	  if (fread(&frame, sizeof(McapKeyframe), 1, file) != 1) {
-		Error("Failed to read animation keyframe, aborting!\n")
-	  }
-
-	  // copy transforms
-	  for (unsigned int k = 0; k < 10; ++k) {
-		model_cache.animations[i].frames[j].transforms[k].x = frame.transforms[k].x;
-		model_cache.animations[i].frames[j].transforms[k].y = frame.transforms[k].y;
-		model_cache.animations[i].frames[j].transforms[k].z = frame.transforms[k].z;
-	  }
-
-	  // copy rotations
-	  for (unsigned int k = 0; k < 15; ++k) {
-		model_cache.animations[i].frames[j].rotations[k].x = frame.rotations[k].x;
-		model_cache.animations[i].frames[j].rotations[k].y = frame.rotations[k].y;
-		model_cache.animations[i].frames[j].rotations[k].z = frame.rotations[k].z;
-		model_cache.animations[i].frames[j].rotations[k].w = frame.rotations[k].w;
-	  }
-	}
-
-	model_cache.animations[i].num_frames = num_keyframes;
-	if (i < plArrayElements(animation_names)) {
-	  model_cache.animations[i].name = animation_names[i];
-	}
-
-	// return us from whence we came
-	if (fseek(file, position, SEEK_SET) != 0) {
-	  Error("Failed to seek back to original position %d in file, aborting!\n", position)
+		return model;
 	}
-  }
-  u_fclose(file)
-
-#if 0 // debug
-  for(unsigned int i = 0; i < ANI_END; ++i) {
-	  for(unsigned int j = 0; j < g_model_cache.animations[i].num_frames; ++j) {
-		  print_debug("anim(%s) frame(%d) transformation(x:%d y:%d z:%d) angles(%d %d %d %d)\n",
-					  g_model_cache.animations[i].name, j,
-
-					  // print out the first transform
-					  (int)model_cache.animations[i].frames[j].transforms[0].x,
-					  (int)model_cache.animations[i].frames[j].transforms[0].y,
-					  (int)model_cache.animations[i].frames[j].transforms[0].z,
-
-					  // print out first rotation
-					  (int)model_cache.animations[i].frames[j].rotations[0].x,
-					  (int)model_cache.animations[i].frames[j].rotations[0].y,
-					  (int)model_cache.animations[i].frames[j].rotations[0].z,
-					  (int)model_cache.animations[i].frames[j].rotations[0].w
-		  );
-	  }
-  }
-#endif
+
+	// Use the original normals where we have them, otherwise we'll generate them
+	No2Handle *no2 = nullptr;
+	std::string no2_path = std::string( path, strlen( path ) - 3 ) + "no2";
+	if ( plFileExists( no2_path.c_str() ) ) {
+		no2 = No2_LoadNormals( no2_path.c_str(), nullptr );
+	}
+
+	CookedModel cooked;
+	bool status = Model_CookVtxFile( path, vtx, fac, no2, &cooked );
+	if ( !status && no2 != nullptr ) {
+		LogWarn( "Failed to use normals from \"%s\", generating them instead!\n", no2_path.c_str() );
+		No2_DestroyHandle( no2, nullptr );
+		no2 = nullptr;
+
+		// Cooking flips the positions in place, so start again
+		Vtx_DestroyHandle( vtx, nullptr );
+		vtx = Vtx_LoadFile( path, nullptr );
+		if ( vtx != nullptr ) {
+			cooked = CookedModel();
+			status = Model_CookVtxFile( path, vtx, fac, nullptr, &cooked );
+		}
+	}
+
+	bool generate_normals = ( no2 == nullptr );
+
+	Vtx_DestroyHandle( vtx, nullptr );
+	Fac_DestroyHandle( fac, nullptr );
+	No2_DestroyHandle( no2, nullptr );
+
+	if ( !status ) {
+		return nullptr;
+	}
+
+	MmfModel data = cooked.GetModel();
+	PLModel *model = Model_CreateFromMmf( path, &data, generate_normals );
+	if ( model == nullptr ) {
+		return nullptr;
+	}
+
+	// Fetch the generated normals, so we don't need to do this again
+	if ( generate_normals ) {
+		PLMesh *mesh = model->levels[ 0 ].meshes[ 0 ];
+		for ( unsigned int i = 0; i < mesh->num_verts; ++i ) {
+			cooked.vertices[ i ].normal[ 0 ] = mesh->vertices[ i ].normal.x;
+			cooked.vertices[ i ].normal[ 1 ] = mesh->vertices[ i ].normal.y;
+			cooked.vertices[ i ].normal[ 2 ] = mesh->vertices[ i ].normal.z;
+		}
+	}
+
+	size_t pos = cache_path.find_last_of( '/' );
+	if ( stamped && plCreatePath( cache_path.substr( 0, pos ).c_str() ) ) {
+		data = cooked.GetModel();
+		Mmf_WriteFile( &data, cache_path.c_str(), &stamp );
+	}
+
+	return model;
+}
+
+PLModel *Model_LoadMinFile( const char *path ) {
+	MinHandle *min = Min_LoadFile( path );
+	if ( min == nullptr ) {
+		LogWarn( "Failed to load Min, \"%s\"!\n", path );
+		return nullptr;
+	}
+
+	// PSX textures are stored separately, so there's no table to go with these
+	CookedModel cooked;
+	bool status = Model_CookTriangles( path, min->num_faces, [ & ]( unsigned int triangle, unsigned int i, CookCorner *corner ) {
+		const MinFace &face = min->faces[ triangle ];
+		const MinVertex &vertex = min->vertices[ face.vertex_indices[ i ] ];
+
+		// Scaled and flipped, same as Vtx
+		corner->position = PLVector3( vertex.position[ 0 ] * -.5f, vertex.position[ 1 ] * -.5f, vertex.position[ 2 ] * .5f );
+		corner->normal = PLVector3( 0, 0, 0 );
+		corner->st[ 0 ] = face.uv_coords[ i * 2 ];
+		corner->st[ 1 ] = face.uv_coords[ i * 2 + 1 ];
+		corner->texture_index = face.texture_index;
+		corner->bone_index = ( vertex.bone_index > 0 ) ? vertex.bone_index : 0;
+		return true;
+	}, &cooked );
+
+	Min_DestroyHandle( min );
+
+	if ( !status ) {
+		return nullptr;
+	}
+
+	MmfModel data = cooked.GetModel();
+	return Model_CreateFromMmf( path, &data, true );
 }
-#endif
+
+/************************************************************/
 
 #if 0
 void DEBUGDrawSkeleton() {
@@ -494,6 +956,60 @@ void DEBUGDrawSkeleton() {
 }
 #endif
 
+/**
+ * The vertex layout has no spare attribute, so skinned models carry
+ * their bone index through the colour alpha instead, counting down
+ * from 255, see skinned.vert. The generic shaders blend by that same
+ * alpha, so rather than touching the cached model, which is shared,
+ * this returns a copy for the caller to draw skinned and then release
+ * with Model_Destroy.
+ */
+PLModel *Model_CreateSkinnedCopy( PLModel *model ) {
+	if ( model == nullptr ) {
+		return nullptr;
+	}
+
+	PLModelLod *lod = plGetModelLodLevel( model, 0 );
+	if ( lod == nullptr || lod->num_meshes == 0 ) {
+		return nullptr;
+	}
+
+	if ( lod->num_meshes > 1 ) {
+		LogWarn( "Only the first mesh of a model is skinned (%u meshes)!\n", lod->num_meshes );
+	}
+
+	const PLMesh *source = lod->meshes[ 0 ];
+	PLMesh *mesh = plCreateMesh( PL_MESH_TRIANGLES, PL_DRAW_DYNAMIC, source->num_triangles, source->num_verts );
+	if ( mesh == nullptr ) {
+		LogWarn( "Failed to create mesh (%s)!\n", plGetError() );
+		return nullptr;
+	}
+
+	memcpy( mesh->vertices, source->vertices, sizeof( PLVertex ) * source->num_verts );
+	memcpy( mesh->indices, source->indices, sizeof( unsigned int ) * source->num_triangles * 3 );
+	mesh->texture = source->texture;
+
+	for ( unsigned int i = 0; i < mesh->num_verts; ++i ) {
+		mesh->vertices[ i ].colour.a = static_cast<uint8_t>(255 - mesh->vertices[ i ].bone_index);
+	}
+
+	PLModel *copy = plCreateBasicStaticModel( mesh );
+	if ( copy == nullptr ) {
+		LogWarn( "Failed to create model (%s)!\n", plGetError() );
+		return nullptr;
+	}
+
+	plGenerateModelBounds( copy );
+
+	// The copy shares the atlas, so keeps it alive until it's destroyed too
+	auto i = textureAtlases.find( mesh->texture );
+	if ( i != textureAtlases.end() ) {
+		i->second->users++;
+	}
+
+	return copy;
+}
+
 void Model_Draw( PLModel *model, PLMatrix4 translation ) {
 #if 0
 	PLShaderProgram* save = nullptr;
@@ -161,3 +161,7 @@ enum class AnimationIndex {
 const char *Model_GetAnimationDescription( unsigned int i );
 
 void Model_Draw(PLModel* model, PLMatrix4 translation);
+
+PLModel* Model_CreateSkinnedCopy(PLModel* model);
+void Model_ClearAtlases(const char *directory = nullptr);
+void Model_Destroy(PLModel* model);
@@ -34,4 +34,24 @@ inline static void VecAngleClamp(PLVector3* vector) {
   }
 }
 
+inline static PLVector3 VecLerp(const PLVector3& a, const PLVector3& b, float t) {
+  return PLVector3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+}
+
+/* blends each angle across whichever way round is shortest,
+ * so wrapping from 359 to 0 doesn't spin all the way back */
+inline static float AngleLerp(float a, float b, float t) {
+  float d = fmodf(b - a, 360.f);
+  if (d > 180.f) {
+    d -= 360.f;
+  } else if (d < -180.f) {
+    d += 360.f;
+  }
+  return a + d * t;
+}
+
+inline static PLVector3 VecAngleLerp(const PLVector3& a, const PLVector3& b, float t) {
+  return PLVector3(AngleLerp(a.x, b.x, t), AngleLerp(a.y, b.y, t), AngleLerp(a.z, b.z, t));
+}
+
 #endif
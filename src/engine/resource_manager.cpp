@@ -15,12 +15,92 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+
+#include <sys/stat.h>
+#include <GL/glew.h>
+
 #include "engine.h"
 #include "resource_manager.h"
+#include "model.h"
 #include "graphics/shaders.h"
 
+#include "../shared/dxt.h"
+#include "mod_support.h"
+
 using namespace openhow;
 
+/* Statistics
+ *
+ * Every cache lookup is counted against the resource it was for,
+ * and loads are timed, so we can get an idea of which assets are
+ * eating up the most time and memory during a session.
+ */
+
+static std::vector<const char*> loadContexts;
+
+hwResourceManager::LoadContext::LoadContext( const char* name ) {
+	loadContexts.push_back( name );
+}
+
+hwResourceManager::LoadContext::~LoadContext() {
+	loadContexts.pop_back();
+}
+
+/**
+ * Returns the name of the context that triggered the current
+ * load, nested contexts are separated by a '/'.
+ */
+static std::string GetLoadContext() {
+	if ( loadContexts.empty() ) {
+		return "unknown";
+	}
+
+	std::string context;
+	for ( const auto& i : loadContexts ) {
+		if ( !context.empty() ) {
+			context += "/";
+		}
+		context += i;
+	}
+
+	return context;
+}
+
+/**
+ * Adds the time spent within its scope onto the given counter.
+ */
+class StatsTimer {
+public:
+	explicit StatsTimer( double* counter ) : counter_( counter ) {
+		start_ = std::chrono::steady_clock::now();
+	}
+	~StatsTimer() {
+		if ( counter_ == nullptr ) {
+			return;
+		}
+
+		std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start_;
+		*counter_ += duration.count();
+	}
+
+private:
+	double* counter_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+static size_t GetModelSize( PLModel* model ) {
+	size_t size = 0;
+	for ( unsigned int i = 0; i < model->levels[ 0 ].num_meshes; ++i ) {
+		PLMesh* mesh = model->levels[ 0 ].meshes[ i ];
+		size += mesh->num_verts * sizeof( PLVertex );
+		size += mesh->num_triangles * 3 * sizeof( unsigned int );
+	}
+
+	return size;
+}
+
 /* todo:
  *  allow resources to be cached into collections (e.g. Clear("GameTextures"))
  */
@@ -41,9 +121,18 @@ hwResourceManager::hwResourceManager() {
 	plRegisterConsoleCommand( "ClearTextures",
 							  &hwResourceManager::ClearTexturesCommand,
 							  "Clears all cached textures." );
+	plRegisterConsoleCommand( "CompressTextures",
+							  &hwResourceManager::CompressTexturesCommand,
+							  "Generate the compressed texture cache for all textures under the given directory." );
+	plRegisterConsoleCommand( "ResourceStats",
+							  &hwResourceManager::ResourceStatsCommand,
+							  "Print cache hits, load times and sizes for all requested resources. "
+							  "Optionally takes the number of entries to print, sorted by load time." );
 }
 
 hwResourceManager::~hwResourceManager() {
+	DumpStats();
+
 	ClearTextures( true );
 	ClearModels( true );
 
@@ -57,6 +146,200 @@ const char* supported_image_formats[] = { "png", "tga", "bmp", "tim", nullptr };
 //const char *supported_audio_formats[]={"wav", NULL};
 //const char *supported_video_formats[]={"bik", NULL};
 
+/* Texture Cache
+ *
+ * Textures are compressed into BC1/BC3, along with their mip
+ * chain, on first load and written out under the cache directory.
+ * On subsequent loads the cache is used instead, provided the
+ * source image hasn't changed since, which is judged by its size
+ * and modification time. The source is only hashed if those don't
+ * match, so a file that was touched but not changed isn't
+ * compressed all over again.
+ */
+
+#define TEXTURE_CACHE_DIR "cache/textures/"
+
+enum {
+	TEXTURE_COMPRESSION_DISABLED,
+	TEXTURE_COMPRESSION_HARDWARE,   // upload the compressed data as-is
+	TEXTURE_COMPRESSION_SOFTWARE,   // decode back to RGBA8, for drivers lacking S3TC
+};
+
+static bool IsMipmapFilter( PLTextureFilter filter ) {
+	return !( filter == PL_TEXTURE_FILTER_LINEAR || filter == PL_TEXTURE_FILTER_NEAREST );
+}
+
+/**
+ * Returns the mode to use, falling back to decompressing in software
+ * if the driver can't take S3TC compressed textures.
+ */
+static int GetTextureCompressionMode() {
+	int mode = cv_graphics_texture_compression->i_value;
+	if ( mode == TEXTURE_COMPRESSION_HARDWARE && !GLEW_EXT_texture_compression_s3tc ) {
+		static bool warned = false;
+		if ( !warned ) {
+			LogWarn( "S3TC texture compression isn't supported, decompressing in software!\n" );
+			warned = true;
+		}
+		return TEXTURE_COMPRESSION_SOFTWARE;
+	}
+
+	return mode;
+}
+
+/**
+ * Fills in the size and modification time of the given source image,
+ * or hashes it if it's archived, as it's already sitting in memory.
+ */
+static bool GetSourceStamp( const std::string& path, DxtCacheStamp* stamp ) {
+	memset( stamp, 0, sizeof( DxtCacheStamp ) );
+
+	const void* data;
+	size_t size;
+	if ( Mod_MapFile( path.c_str(), &data, &size ) ) {
+		stamp->size = static_cast<uint32_t>( size );
+		stamp->hash = u_hash( data, size, U_HASH_SEED );
+		stamp->has_hash = true;
+		return true;
+	}
+
+	char localPath[PL_SYSTEM_MAX_PATH];
+	if ( !Mod_GetLocalPath( path.c_str(), localPath, sizeof( localPath ) ) ) {
+		snprintf( localPath, sizeof( localPath ), "%s", path.c_str() );
+	}
+
+	struct stat buf;
+	if ( stat( localPath, &buf ) != 0 ) {
+		return false;
+	}
+
+	stamp->size = static_cast<uint32_t>( buf.st_size );
+	stamp->mtime = static_cast<int64_t>( buf.st_mtime );
+	return true;
+}
+
+/**
+ * Hashes the contents of the given source image into the stamp.
+ */
+static bool HashSource( const std::string& path, DxtCacheStamp* stamp ) {
+	PLFile* file = plOpenFile( path.c_str(), false );
+	if ( file == nullptr ) {
+		return false;
+	}
+
+	std::vector<uint8_t> buf( plGetFileSize( file ) );
+	bool status = ( plReadFile( file, buf.data(), 1, buf.size() ) == buf.size() );
+	plCloseFile( file );
+	if ( !status || buf.empty() ) {
+		return false;
+	}
+
+	stamp->size = static_cast<uint32_t>( buf.size() );
+	stamp->hash = u_hash( buf.data(), buf.size(), U_HASH_SEED );
+	stamp->has_hash = true;
+	return true;
+}
+
+/**
+ * Fetches the compressed copy of the given texture from the cache, or
+ * otherwise generates it from the source image and writes it out.
+ */
+static DxtImage* GetCompressedImage( const std::string& path, double* decode_ms ) {
+	DxtCacheStamp stamp;
+	if ( !GetSourceStamp( path, &stamp ) ) {
+		return nullptr;
+	}
+
+	std::string cachePath = TEXTURE_CACHE_DIR + path + ".dxt";
+	DxtImage* dxt = Dxt_LoadCacheFile( cachePath.c_str(), &stamp );
+	if ( dxt != nullptr ) {
+		return dxt;
+	}
+
+	// Modification time doesn't match, so check whether it's really changed
+	if ( !stamp.has_hash ) {
+		if ( !HashSource( path, &stamp ) ) {
+			return nullptr;
+		}
+
+		dxt = Dxt_LoadCacheFile( cachePath.c_str(), &stamp );
+		if ( dxt != nullptr ) {
+			// Write it back out with the new time, so we don't hash it again next time
+			Dxt_WriteCacheFile( dxt, cachePath.c_str(), &stamp );
+			return dxt;
+		}
+	}
+
+	StatsTimer decodeTimer( decode_ms );
+
+	PLImage img;
+	if ( !plLoadImage( path.c_str(), &img ) ) {
+		return nullptr;
+	}
+
+	if ( img.format != PL_IMAGEFORMAT_RGBA8 ) {
+		plConvertPixelFormat( &img, PL_IMAGEFORMAT_RGBA8 );
+	}
+
+	dxt = Dxt_CreateImage( img.data[ 0 ], img.width, img.height, true );
+	plFreeImage( &img );
+	if ( dxt == nullptr ) {
+		return nullptr;
+	}
+
+	size_t pos = cachePath.find_last_of( '/' );
+	if ( plCreatePath( cachePath.substr( 0, pos ).c_str() ) ) {
+		Dxt_WriteCacheFile( dxt, cachePath.c_str(), &stamp );
+	}
+
+	return dxt;
+}
+
+/**
+ * Uploads the compressed image into the given texture, decoding it
+ * first if software decompression has been requested.
+ */
+static bool UploadCompressedImage( PLTexture* texture, DxtImage* dxt, const std::string& path ) {
+	PLImage img;
+	memset( &img, 0, sizeof( PLImage ) );
+	img.width = dxt->width;
+	img.height = dxt->height;
+	img.colour_format = PL_COLOURFORMAT_RGBA;
+	img.levels = IsMipmapFilter( texture->filter ) ? dxt->levels : 1;
+	snprintf( img.path, sizeof( img.path ), "%s", path.c_str() );
+
+	if ( GetTextureCompressionMode() != TEXTURE_COMPRESSION_SOFTWARE ) {
+		img.format = ( dxt->format == DXT_FORMAT_BC1 ) ? PL_IMAGEFORMAT_RGB_DXT1 : PL_IMAGEFORMAT_RGBA_DXT5;
+		img.data = dxt->data;
+		img.size = dxt->sizes[ 0 ];
+		return plUploadTextureImage( texture, &img );
+	}
+
+	uint8_t* levels[DXT_MAX_LEVELS];
+	for ( unsigned int i = 0; i < img.levels; ++i ) {
+		levels[ i ] = Dxt_DecodeLevel( dxt, i );
+		if ( levels[ i ] == nullptr ) {
+			for ( unsigned int j = 0; j < i; ++j ) {
+				u_free( levels[ j ] );
+			}
+
+			LogWarn( "Failed to decode level %u of \"%s\"!\n", i, path.c_str() );
+			return false;
+		}
+	}
+
+	img.format = PL_IMAGEFORMAT_RGBA8;
+	img.data = levels;
+	img.size = img.width * img.height * 4;
+	bool status = plUploadTextureImage( texture, &img );
+
+	for ( unsigned int i = 0; i < img.levels; ++i ) {
+		u_free( levels[ i ] );
+	}
+
+	return status;
+}
+
 PLTexture* hwResourceManager::GetCachedTexture( const std::string& path ) {
 	auto idx = textures_.find( path );
 	if ( idx != textures_.end() ) {
@@ -81,46 +364,34 @@ PLTexture* hwResourceManager::LoadTexture( const std::string& path, PLTextureFil
 	if ( plIsEmptyString( ext ) ) {
 		const char* fp = u_find2( path.c_str(), supported_image_formats, abort_on_fail );
 		if ( fp == nullptr ) {
-			return CacheTexture( path, GetFallbackTexture(), persist );
-		}
-
-		PLTexture* texture = GetCachedTexture( fp );
-		if ( texture != nullptr ) {
-			return texture;
+			return CacheTexture( path, GetFallbackTexture(), persist, filter );
 		}
 
-		texture = plLoadTextureFromImage( fp, filter );
-		if ( texture != nullptr ) {
-			return CacheTexture( fp, texture, persist );;
-		}
-
-		if ( abort_on_fail ) {
-			Error( "Failed to load texture, \"%s\" (%s)!\n", fp, plGetError() );
-		}
-
-		LogWarn( "%s, aborting!\n", plGetError() );
-		return CacheTexture( fp, GetFallbackTexture(), persist );
+		return LoadTexture( fp, filter, persist, abort_on_fail );
 	}
 
 	PLTexture* texture = GetCachedTexture( path );
 	if ( texture != nullptr ) {
+		stats_[ path ].hits++;
 		return texture;
 	}
 
-	PLImage img;
-	if ( plLoadImage( path.c_str(), &img ) ) {
-		// pixel format of TIM will be changed before uploading
-		if ( pl_strncasecmp( ext, "tim", 3 ) == 0 ) {
-			plConvertPixelFormat( &img, PL_IMAGEFORMAT_RGBA8 );
-		}
+	ResourceStats* stats = &stats_[ path ];
+	stats->type = ResourceStats::TEXTURE;
+	stats->misses++;
+	if ( stats->context.empty() ) {
+		stats->context = GetLoadContext();
+	}
 
-		texture = plCreateTexture();
-		if ( texture != nullptr ) {
-			texture->filter = filter;
-			if ( plUploadTextureImage( texture, &img ) ) {
-				return CacheTexture( path, texture, persist );
-			}
+	StatsTimer loadTimer( &stats->load_ms );
+
+	texture = plCreateTexture();
+	if ( texture != nullptr ) {
+		texture->filter = filter;
+		if ( UploadTexture( texture, path, stats ) ) {
+			return CacheTexture( path, texture, persist, filter );
 		}
+
 		plDestroyTexture( texture );
 	}
 
@@ -129,9 +400,62 @@ PLTexture* hwResourceManager::LoadTexture( const std::string& path, PLTextureFil
 	}
 
 	LogWarn( "Failed to load texture, \"%s\" (%s)!\n", path.c_str(), plGetError() );
+
+	return CacheTexture( path, GetFallbackTexture(), persist, filter );
+}
+
+/**
+ * Loads the given image into the texture, going through the compressed
+ * cache if it's enabled. The texture's filter should already be set.
+ * Shared by loads and reloads, so a texture that's reloaded comes back
+ * the same as it would from a fresh load.
+ */
+bool hwResourceManager::UploadTexture( PLTexture* texture, const std::string& path, ResourceStats* stats ) {
+	if ( GetTextureCompressionMode() != TEXTURE_COMPRESSION_DISABLED ) {
+		DxtImage* dxt = GetCompressedImage( path, &stats->decode_ms );
+		if ( dxt != nullptr ) {
+			bool status;
+			{
+				StatsTimer uploadTimer( &stats->upload_ms );
+				status = UploadCompressedImage( texture, dxt, path );
+			}
+			Dxt_DestroyImage( dxt );
+
+			if ( status ) {
+				stats->bytes = texture->size;
+				return true;
+			}
+
+			// Fall back to the source image below
+			LogWarn( "Failed to upload compressed texture, \"%s\" (%s)!\n", path.c_str(), plGetError() );
+		}
+	}
+
+	PLImage img;
+	{
+		StatsTimer decodeTimer( &stats->decode_ms );
+		if ( !plLoadImage( path.c_str(), &img ) ) {
+			return false;
+		}
+
+		// pixel format of TIM will be changed before uploading
+		if ( pl_strncasecmp( plGetFileExtension( path.c_str() ), "tim", 3 ) == 0 ) {
+			plConvertPixelFormat( &img, PL_IMAGEFORMAT_RGBA8 );
+		}
+	}
+
+	bool status;
+	{
+		StatsTimer uploadTimer( &stats->upload_ms );
+		status = plUploadTextureImage( texture, &img );
+	}
 	plFreeImage( &img );
 
-	return CacheTexture( path, GetFallbackTexture(), persist );;
+	if ( status ) {
+		stats->bytes = texture->size;
+	}
+
+	return status;
 }
 
 PLModel* hwResourceManager::LoadModel( const std::string& path, bool persist, bool abort_on_fail ) {
@@ -142,10 +466,22 @@ PLModel* hwResourceManager::LoadModel( const std::string& path, bool persist, bo
 
 	PLModel* model = GetCachedModel( fp );
 	if ( model != nullptr ) {
+		stats_[ fp ].hits++;
 		return model;
 	}
 
-	model = plLoadModel( fp );
+	ResourceStats* stats = &stats_[ fp ];
+	stats->type = ResourceStats::MODEL;
+	stats->misses++;
+	if ( stats->context.empty() ) {
+		stats->context = GetLoadContext();
+	}
+
+	{
+		StatsTimer loadTimer( &stats->load_ms );
+		model = plLoadModel( fp );
+	}
+
 	if ( model == nullptr ) {
 		if ( abort_on_fail ) {
 			Error( "Failed to load model, \"%s\" (%s)!\n", fp, plGetError() );
@@ -155,6 +491,8 @@ PLModel* hwResourceManager::LoadModel( const std::string& path, bool persist, bo
 		return CacheModel( fp, GetFallbackModel(), persist );
 	}
 
+	stats->bytes = GetModelSize( model );
+
 	return CacheModel( fp, model, persist );
 }
 
@@ -227,21 +565,24 @@ void hwResourceManager::ClearTextures( bool force ) {
 }
 
 void hwResourceManager::ClearModels( bool force ) {
+	Model_ClearAtlases();
+
 	if ( models_.empty() ) {
 		return;
 	}
 
-	for ( auto& i : models_ ) {
-		if ( ( i.second.persist && !force )
-			|| ( fallback_model_ != nullptr && i.second.model_ptr == fallback_model_ ) ) {
+	// Destroyed models are dropped from the cache too, so they're never released twice
+	for ( auto i = models_.begin(); i != models_.end(); ) {
+		if ( i->second.persist && !force ) {
+			++i;
 			continue;
 		}
 
-		plDestroyModel( i.second.model_ptr );
-	}
+		if ( fallback_model_ == nullptr || i->second.model_ptr != fallback_model_ ) {
+			Model_Destroy( i->second.model_ptr );
+		}
 
-	if ( force ) {
-		models_.clear();
+		i = models_.erase( i );
 	}
 }
 
@@ -250,6 +591,92 @@ void hwResourceManager::ClearAll() {
 	ClearTextures();
 }
 
+/**
+ * Reloads the given texture from disk and uploads it into
+ * the existing texture, so anything already holding onto
+ * it will pick up the change.
+ */
+void hwResourceManager::ReloadTexture( const std::string& path ) {
+	auto idx = textures_.find( path );
+	if ( idx == textures_.end() ) {
+		return;
+	}
+
+	// The fallback is shared between every failed load, so it can't be
+	// replaced in place; give the entry its own texture from now on
+	PLTexture* texture = idx->second.texture_ptr;
+	bool fallback = ( texture == fallback_texture_ );
+	if ( fallback ) {
+		texture = plCreateTexture();
+		if ( texture == nullptr ) {
+			LogWarn( "Failed to create texture, \"%s\" (%s)!\n", path.c_str(), plGetError() );
+			return;
+		}
+
+		texture->filter = idx->second.filter;
+	}
+
+	if ( !UploadTexture( texture, path, &stats_[ path ] ) ) {
+		LogWarn( "Failed to reload texture, \"%s\" (%s)!\n", path.c_str(), plGetError() );
+		if ( fallback ) {
+			plDestroyTexture( texture );
+		}
+		return;
+	}
+
+	if ( fallback ) {
+		idx->second.texture_ptr = texture;
+	}
+}
+
+/**
+ * Reloads the given model from disk and swaps its contents
+ * into the existing model.
+ */
+void hwResourceManager::ReloadModel( const std::string& path ) {
+	auto idx = models_.find( path );
+	if ( idx == models_.end() ) {
+		return;
+	}
+
+	PLModel* model = plLoadModel( path.c_str() );
+	if ( model == nullptr ) {
+		LogWarn( "Failed to reload model, \"%s\" (%s)!\n", path.c_str(), plGetError() );
+		return;
+	}
+
+	if ( idx->second.model_ptr == fallback_model_ ) {
+		idx->second.model_ptr = model;
+		return;
+	}
+
+	stats_[ path ].bytes = GetModelSize( model );
+
+	// Swap the contents over, and then destroy the old data
+	PLModel old = *idx->second.model_ptr;
+	*idx->second.model_ptr = *model;
+	*model = old;
+	Model_Destroy( model );
+}
+
+/**
+ * Reloads all the cached models that live directly under
+ * the given directory.
+ */
+void hwResourceManager::ReloadModels( const std::string& directory ) {
+	// The models here share an atlas, which will need rebuilding too
+	Model_ClearAtlases( directory.c_str() );
+
+	for ( const auto& i : models_ ) {
+		if ( i.first.compare( 0, directory.length(), directory ) != 0 ||
+			i.first.find( '/', directory.length() ) != std::string::npos ) {
+			continue;
+		}
+
+		ReloadModel( i.first );
+	}
+}
+
 void hwResourceManager::ListCachedResources( unsigned int argc, char** argv ) {
 	u_unused( argc );
 	u_unused( argv );
@@ -283,3 +710,143 @@ void hwResourceManager::ClearModelsCommand( unsigned int argc, char** argv ) {
 
 	Engine::Resource()->ClearModels();
 }
+
+/**
+ * Returns the cached statistics, sorted by the total time spent loading.
+ */
+std::vector<std::pair<std::string, hwResourceManager::ResourceStats>> hwResourceManager::GetSortedStats() const {
+	std::vector<std::pair<std::string, ResourceStats>> sorted( stats_.begin(), stats_.end() );
+	std::sort( sorted.begin(), sorted.end(), []( const std::pair<std::string, ResourceStats>& a,
+												 const std::pair<std::string, ResourceStats>& b ) {
+		return a.second.load_ms > b.second.load_ms;
+	} );
+
+	return sorted;
+}
+
+/**
+ * Writes out the statistics for every requested resource
+ * into a JSON file at the given path.
+ */
+/**
+ * Escapes the given string for writing out between quotes in JSON,
+ * paths on Windows being full of backslashes.
+ */
+static std::string EscapeJsonString( const std::string& string ) {
+	std::string out;
+	out.reserve( string.size() );
+	for ( char c : string ) {
+		if ( c == '"' || c == '\\' ) {
+			out += '\\';
+			out += c;
+		} else if ( static_cast<unsigned char>( c ) < 0x20 ) {
+			char code[ 8 ];
+			snprintf( code, sizeof( code ), "\\u%04x", static_cast<unsigned char>( c ) );
+			out += code;
+		} else {
+			out += c;
+		}
+	}
+
+	return out;
+}
+
+void hwResourceManager::DumpStats( const char* path ) const {
+	if ( stats_.empty() ) {
+		return;
+	}
+
+	plCreatePath( "debug" );
+
+	FILE* fp = fopen( path, "w" );
+	if ( fp == nullptr ) {
+		LogWarn( "Failed to open \"%s\" for writing!\n", path );
+		return;
+	}
+
+	fprintf( fp, "{\n\t\"resources\":[\n" );
+
+	std::vector<std::pair<std::string, ResourceStats>> sorted = GetSortedStats();
+	for ( auto i = sorted.begin(); i != sorted.end(); ++i ) {
+		const ResourceStats& stats = i->second;
+		fprintf( fp,
+				 "\t\t{\"path\":\"%s\",\"type\":\"%s\",\"context\":\"%s\",\"hits\":%u,\"misses\":%u,"
+				 "\"loadMs\":%.3f,\"decodeMs\":%.3f,\"uploadMs\":%.3f,\"bytes\":%lu}%s\n",
+				 EscapeJsonString( i->first ).c_str(),
+				 stats.type == ResourceStats::TEXTURE ? "texture" : "model",
+				 EscapeJsonString( stats.context ).c_str(),
+				 stats.hits, stats.misses,
+				 stats.load_ms, stats.decode_ms, stats.upload_ms,
+				 ( unsigned long ) stats.bytes,
+				 ( i + 1 ) == sorted.end() ? "" : "," );
+	}
+
+	fprintf( fp, "\t]\n}\n" );
+	fclose( fp );
+
+	LogInfo( "Wrote resource statistics to \"%s\"\n", path );
+}
+
+void hwResourceManager::ResourceStatsCommand( unsigned int argc, char** argv ) {
+	unsigned int limit = UINT32_MAX;
+	if ( argc > 1 && argv[ 1 ] != nullptr ) {
+		limit = ( unsigned int ) strtoul( argv[ 1 ], nullptr, 10 );
+	}
+
+	std::vector<std::pair<std::string, ResourceStats>> sorted = Engine::Resource()->GetSortedStats();
+
+	unsigned int hits = 0, misses = 0;
+	double load_ms = 0;
+	size_t bytes = 0;
+	for ( const auto& i : sorted ) {
+		hits += i.second.hits;
+		misses += i.second.misses;
+		load_ms += i.second.load_ms;
+		bytes += i.second.bytes;
+	}
+
+	LogInfo( "Printing resource statistics...\n" );
+
+	unsigned int num = 0;
+	for ( const auto& i : sorted ) {
+		if ( num++ >= limit ) {
+			break;
+		}
+
+		const ResourceStats& stats = i.second;
+		LogInfo( " %s %s : hits(%u) misses(%u) load(%.2fms) decode(%.2fms) upload(%.2fms) size(%ukb) context(%s)\n",
+				 stats.type == ResourceStats::TEXTURE ? "texture" : "model",
+				 i.first.c_str(),
+				 stats.hits, stats.misses,
+				 stats.load_ms, stats.decode_ms, stats.upload_ms,
+				 ( unsigned int ) plBytesToKilobytes( stats.bytes ),
+				 stats.context.c_str() );
+	}
+
+	LogInfo( "%u resources, %u hits, %u misses (%.1f%% hit rate), %.2fms loading, %ukb\n",
+			 ( unsigned int ) sorted.size(), hits, misses,
+			 ( hits + misses ) > 0 ? ( ( float ) hits / ( float ) ( hits + misses ) ) * 100.0f : 0.0f,
+			 load_ms, ( unsigned int ) plBytesToKilobytes( bytes ) );
+}
+
+static void CompressTexture( const char* path ) {
+	DxtImage* dxt = GetCompressedImage( path, nullptr );
+	if ( dxt == nullptr ) {
+		LogWarn( "Failed to compress \"%s\"!\n", path );
+		return;
+	}
+
+	LogInfo( "Compressed \"%s\" (%ux%u, %u levels)\n", path, dxt->width, dxt->height, dxt->levels );
+	Dxt_DestroyImage( dxt );
+}
+
+void hwResourceManager::CompressTexturesCommand( unsigned int argc, char** argv ) {
+	if ( argc < 2 ) {
+		LogWarn( "Please provide the directory to compress, e.g. \"CompressTextures chars\"!\n" );
+		return;
+	}
+
+	for ( unsigned int i = 0; supported_image_formats[ i ] != nullptr; ++i ) {
+		plScanDirectory( argv[ 1 ], supported_image_formats[ i ], CompressTexture, true );
+	}
+}
@@ -43,26 +43,72 @@ public:
 
 	void ClearAll();
 
+	// Reload the cached resource in place, existing pointers remain valid
+	void ReloadTexture( const std::string& path );
+	void ReloadModel( const std::string& path );
+	void ReloadModels( const std::string& directory );
+
+	struct ResourceStats {
+		enum Type {
+			TEXTURE,
+			MODEL,
+		} type{ TEXTURE };
+
+		unsigned int hits{ 0 };     // Number of times it was returned from the cache
+		unsigned int misses{ 0 };   // Number of times it had to be loaded
+
+		// Times are cumulative, in milliseconds
+		double load_ms{ 0 };
+		double decode_ms{ 0 };
+		double upload_ms{ 0 };
+
+		size_t bytes{ 0 };
+
+		std::string context; // Whatever triggered the first load
+	};
+	const std::map<std::string, ResourceStats>& GetStats() const { return stats_; }
+	std::vector<std::pair<std::string, ResourceStats>> GetSortedStats() const;
+	void DumpStats( const char* path = "debug/resource_stats.json" ) const;
+
+	/**
+	 * Any loads made while this is in scope are attributed to
+	 * the given name in the statistics, e.g. "Map" or "Frontend".
+	 */
+	class LoadContext {
+	public:
+		explicit LoadContext( const char* name );
+		~LoadContext();
+	};
+
 private:
 	static void ListCachedResources( unsigned int argc, char** argv );
 	static void ClearTexturesCommand( unsigned int argc, char** argv );
 	static void ClearModelsCommand( unsigned int argc, char** argv );
+	static void ResourceStatsCommand( unsigned int argc, char** argv );
+	static void CompressTexturesCommand( unsigned int argc, char** argv );
+
+	std::map<std::string, ResourceStats> stats_;
 
 	struct TextureHandle {
-		TextureHandle( PLTexture* texture_ptr, bool persist ) {
+		TextureHandle( PLTexture* texture_ptr, bool persist, PLTextureFilter filter ) {
 			this->texture_ptr = texture_ptr;
 			this->persist = persist;
+			this->filter = filter;
 		}
 
 		PLTexture* texture_ptr{ nullptr };
 		bool persist{ false };
+		PLTextureFilter filter{ PL_TEXTURE_FILTER_MIPMAP_NEAREST };   // As requested, in case it's reloaded
 	};
 	std::map<std::string, TextureHandle> textures_;
-	inline PLTexture* CacheTexture( const std::string& path, PLTexture* texture_ptr, bool persist = false ) {
-		textures_.insert( std::pair<std::string, TextureHandle>( path, { texture_ptr, persist } ) );
+	inline PLTexture* CacheTexture( const std::string& path, PLTexture* texture_ptr, bool persist = false,
+									PLTextureFilter filter = PL_TEXTURE_FILTER_MIPMAP_NEAREST ) {
+		textures_.insert( std::pair<std::string, TextureHandle>( path, { texture_ptr, persist, filter } ) );
 		return texture_ptr;
 	}
 
+	bool UploadTexture( PLTexture* texture, const std::string& path, ResourceStats* stats );
+
 	struct ModelHandle {
 		ModelHandle( PLModel* model_ptr, bool persist ) {
 			this->model_ptr = model_ptr;
@@ -22,8 +22,11 @@
 
 #include "graphics/mesh.h"
 #include "graphics/shaders.h"
+#include "graphics/texture_array.h"
 #include "graphics/texture_atlas.h"
 #include "graphics/display.h"
+#include "loaders/loaders.h"
+#include "mod_support.h"
 
 //Precalculated vertices for chunk rendering
 //TODO: Share one index buffer instance between all chunks
@@ -47,15 +50,34 @@ const static unsigned int chunk_indices[96] = {
 };
 
 Terrain::Terrain( const std::string& tileset ) {
-	// attempt to load in the atlas sheet
 	// TODO: allow us to change this on the fly
-	atlas_ = new TextureAtlas( 512, 8 );
-	for ( unsigned int i = 0; i < 256; ++i ) {
-		if ( !atlas_->AddImage( tileset + std::to_string( i ) ) ) {
-			break;
+	if ( cv_graphics_terrain_array->b_value && !TextureArray::IsSupported() ) {
+		LogWarn( "Array textures aren't supported by the current driver, falling back to atlas!\n" );
+	} else if ( cv_graphics_terrain_array->b_value ) {
+		array_ = new TextureArray();
+		for ( unsigned int i = 0; i < 256; ++i ) {
+			if ( !array_->AddImage( tileset + std::to_string( i ) ) ) {
+				break;
+			}
+		}
+
+		if ( !array_->Finalize() ) {
+			LogWarn( "Failed to create texture array for terrain, falling back to atlas!\n" );
+			delete array_;
+			array_ = nullptr;
 		}
 	}
-	atlas_->Finalize();
+
+	// attempt to load in the atlas sheet
+	if ( array_ == nullptr ) {
+		atlas_ = new TextureAtlas( 512, 8 );
+		for ( unsigned int i = 0; i < 256; ++i ) {
+			if ( !atlas_->AddImage( tileset + std::to_string( i ) ) ) {
+				break;
+			}
+		}
+		atlas_->Finalize();
+	}
 
 	chunks_.resize( TERRAIN_CHUNKS );
 
@@ -63,6 +85,7 @@ Terrain::Terrain( const std::string& tileset ) {
 }
 
 Terrain::~Terrain() {
+	delete array_;
 	delete atlas_;
 
 	for ( auto& chunk : chunks_ ) {
@@ -136,8 +159,15 @@ void Terrain::GenerateModel( Chunk* chunk, const PLVector2& offset ) {
 		for ( unsigned int tile_x = 0; tile_x < TERRAIN_CHUNK_ROW_TILES; ++tile_x ) {
 			const Tile* current_tile = &chunk->tiles[ tile_x + tile_y * TERRAIN_CHUNK_ROW_TILES ];
 
-			float tx_x, tx_y, tx_w, tx_h;
-			atlas_->GetTextureCoords( std::to_string( current_tile->texture ), &tx_x, &tx_y, &tx_w, &tx_h );
+			// Array layers each cover the whole of their own ST range, so only the
+			// layer index is needed, which is passed through in the vertex alpha
+			float tx_x = 0, tx_y = 0, tx_w = 1, tx_h = 1;
+			uint8_t layer = 255;
+			if ( array_ != nullptr ) {
+				layer = current_tile->texture < array_->GetNumLayers() ? current_tile->texture : 0;
+			} else {
+				atlas_->GetTextureCoords( std::to_string( current_tile->texture ), &tx_x, &tx_y, &tx_w, &tx_h );
+			}
 
 			// TERRAIN_FLIP_FLAG_X flips around texture sheet coords, not TERRAIN coords.
 			if ( current_tile->rotation & Tile::ROTATION_FLAG_X ) {
@@ -180,12 +210,13 @@ void Terrain::GenerateModel( Chunk* chunk, const PLVector2& offset ) {
 				plSetMeshVertexColour( chunk_mesh, cm_idx, {
 					current_tile->shading[ i ],
 					current_tile->shading[ i ],
-					current_tile->shading[ i ] } );
+					current_tile->shading[ i ],
+					layer } );
 			}
 		}
 	}
 
-	chunk_mesh->texture = atlas_->GetTexture();
+	chunk_mesh->texture = ( array_ != nullptr ) ? nullptr : atlas_->GetTexture();
 
 	// attach the mesh to our model
 	PLModel* model = plCreateBasicStaticModel( chunk_mesh );
@@ -280,7 +311,14 @@ void Terrain::Update() {
 }
 
 void Terrain::Draw() {
-	Shaders_SetProgramByName( cv_graphics_debug_normals->b_value ? "debug_normals" : "generic_textured_lit" );
+	if ( cv_graphics_debug_normals->b_value ) {
+		Shaders_SetProgramByName( "debug_normals" );
+	} else if ( array_ != nullptr ) {
+		Shaders_SetProgramByName( "terrain_array" );
+		array_->Bind();
+	} else {
+		Shaders_SetProgramByName( "generic_textured_lit" );
+	}
 
 	g_state.gfx.num_chunks_drawn = 0;
 	for ( const auto& chunk : chunks_ ) {
@@ -293,38 +331,32 @@ void Terrain::Draw() {
 	}
 }
 
+static_assert( PMG_CHUNK_ROW == TERRAIN_CHUNK_ROW && PMG_CHUNK_ROW_TILES == TERRAIN_CHUNK_ROW_TILES,
+			   "Pmg layout doesn't match the terrain!" );
+
 void Terrain::LoadPmg( const std::string& path ) {
-	PLFile* fh = plOpenFile( path.c_str(), false );
-	if ( fh == nullptr ) {
-		LogWarn( "Failed to open tile data, \"%s\", aborting\n", path.c_str() );
+	const void* data;
+	size_t size;
+	PmgHandle* pmg;
+	if ( Mod_MapFile( path.c_str(), &data, &size ) ) {
+		pmg = Pmg_LoadMemory( data, size, path.c_str(), nullptr );
+	} else {
+		pmg = Pmg_LoadFile( path.c_str(), nullptr );
+	}
+
+	if ( pmg == nullptr ) {
+		LogWarn( "Failed to load tile data, \"%s\", aborting\n", path.c_str() );
 		return;
 	}
 
 	for ( unsigned int chunk_y = 0; chunk_y < TERRAIN_CHUNK_ROW; ++chunk_y ) {
 		for ( unsigned int chunk_x = 0; chunk_x < TERRAIN_CHUNK_ROW; ++chunk_x ) {
 			Chunk& current_chunk = chunks_[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
-
-			struct __attribute__((packed)) {
-				/* offsets */
-				uint16_t x{ 0 };
-				uint16_t y{ 0 };
-				uint16_t z{ 0 };
-				uint16_t unknown0{ 0 };
-			} chunk;
-			if ( plReadFile( fh, &chunk, sizeof( chunk ), 1 ) != 1 ) {
-				Error( "unexpected end of file, aborting!\n" );
-			}
-
-			struct __attribute__((packed)) {
-				int16_t height{ 0 };
-				uint16_t lighting{ 0 };
-			} vertices[25];
-			if ( plReadFile( fh, vertices, sizeof( *vertices ), 25 ) != 25 ) {
-				Error( "Unexpected end of file, aborting!\n" );
-			}
+			const PmgChunk& chunk = pmg->chunks[ chunk_x + chunk_y * TERRAIN_CHUNK_ROW ];
+			const PmgVertex* vertices = chunk.vertices;
 
 			// Find the maximum and minimum points
-			for ( auto& vertex : vertices ) {
+			for ( const auto& vertex : chunk.vertices ) {
 				if ( static_cast<float>(vertex.height) > max_height_ ) {
 					max_height_ = vertex.height;
 				}
@@ -333,22 +365,9 @@ void Terrain::LoadPmg( const std::string& path ) {
 				}
 			}
 
-			plFileSeek( fh, 4, PL_SEEK_CUR );
-
 			for ( unsigned int tile_y = 0; tile_y < TERRAIN_CHUNK_ROW_TILES; ++tile_y ) {
 				for ( unsigned int tile_x = 0; tile_x < TERRAIN_CHUNK_ROW_TILES; ++tile_x ) {
-					struct __attribute__((packed)) {
-						int8_t unused0[6]{ 0, 0, 0, 0, 0, 0 };
-						uint8_t type{ 0 };
-						uint8_t slip{ 0 };
-						int16_t unused1{ 0 };
-						uint8_t rotation{ 0 };
-						uint32_t texture{ 0 };
-						uint8_t unused2{ 0 };
-					} tile;
-					if ( plReadFile( fh, &tile, sizeof( tile ), 1 ) != 1 ) {
-						Error( "unexpected end of file, aborting!\n" );
-					}
+					const PmgTile& tile = chunk.tiles[ tile_x + tile_y * TERRAIN_CHUNK_ROW_TILES ];
 
 					Tile* current_tile = &current_chunk.tiles[ tile_x + tile_y * TERRAIN_CHUNK_ROW_TILES ];
 					current_tile->surface = static_cast<Tile::Surface>(tile.type & 31U);
@@ -371,7 +390,7 @@ void Terrain::LoadPmg( const std::string& path ) {
 		}
 	}
 
-	plCloseFile( fh );
+	Pmg_DestroyHandle( pmg, nullptr );
 
 	Update();
 }
@@ -30,6 +30,7 @@
 #define TERRAIN_PIXEL_WIDTH         (TERRAIN_TILE_PIXEL_WIDTH * TERRAIN_ROW_TILES)
 
 class TextureAtlas;
+class TextureArray;
 
 class Terrain {
  public:
@@ -108,6 +109,8 @@ class Terrain {
 
   std::vector<Chunk> chunks_;
 
+  // Only one of these is used, the array unless it's disabled or unsupported
+  TextureArray* array_{nullptr};
   TextureAtlas* atlas_{nullptr};
   PLTexture* overview_{nullptr};
 };
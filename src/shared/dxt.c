@@ -0,0 +1,465 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PL/platform_filesystem.h>
+
+#include "util.h"
+#include "dxt.h"
+
+/************************************************************/
+/* Dxt Block Compression
+ *
+ * Simple BC1/BC3 encoder, used to produce the texture cache
+ * files preferred by the resource manager. Endpoints are just
+ * taken from the inset bounding box of each block, which is
+ * nowhere near as good as a proper encoder but is cheap enough
+ * to run on first load. A decoder is also provided for drivers
+ * that lack S3TC support. */
+
+typedef struct __attribute__((packed)) DxtCacheHeader {
+  char identifier[4]; /* DXTC */
+  uint32_t version;
+  uint32_t source_size;
+  uint32_t source_hash;
+  int64_t source_mtime;
+  uint16_t width;
+  uint16_t height;
+  uint8_t format;
+  uint8_t levels;
+  uint16_t padding;
+} DxtCacheHeader;
+
+unsigned int Dxt_GetLevelSize(DxtFormat format, unsigned int width, unsigned int height) {
+  unsigned int bw = (width + 3) / 4;
+  unsigned int bh = (height + 3) / 4;
+  if (bw == 0) bw = 1;
+  if (bh == 0) bh = 1;
+  return bw * bh * (format == DXT_FORMAT_BC1 ? 8 : 16);
+}
+
+/**
+ * Downsample an RGBA8 image by half using a box filter.
+ * Odd dimensions are clamped at the edge.
+ */
+void Dxt_GenerateMipLevel(const uint8_t *src, unsigned int width, unsigned int height, uint8_t *dst) {
+  unsigned int dw = width > 1 ? width / 2 : 1;
+  unsigned int dh = height > 1 ? height / 2 : 1;
+  for (unsigned int y = 0; y < dh; ++y) {
+    unsigned int y0 = y * 2;
+    unsigned int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+    for (unsigned int x = 0; x < dw; ++x) {
+      unsigned int x0 = x * 2;
+      unsigned int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+      const uint8_t *a = src + (y0 * width + x0) * 4;
+      const uint8_t *b = src + (y0 * width + x1) * 4;
+      const uint8_t *c = src + (y1 * width + x0) * 4;
+      const uint8_t *d = src + (y1 * width + x1) * 4;
+      for (unsigned int i = 0; i < 4; ++i) {
+        dst[(y * dw + x) * 4 + i] = (uint8_t) ((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+      }
+    }
+  }
+}
+
+static uint16_t Dxt_PackColour(const uint8_t *c) {
+  return (uint16_t) (((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+static void Dxt_UnpackColour(uint16_t v, uint8_t *c) {
+  uint8_t r = (uint8_t) ((v >> 11) & 31);
+  uint8_t g = (uint8_t) ((v >> 5) & 63);
+  uint8_t b = (uint8_t) (v & 31);
+  c[0] = (uint8_t) ((r << 3) | (r >> 2));
+  c[1] = (uint8_t) ((g << 2) | (g >> 4));
+  c[2] = (uint8_t) ((b << 3) | (b >> 2));
+  c[3] = 255;
+}
+
+static void Dxt_FetchBlock(const uint8_t *rgba, unsigned int width, unsigned int height,
+                           unsigned int bx, unsigned int by, uint8_t block[16][4]) {
+  for (unsigned int y = 0; y < 4; ++y) {
+    unsigned int sy = by * 4 + y;
+    if (sy >= height) sy = height - 1;
+    for (unsigned int x = 0; x < 4; ++x) {
+      unsigned int sx = bx * 4 + x;
+      if (sx >= width) sx = width - 1;
+      memcpy(block[y * 4 + x], rgba + (sy * width + sx) * 4, 4);
+    }
+  }
+}
+
+static void Dxt_EncodeColourBlock(uint8_t block[16][4], uint8_t *out) {
+  uint8_t min[3] = {255, 255, 255}, max[3] = {0, 0, 0};
+  for (unsigned int i = 0; i < 16; ++i) {
+    for (unsigned int j = 0; j < 3; ++j) {
+      if (block[i][j] < min[j]) min[j] = block[i][j];
+      if (block[i][j] > max[j]) max[j] = block[i][j];
+    }
+  }
+
+  /* inset the bounding box slightly, reduces error for most blocks */
+  for (unsigned int j = 0; j < 3; ++j) {
+    uint8_t inset = (uint8_t) ((max[j] - min[j]) >> 4);
+    min[j] = (uint8_t) (min[j] + inset);
+    max[j] = (uint8_t) (max[j] - inset);
+  }
+
+  uint16_t c0 = Dxt_PackColour(max);
+  uint16_t c1 = Dxt_PackColour(min);
+  if (c0 < c1) {
+    uint16_t t = c0;
+    c0 = c1;
+    c1 = t;
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    uint8_t palette[4][4];
+    Dxt_UnpackColour(c0, palette[0]);
+    Dxt_UnpackColour(c1, palette[1]);
+    for (unsigned int j = 0; j < 3; ++j) {
+      palette[2][j] = (uint8_t) ((2 * palette[0][j] + palette[1][j]) / 3);
+      palette[3][j] = (uint8_t) ((palette[0][j] + 2 * palette[1][j]) / 3);
+    }
+
+    for (unsigned int i = 0; i < 16; ++i) {
+      unsigned int best = 0, best_dist = UINT32_MAX;
+      for (unsigned int p = 0; p < 4; ++p) {
+        int dr = block[i][0] - palette[p][0];
+        int dg = block[i][1] - palette[p][1];
+        int db = block[i][2] - palette[p][2];
+        unsigned int dist = (unsigned int) (dr * dr + dg * dg + db * db);
+        if (dist < best_dist) {
+          best_dist = dist;
+          best = p;
+        }
+      }
+      indices |= best << (i * 2);
+    }
+  }
+
+  out[0] = (uint8_t) (c0 & 0xFF);
+  out[1] = (uint8_t) (c0 >> 8);
+  out[2] = (uint8_t) (c1 & 0xFF);
+  out[3] = (uint8_t) (c1 >> 8);
+  out[4] = (uint8_t) (indices & 0xFF);
+  out[5] = (uint8_t) ((indices >> 8) & 0xFF);
+  out[6] = (uint8_t) ((indices >> 16) & 0xFF);
+  out[7] = (uint8_t) (indices >> 24);
+}
+
+static void Dxt_BuildAlphaPalette(uint8_t a0, uint8_t a1, uint8_t *palette) {
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (unsigned int i = 1; i < 7; ++i) {
+      palette[i + 1] = (uint8_t) (((7 - i) * a0 + i * a1) / 7);
+    }
+  } else {
+    for (unsigned int i = 1; i < 5; ++i) {
+      palette[i + 1] = (uint8_t) (((5 - i) * a0 + i * a1) / 5);
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+static void Dxt_EncodeAlphaBlock(uint8_t block[16][4], uint8_t *out) {
+  uint8_t min = 255, max = 0;
+  for (unsigned int i = 0; i < 16; ++i) {
+    if (block[i][3] < min) min = block[i][3];
+    if (block[i][3] > max) max = block[i][3];
+  }
+
+  uint64_t indices = 0;
+  if (max != min) {
+    uint8_t palette[8];
+    Dxt_BuildAlphaPalette(max, min, palette);
+    for (unsigned int i = 0; i < 16; ++i) {
+      unsigned int best = 0, best_dist = UINT32_MAX;
+      for (unsigned int p = 0; p < 8; ++p) {
+        int d = block[i][3] - palette[p];
+        unsigned int dist = (unsigned int) (d * d);
+        if (dist < best_dist) {
+          best_dist = dist;
+          best = p;
+        }
+      }
+      indices |= (uint64_t) best << (i * 3);
+    }
+  }
+
+  out[0] = max;
+  out[1] = min;
+  for (unsigned int i = 0; i < 6; ++i) {
+    out[2 + i] = (uint8_t) ((indices >> (i * 8)) & 0xFF);
+  }
+}
+
+static void Dxt_DecodeColourBlock(const uint8_t *in, bool allow_transparent, uint8_t block[16][4]) {
+  uint16_t c0 = (uint16_t) (in[0] | (in[1] << 8));
+  uint16_t c1 = (uint16_t) (in[2] | (in[3] << 8));
+  uint32_t indices = (uint32_t) in[4] | ((uint32_t) in[5] << 8) | ((uint32_t) in[6] << 16) | ((uint32_t) in[7] << 24);
+
+  uint8_t palette[4][4];
+  Dxt_UnpackColour(c0, palette[0]);
+  Dxt_UnpackColour(c1, palette[1]);
+  if (c0 > c1 || !allow_transparent) {
+    for (unsigned int j = 0; j < 3; ++j) {
+      palette[2][j] = (uint8_t) ((2 * palette[0][j] + palette[1][j]) / 3);
+      palette[3][j] = (uint8_t) ((palette[0][j] + 2 * palette[1][j]) / 3);
+    }
+    palette[2][3] = palette[3][3] = 255;
+  } else {
+    for (unsigned int j = 0; j < 3; ++j) {
+      palette[2][j] = (uint8_t) ((palette[0][j] + palette[1][j]) / 2);
+      palette[3][j] = 0;
+    }
+    palette[2][3] = 255;
+    palette[3][3] = 0;
+  }
+
+  for (unsigned int i = 0; i < 16; ++i) {
+    memcpy(block[i], palette[(indices >> (i * 2)) & 3], 4);
+  }
+}
+
+static void Dxt_DecodeAlphaBlock(const uint8_t *in, uint8_t block[16][4]) {
+  uint8_t palette[8];
+  Dxt_BuildAlphaPalette(in[0], in[1], palette);
+
+  uint64_t indices = 0;
+  for (unsigned int i = 0; i < 6; ++i) {
+    indices |= (uint64_t) in[2 + i] << (i * 8);
+  }
+
+  for (unsigned int i = 0; i < 16; ++i) {
+    block[i][3] = palette[(indices >> (i * 3)) & 7];
+  }
+}
+
+static void Dxt_EncodeLevel(const uint8_t *rgba, unsigned int width, unsigned int height,
+                            DxtFormat format, uint8_t *out) {
+  unsigned int bw = (width + 3) / 4, bh = (height + 3) / 4;
+  for (unsigned int by = 0; by < bh; ++by) {
+    for (unsigned int bx = 0; bx < bw; ++bx) {
+      uint8_t block[16][4];
+      Dxt_FetchBlock(rgba, width, height, bx, by, block);
+      if (format == DXT_FORMAT_BC3) {
+        Dxt_EncodeAlphaBlock(block, out);
+        out += 8;
+      }
+      Dxt_EncodeColourBlock(block, out);
+      out += 8;
+    }
+  }
+}
+
+/**
+ * Compress the given RGBA8 image, optionally along with a full
+ * mip chain. BC3 is only used if the image has any transparency.
+ */
+DxtImage *Dxt_CreateImage(const uint8_t *rgba, unsigned int width, unsigned int height, bool generate_mips) {
+  if (width == 0 || height == 0 || width > UINT16_MAX || height > UINT16_MAX) {
+    LogWarn("Invalid image dimensions for compression (%ux%u)!\n", width, height);
+    return NULL;
+  }
+
+  DxtImage *image = u_alloc(1, sizeof(DxtImage), true);
+  image->width = width;
+  image->height = height;
+  image->format = DXT_FORMAT_BC1;
+  for (unsigned int i = 0; i < width * height; ++i) {
+    if (rgba[i * 4 + 3] != 255) {
+      image->format = DXT_FORMAT_BC3;
+      break;
+    }
+  }
+
+  const uint8_t *src = rgba;
+  uint8_t *mip = NULL;
+  unsigned int w = width, h = height;
+  for (image->levels = 0; image->levels < DXT_MAX_LEVELS; ++image->levels) {
+    unsigned int level = image->levels;
+    image->sizes[level] = Dxt_GetLevelSize(image->format, w, h);
+    image->data[level] = u_alloc(image->sizes[level], 1, true);
+    Dxt_EncodeLevel(src, w, h, image->format, image->data[level]);
+
+    if (!generate_mips || (w == 1 && h == 1)) {
+      image->levels++;
+      break;
+    }
+
+    unsigned int nw = w > 1 ? w / 2 : 1;
+    unsigned int nh = h > 1 ? h / 2 : 1;
+    uint8_t *next = u_alloc(nw * nh, 4, true);
+    Dxt_GenerateMipLevel(src, w, h, next);
+    u_free(mip);
+    src = mip = next;
+    w = nw;
+    h = nh;
+  }
+
+  u_free(mip);
+  return image;
+}
+
+/**
+ * Decompresses the given level into a newly allocated RGBA8 buffer.
+ */
+uint8_t *Dxt_DecodeLevel(const DxtImage *image, unsigned int level) {
+  if (level >= image->levels) {
+    return NULL;
+  }
+
+  unsigned int w = image->width >> level, h = image->height >> level;
+  if (w == 0) w = 1;
+  if (h == 0) h = 1;
+
+  uint8_t *rgba = u_alloc(w * h, 4, true);
+  const uint8_t *in = image->data[level];
+  unsigned int bw = (w + 3) / 4, bh = (h + 3) / 4;
+  for (unsigned int by = 0; by < bh; ++by) {
+    for (unsigned int bx = 0; bx < bw; ++bx) {
+      uint8_t block[16][4];
+      if (image->format == DXT_FORMAT_BC3) {
+        Dxt_DecodeColourBlock(in + 8, false, block);
+        Dxt_DecodeAlphaBlock(in, block);
+        in += 16;
+      } else {
+        Dxt_DecodeColourBlock(in, true, block);
+        in += 8;
+      }
+
+      for (unsigned int y = 0; y < 4 && by * 4 + y < h; ++y) {
+        for (unsigned int x = 0; x < 4 && bx * 4 + x < w; ++x) {
+          memcpy(rgba + ((by * 4 + y) * w + bx * 4 + x) * 4, block[y * 4 + x], 4);
+        }
+      }
+    }
+  }
+
+  return rgba;
+}
+
+void Dxt_DestroyImage(DxtImage *image) {
+  if (image == NULL) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < image->levels; ++i) {
+    u_free(image->data[i]);
+  }
+  u_free(image);
+}
+
+/************************************************************/
+/* Cache Files */
+
+/**
+ * Load the given cache file, returns NULL if it doesn't exist
+ * or was generated from a different source image. The source
+ * matches if its size and either its modification time or,
+ * when provided, its hash are the same.
+ */
+DxtImage *Dxt_LoadCacheFile(const char *path, const DxtCacheStamp *stamp) {
+  PLFile *file = plOpenFile(path, false);
+  if (file == NULL) {
+    return NULL;
+  }
+
+  DxtCacheHeader header;
+  if (plReadFile(file, &header, sizeof(DxtCacheHeader), 1) != 1 ||
+      strncmp(header.identifier, "DXTC", 4) != 0 ||
+      header.version != DXT_CACHE_VERSION) {
+    plCloseFile(file);
+    LogWarn("Invalid texture cache, \"%s\"!\n", path);
+    return NULL;
+  }
+
+  bool same_time = (stamp->mtime != 0 && header.source_mtime == stamp->mtime);
+  bool same_hash = (stamp->has_hash && header.source_hash == stamp->hash);
+  if (header.source_size != stamp->size || !(same_time || same_hash)) {
+    plCloseFile(file);
+    return NULL;
+  }
+
+  if (header.levels == 0 || header.levels > DXT_MAX_LEVELS || header.format > DXT_FORMAT_BC3 ||
+      header.width == 0 || header.height == 0) {
+    plCloseFile(file);
+    LogWarn("Invalid texture cache, \"%s\"!\n", path);
+    return NULL;
+  }
+
+  DxtImage *image = u_alloc(1, sizeof(DxtImage), true);
+  image->width = header.width;
+  image->height = header.height;
+  image->format = (DxtFormat) header.format;
+
+  unsigned int w = image->width, h = image->height;
+  for (unsigned int i = 0; i < header.levels; ++i) {
+    image->sizes[i] = Dxt_GetLevelSize(image->format, w, h);
+    image->data[i] = u_alloc(image->sizes[i], 1, true);
+    image->levels++;
+    if (plReadFile(file, image->data[i], 1, image->sizes[i]) != image->sizes[i]) {
+      plCloseFile(file);
+      Dxt_DestroyImage(image);
+      LogWarn("Failed to read level %u from texture cache, \"%s\"!\n", i, path);
+      return NULL;
+    }
+
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+
+  plCloseFile(file);
+  return image;
+}
+
+bool Dxt_WriteCacheFile(const DxtImage *image, const char *path, const DxtCacheStamp *stamp) {
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    LogWarn("Failed to open, \"%s\"!\n", path);
+    return false;
+  }
+
+  DxtCacheHeader header;
+  memset(&header, 0, sizeof(DxtCacheHeader));
+  memcpy(header.identifier, "DXTC", 4);
+  header.version = DXT_CACHE_VERSION;
+  header.source_size = stamp->size;
+  header.source_hash = stamp->hash;
+  header.source_mtime = stamp->mtime;
+  header.width = (uint16_t) image->width;
+  header.height = (uint16_t) image->height;
+  header.format = (uint8_t) image->format;
+  header.levels = (uint8_t) image->levels;
+
+  bool status = (fwrite(&header, sizeof(DxtCacheHeader), 1, fp) == 1);
+  for (unsigned int i = 0; i < image->levels && status; ++i) {
+    status = (fwrite(image->data[i], 1, image->sizes[i], fp) == image->sizes[i]);
+  }
+
+  u_fclose(fp);
+
+  if (!status) {
+    LogWarn("Failed to write texture cache, \"%s\"!\n", path);
+    plDeleteFile(path);
+  }
+
+  return status;
+}
@@ -0,0 +1,59 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#define DXT_CACHE_VERSION   2
+#define DXT_MAX_LEVELS      16
+
+PL_EXTERN_C
+
+typedef enum DxtFormat {
+  DXT_FORMAT_BC1,   /* rgb, 8 bytes per block */
+  DXT_FORMAT_BC3,   /* rgba, 16 bytes per block */
+} DxtFormat;
+
+typedef struct DxtImage {
+  unsigned int width, height;
+  DxtFormat format;
+
+  unsigned int levels;
+  uint8_t *data[DXT_MAX_LEVELS];
+  unsigned int sizes[DXT_MAX_LEVELS];
+} DxtImage;
+
+/* Identifies the source a cache file was generated from. The size and
+ * modification time are checked first, so the source only needs to be
+ * hashed when those don't match, such as after it's been touched. */
+typedef struct DxtCacheStamp {
+  uint32_t size;
+  int64_t mtime;      /* 0 if unknown */
+  uint32_t hash;
+  bool has_hash;
+} DxtCacheStamp;
+
+unsigned int Dxt_GetLevelSize(DxtFormat format, unsigned int width, unsigned int height);
+void Dxt_GenerateMipLevel(const uint8_t *src, unsigned int width, unsigned int height, uint8_t *dst);
+
+DxtImage *Dxt_CreateImage(const uint8_t *rgba, unsigned int width, unsigned int height, bool generate_mips);
+uint8_t *Dxt_DecodeLevel(const DxtImage *image, unsigned int level);
+void Dxt_DestroyImage(DxtImage *image);
+
+DxtImage *Dxt_LoadCacheFile(const char *path, const DxtCacheStamp *stamp);
+bool Dxt_WriteCacheFile(const DxtImage *image, const char *path, const DxtCacheStamp *stamp);
+
+PL_EXTERN_C_END
@@ -24,67 +24,77 @@
 /************************************************************/
 /* Fac Triangle/Quad Faces Format */
 
-FacHandle *Fac_LoadFile( const char *path ) {
+typedef struct __attribute__((packed)) FacFileTriangle {
+	int8_t uv_coords[6];
+	uint16_t vertex_indices[3];
+	uint16_t normal_indices[3];
+	uint16_t unknown0;
+	uint32_t texture_index;
+	uint16_t unknown1[4];
+} FacFileTriangle;
+
+typedef struct __attribute__((packed)) FacFileQuad {
+	int8_t uv_coords[8];
+	uint16_t vertex_indices[4];
+	uint16_t normal_indices[4];
+	uint32_t texture_index;
+	uint16_t unknown[4];
+} FacFileQuad;
+
+FacHandle *Fac_LoadFile( const char *path, const ULoaderContext *context ) {
 	PLFile *fac_file = plOpenFile( path, false );
 	if ( fac_file == NULL ) {
-		LogWarn( "Failed to load Fac \"%s\", aborting!\n", path );
+		LoaderError( context, "Failed to load Fac \"%s\", aborting!\n", path );
 		return NULL;
 	}
 
-	LogDebug( "Opened Fac \"%s\"...\n", plGetFilePath( fac_file ) );
-
 	/* 16 bytes of unknown data, just skip it for now */
 	plFileSeek( fac_file, 16, PL_SEEK_CUR );
 
 	uint32_t numTriangles;
 	if ( plReadFile( fac_file, &numTriangles, sizeof( uint32_t ), 1 ) != 1 ) {
-		LogWarn( "Failed to get number of triangles, \"%s\"!\n", path );
+		plCloseFile( fac_file );
+		LoaderError( context, "Failed to get number of triangles, \"%s\"!\n", path );
+		return NULL;
 	}
 
 	/* some models can have 0 triangles, as they'll use quads instead */
 	if ( numTriangles >= FAC_MAX_TRIANGLES ) {
 		plCloseFile( fac_file );
-		LogWarn( "Invalid number of triangles in \"%s\" (%d/%d)!\n", path, numTriangles, FAC_MAX_TRIANGLES );
+		LoaderError( context, "Invalid number of triangles in \"%s\" (%d/%d)!\n", path, numTriangles, FAC_MAX_TRIANGLES );
 		return NULL;
 	}
 
-	struct __attribute__((packed)) {
-		int8_t uv_coords[6];
-		uint16_t vertex_indices[3];
-		uint16_t normal_indices[3];
-		uint16_t unknown0;
-		uint32_t texture_index;
-		uint16_t unknown1[4];
-	} triangles[numTriangles];
+	UScratchMark mark = u_scratch_mark();
+
+	FacFileTriangle *triangles = u_scratch_alloc( numTriangles * sizeof( FacFileTriangle ) );
 	if ( plReadFile( fac_file, triangles, sizeof( *triangles ), numTriangles ) != numTriangles ) {
 		plCloseFile( fac_file );
-		LogWarn( "Failed to get %u triangles, \"%s\", aborting!\n", numTriangles, path );
+		u_scratch_release( mark );
+		LoaderError( context, "Failed to get %u triangles, \"%s\", aborting!\n", numTriangles, path );
 		return NULL;
 	}
 
 	uint32_t numQuads;
 	if ( plReadFile( fac_file, &numQuads, sizeof( uint32_t ), 1 ) != 1 ) {
 		plCloseFile( fac_file );
-		LogWarn( "Failed to get number of quads, \"%s\", aborting!\n", path );
+		u_scratch_release( mark );
+		LoaderError( context, "Failed to get number of quads, \"%s\", aborting!\n", path );
 		return NULL;
 	}
 
 	if ( numQuads >= FAC_MAX_TRIANGLES ) {
 		plCloseFile( fac_file );
-		LogWarn( "Invalid number of quads in \"%s\" (%d/%d)!\n", path, numQuads, FAC_MAX_TRIANGLES );
+		u_scratch_release( mark );
+		LoaderError( context, "Invalid number of quads in \"%s\" (%d/%d)!\n", path, numQuads, FAC_MAX_TRIANGLES );
 		return NULL;
 	}
 
-	struct __attribute__((packed)) {
-		int8_t uv_coords[8];
-		uint16_t vertex_indices[4];
-		uint16_t normal_indices[4];
-		uint32_t texture_index;
-		uint16_t unknown[4];
-	} quads[numQuads];
+	FacFileQuad *quads = u_scratch_alloc( numQuads * sizeof( FacFileQuad ) );
 	if ( plReadFile( fac_file, quads, sizeof( *quads ), numQuads ) != numQuads ) {
 		plCloseFile( fac_file );
-		LogWarn( "Failed to get %u quads, \"%s\", aborting!\n", numQuads, path );
+		u_scratch_release( mark );
+		LoaderError( context, "Failed to get %u quads, \"%s\", aborting!\n", numQuads, path );
 		return NULL;
 	}
 
@@ -92,7 +102,14 @@ FacHandle *Fac_LoadFile( const char *path ) {
 	uint8_t num_textures;
 	FacTextureIndex *texture_table = NULL;
 	if ( plReadFile( fac_file, &num_textures, sizeof( uint8_t ), 1 ) == 1 && num_textures > 0 ) {
-		texture_table = u_alloc( num_textures, sizeof( FacTextureIndex ), true );
+		texture_table = u_loader_alloc( context, num_textures, sizeof( FacTextureIndex ) );
+		if ( texture_table == NULL ) {
+			plCloseFile( fac_file );
+			u_scratch_release( mark );
+			LoaderError( context, "Failed to allocate texture table for \"%s\"!\n", path );
+			return NULL;
+		}
+
 		for ( unsigned int i = 0; i < num_textures; ++i ) {
 			plReadFile( fac_file, texture_table[ i ].name, 1, sizeof( texture_table[ i ].name ) );
 		}
@@ -102,13 +119,25 @@ FacHandle *Fac_LoadFile( const char *path ) {
 
 	unsigned int totalTriangles = numTriangles + ( numQuads * 2 );
 	if ( totalTriangles == 0 || totalTriangles >= FAC_MAX_TRIANGLES ) {
-		LogWarn( "Invalid number of triangles in \"%s\" (%d/%d)!\n", path, numTriangles, FAC_MAX_TRIANGLES );
+		u_scratch_release( mark );
+		u_loader_free( context, texture_table );
+		LoaderError( context, "Invalid number of triangles in \"%s\" (%d/%d)!\n", path, numTriangles, FAC_MAX_TRIANGLES );
+		return NULL;
+	}
+
+	FacHandle *handle = u_loader_alloc( context, 1, sizeof( FacHandle ) );
+	FacTriangle *out = u_loader_alloc( context, totalTriangles, sizeof( FacTriangle ) );
+	if ( handle == NULL || out == NULL ) {
+		u_scratch_release( mark );
+		u_loader_free( context, handle );
+		u_loader_free( context, out );
+		u_loader_free( context, texture_table );
+		LoaderError( context, "Failed to allocate %u triangles for \"%s\"!\n", totalTriangles, path );
 		return NULL;
 	}
 
-	FacHandle *handle = u_alloc( 1, sizeof( FacHandle ), true );
 	handle->num_triangles = totalTriangles;
-	handle->triangles = u_alloc( totalTriangles, sizeof( FacTriangle ), true );
+	handle->triangles = out;
 
 	for ( unsigned int i = 0; i < numTriangles; ++i ) {
 		handle->triangles[ i ].texture_index = triangles[ i ].texture_index;
@@ -177,6 +206,8 @@ FacHandle *Fac_LoadFile( const char *path ) {
 #endif
 	}
 
+	u_scratch_release( mark );
+
 	if ( texture_table != NULL ) {
 		handle->texture_table = texture_table;
 		handle->texture_table_size = num_textures;
@@ -199,14 +230,8 @@ void Fac_WriteFile( FacHandle *handle, const char *path ) {
 
 	// write out the triangle data
 	fwrite( &handle->num_triangles, sizeof( uint32_t ), 1, fp );
-	struct __attribute__((packed)) {
-		int8_t uv_coords[6];
-		uint16_t vertex_indices[3];
-		uint16_t normal_indices[3];
-		uint16_t unknown0;
-		uint32_t texture_index;
-		uint16_t unknown1[4];
-	} triangles[handle->num_triangles];
+	UScratchMark mark = u_scratch_mark();
+	FacFileTriangle *triangles = u_scratch_alloc( handle->num_triangles * sizeof( FacFileTriangle ) );
 	memset( triangles, 0, sizeof( *triangles ) * handle->num_triangles );
 	for ( unsigned int i = 0; i < handle->num_triangles; ++i ) {
 		triangles[ i ].texture_index = handle->triangles[ i ].texture_index;
@@ -219,6 +244,7 @@ void Fac_WriteFile( FacHandle *handle, const char *path ) {
 		}
 	}
 	fwrite( triangles, sizeof( *triangles ), handle->num_triangles, fp );
+	u_scratch_release( mark );
 
 	// we won't write any quads, so just mark it as 0
 	uint32_t quads = 0;
@@ -236,12 +262,12 @@ void Fac_WriteFile( FacHandle *handle, const char *path ) {
 	u_fclose( fp );
 }
 
-void Fac_DestroyHandle( FacHandle *handle ) {
+void Fac_DestroyHandle( FacHandle *handle, const ULoaderContext *context ) {
 	if ( handle == NULL ) {
 		return;
 	}
 
-	u_free( handle->triangles );
-	u_free( handle->texture_table );
-	u_free( handle );
+	u_loader_free( context, handle->triangles );
+	u_loader_free( context, handle->texture_table );
+	u_loader_free( context, handle );
 }
@@ -40,8 +40,9 @@ typedef struct FacHandle {
   unsigned int texture_table_size;
 } FacHandle;
 
-FacHandle *Fac_LoadFile(const char *path);
+/* Reentrant, context may be NULL for the defaults */
+FacHandle *Fac_LoadFile(const char *path, const ULoaderContext *context);
 void Fac_WriteFile(FacHandle *handle, const char *path);
-void Fac_DestroyHandle(FacHandle *handle);
+void Fac_DestroyHandle(FacHandle *handle, const ULoaderContext *context);
 
 PL_EXTERN_C_END
@@ -0,0 +1,482 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+
+#include <PL/platform_filesystem.h>
+
+#include "util.h"
+#include "maf.h"
+
+/************************************************************/
+/* Machinor Archive Format */
+
+#define MAF_MAX_SEED_ATTEMPTS   ( 1 << 20 )
+#define MAF_COPY_SIZE           ( 64 * 1024 )
+
+static uint64_t Maf_Align(uint64_t size) {
+  return (size + (MAF_ALIGNMENT - 1)) & ~((uint64_t) MAF_ALIGNMENT - 1);
+}
+
+static const char *Maf_SkipPrefix(const char *name) {
+  for (;;) {
+    if (name[0] == '.' && (name[1] == '/' || name[1] == '\\')) {
+      name += 2;
+    } else if (name[0] == '/' || name[0] == '\\') {
+      name++;
+    } else {
+      return name;
+    }
+  }
+}
+
+static char Maf_NormalizeChar(char c) {
+  return (c == '\\') ? '/' : (char) tolower((unsigned char) c);
+}
+
+/**
+ * Hashes the name as it would be stored, so lookups don't
+ * need to normalise it into a buffer first.
+ */
+uint32_t Maf_HashName(const char *name, uint32_t seed) {
+  uint32_t hash = seed;
+  for (const char *p = Maf_SkipPrefix(name); *p != '\0'; ++p) {
+    hash ^= (uint8_t) Maf_NormalizeChar(*p);
+    hash *= 16777619u;
+  }
+
+  /* FNV doesn't mix the low bits well enough on its own, and that's all the slot uses */
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+static uint32_t Maf_GetSeed(unsigned int attempt) {
+  return U_HASH_SEED ^ (attempt * 0x9e3779b9u);
+}
+
+static bool Maf_CompareName(const char *stored, const char *name) {
+  const char *p = Maf_SkipPrefix(name);
+  for (; *stored != '\0' && *p != '\0'; ++stored, ++p) {
+    if (*stored != Maf_NormalizeChar(*p)) {
+      return false;
+    }
+  }
+  return (*stored == '\0' && *p == '\0');
+}
+
+/************************************************************/
+/* Reading */
+
+/**
+ * Validates the archive's layout and sets up the given archive
+ * to point into the data, which must outlive it.
+ */
+bool Maf_OpenMemory(MafArchive *archive, const void *data, size_t size) {
+  memset(archive, 0, sizeof(MafArchive));
+
+  const MafHeader *header = data;
+  if (size < sizeof(MafHeader) ||
+      strncmp(header->ident, MAF_IDENTIFIER, 3) != 0 ||
+      header->version != MAF_VERSION) {
+    return false;
+  }
+
+  if (header->num_buckets == 0 || header->num_slots == 0 ||
+      (header->num_slots & (header->num_slots - 1)) != 0 ||
+      header->num_slots < header->num_entries ||
+      header->names_size == 0) {
+    return false;
+  }
+
+  if (header->entries_offset + (uint64_t) header->num_entries * sizeof(MafEntry) > size ||
+      header->buckets_offset + (uint64_t) header->num_buckets * sizeof(uint32_t) > size ||
+      header->slots_offset + (uint64_t) header->num_slots * sizeof(uint32_t) > size ||
+      header->names_offset + header->names_size > size) {
+    return false;
+  }
+
+  const uint8_t *bytes = data;
+  archive->data = bytes;
+  archive->size = size;
+  archive->entries = (const MafEntry *) (bytes + header->entries_offset);
+  archive->num_entries = header->num_entries;
+  archive->bucket_seeds = (const uint32_t *) (bytes + header->buckets_offset);
+  archive->num_buckets = header->num_buckets;
+  archive->slots = (const uint32_t *) (bytes + header->slots_offset);
+  archive->num_slots = header->num_slots;
+  archive->names = (const char *) (bytes + header->names_offset);
+
+  if (archive->names[header->names_size - 1] != '\0') {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < archive->num_entries; ++i) {
+    const MafEntry *entry = &archive->entries[i];
+    if (entry->offset + entry->size > size || entry->name_offset >= header->names_size) {
+      return false;
+    }
+  }
+
+  for (unsigned int i = 0; i < archive->num_slots; ++i) {
+    if (archive->slots[i] != MAF_EMPTY_SLOT && archive->slots[i] >= archive->num_entries) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Returns the entry for the given name, or NULL if the archive
+ * doesn't contain it. Case and leading slashes are ignored.
+ */
+const MafEntry *Maf_FindEntry(const MafArchive *archive, const char *name) {
+  if (archive->num_entries == 0) {
+    return NULL;
+  }
+
+  uint32_t bucket = Maf_HashName(name, U_HASH_SEED) % archive->num_buckets;
+  uint32_t slot = Maf_HashName(name, archive->bucket_seeds[bucket]) & (archive->num_slots - 1);
+  uint32_t index = archive->slots[slot];
+  if (index == MAF_EMPTY_SLOT) {
+    return NULL;
+  }
+
+  const MafEntry *entry = &archive->entries[index];
+  if (!Maf_CompareName(archive->names + entry->name_offset, name)) {
+    return NULL;
+  }
+
+  return entry;
+}
+
+const char *Maf_GetEntryName(const MafArchive *archive, const MafEntry *entry) {
+  return archive->names + entry->name_offset;
+}
+
+const void *Maf_GetEntryData(const MafArchive *archive, const MafEntry *entry) {
+  return archive->data + entry->offset;
+}
+
+/************************************************************/
+/* Writing */
+
+typedef struct MafWriterEntry {
+  char *name;
+  char *source_path;
+  unsigned int order;
+} MafWriterEntry;
+
+struct MafWriter {
+  MafWriterEntry *entries;
+  unsigned int num_entries;
+  unsigned int max_entries;
+};
+
+MafWriter *Maf_CreateWriter(void) {
+  return u_alloc(1, sizeof(MafWriter), true);
+}
+
+void Maf_DestroyWriter(MafWriter *writer) {
+  if (writer == NULL) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < writer->num_entries; ++i) {
+    u_free(writer->entries[i].name);
+    u_free(writer->entries[i].source_path);
+  }
+  u_free(writer->entries);
+  u_free(writer);
+}
+
+/**
+ * Queues up the given file to be written into the archive under
+ * the given name. Nothing is read until Maf_WriteFile.
+ */
+void Maf_AddFile(MafWriter *writer, const char *name, const char *source_path) {
+  if (writer->num_entries == writer->max_entries) {
+    writer->max_entries = (writer->max_entries == 0) ? 1024 : writer->max_entries * 2;
+    writer->entries = u_realloc(writer->entries, writer->max_entries * sizeof(MafWriterEntry), true);
+  }
+
+  const char *p = Maf_SkipPrefix(name);
+  MafWriterEntry *entry = &writer->entries[writer->num_entries];
+  entry->name = u_alloc(strlen(p) + 1, 1, true);
+  for (size_t i = 0; p[i] != '\0'; ++i) {
+    entry->name[i] = Maf_NormalizeChar(p[i]);
+  }
+  entry->source_path = u_alloc(strlen(source_path) + 1, 1, true);
+  strcpy(entry->source_path, source_path);
+  entry->order = writer->num_entries++;
+}
+
+static int Maf_CompareEntries(const void *a, const void *b) {
+  const MafWriterEntry *ea = a, *eb = b;
+  int result = strcmp(ea->name, eb->name);
+  if (result != 0) {
+    return result;
+  }
+  return (ea->order < eb->order) ? -1 : 1;
+}
+
+/* Sorts the entries by name, and drops any duplicates. The last added wins */
+static void Maf_SortEntries(MafWriter *writer) {
+  qsort(writer->entries, writer->num_entries, sizeof(MafWriterEntry), Maf_CompareEntries);
+
+  unsigned int num_entries = 0;
+  for (unsigned int i = 0; i < writer->num_entries; ++i) {
+    if (i + 1 < writer->num_entries && strcmp(writer->entries[i].name, writer->entries[i + 1].name) == 0) {
+      LogWarn("Duplicate entry \"%s\" in archive, skipping \"%s\"!\n",
+              writer->entries[i].name, writer->entries[i].source_path);
+      u_free(writer->entries[i].name);
+      u_free(writer->entries[i].source_path);
+      continue;
+    }
+
+    writer->entries[num_entries++] = writer->entries[i];
+  }
+  writer->num_entries = num_entries;
+}
+
+/**
+ * Picks a seed for each bucket such that every name lands in
+ * a slot of its own. Buckets are placed largest first, since
+ * they're the hardest to fit once the table starts filling up.
+ */
+static bool Maf_BuildDirectory(const MafWriter *writer, uint32_t *bucket_seeds, unsigned int num_buckets,
+                               uint32_t *slots, unsigned int num_slots) {
+  unsigned int n = writer->num_entries;
+  uint32_t *bucket_of = u_alloc(n, sizeof(uint32_t), true);
+  unsigned int *bucket_start = u_alloc(num_buckets + 1, sizeof(unsigned int), true);
+  unsigned int *bucket_entries = u_alloc(n, sizeof(unsigned int), true);
+  unsigned int *bucket_order = u_alloc(num_buckets, sizeof(unsigned int), true);
+  unsigned int *candidate = u_alloc(n, sizeof(unsigned int), true);
+
+  for (unsigned int i = 0; i < n; ++i) {
+    bucket_of[i] = Maf_HashName(writer->entries[i].name, U_HASH_SEED) % num_buckets;
+    bucket_start[bucket_of[i] + 1]++;
+  }
+  for (unsigned int i = 0; i < num_buckets; ++i) {
+    bucket_start[i + 1] += bucket_start[i];
+    bucket_order[i] = i;
+  }
+  {
+    unsigned int *fill = u_alloc(num_buckets, sizeof(unsigned int), true);
+    for (unsigned int i = 0; i < n; ++i) {
+      bucket_entries[bucket_start[bucket_of[i]] + fill[bucket_of[i]]++] = i;
+    }
+    u_free(fill);
+  }
+
+  /* simple insertion by size is plenty, most buckets hold a handful of names */
+  for (unsigned int i = 1; i < num_buckets; ++i) {
+    unsigned int b = bucket_order[i];
+    unsigned int size = bucket_start[b + 1] - bucket_start[b];
+    unsigned int j = i;
+    for (; j > 0; --j) {
+      unsigned int prev = bucket_order[j - 1];
+      if (bucket_start[prev + 1] - bucket_start[prev] >= size) {
+        break;
+      }
+      bucket_order[j] = prev;
+    }
+    bucket_order[j] = b;
+  }
+
+  for (unsigned int i = 0; i < num_slots; ++i) {
+    slots[i] = MAF_EMPTY_SLOT;
+  }
+
+  bool status = true;
+  for (unsigned int i = 0; i < num_buckets && status; ++i) {
+    unsigned int b = bucket_order[i];
+    unsigned int first = bucket_start[b], count = bucket_start[b + 1] - first;
+    bucket_seeds[b] = Maf_GetSeed(0);
+    if (count == 0) {
+      continue;
+    }
+
+    unsigned int attempt;
+    for (attempt = 1; attempt < MAF_MAX_SEED_ATTEMPTS; ++attempt) {
+      uint32_t seed = Maf_GetSeed(attempt);
+      unsigned int j;
+      for (j = 0; j < count; ++j) {
+        candidate[j] = Maf_HashName(writer->entries[bucket_entries[first + j]].name, seed) & (num_slots - 1);
+        if (slots[candidate[j]] != MAF_EMPTY_SLOT) {
+          break;
+        }
+
+        /* and make sure the bucket doesn't collide with itself */
+        unsigned int k;
+        for (k = 0; k < j && candidate[k] != candidate[j]; ++k) {}
+        if (k < j) {
+          break;
+        }
+      }
+
+      if (j == count) {
+        bucket_seeds[b] = seed;
+        for (j = 0; j < count; ++j) {
+          slots[candidate[j]] = bucket_entries[first + j];
+        }
+        break;
+      }
+    }
+
+    if (attempt == MAF_MAX_SEED_ATTEMPTS) {
+      LogWarn("Failed to find a seed for bucket %u!\n", b);
+      status = false;
+    }
+  }
+
+  u_free(candidate);
+  u_free(bucket_order);
+  u_free(bucket_entries);
+  u_free(bucket_start);
+  u_free(bucket_of);
+  return status;
+}
+
+static bool Maf_WritePadding(FILE *fp, uint64_t *offset) {
+  static const uint8_t padding[MAF_ALIGNMENT] = {0};
+  size_t pad = (size_t) (Maf_Align(*offset) - *offset);
+  *offset += pad;
+  return (pad == 0 || fwrite(padding, 1, pad, fp) == pad);
+}
+
+static bool Maf_WriteEntryData(FILE *fp, const char *source_path, uint8_t *buf, uint64_t *size) {
+  FILE *in = fopen(source_path, "rb");
+  if (in == NULL) {
+    LogWarn("Failed to open \"%s\" for archiving!\n", source_path);
+    return false;
+  }
+
+  *size = 0;
+  size_t length;
+  bool status = true;
+  while (status && (length = fread(buf, 1, MAF_COPY_SIZE, in)) > 0) {
+    status = (fwrite(buf, 1, length, fp) == length);
+    *size += length;
+  }
+
+  u_fclose(in);
+  return status;
+}
+
+/**
+ * Writes everything that's been added out to a new archive.
+ * Data is laid out in name order, so files from the same
+ * directory end up next to each other.
+ */
+bool Maf_WriteFile(MafWriter *writer, const char *path) {
+  Maf_SortEntries(writer);
+
+  unsigned int n = writer->num_entries;
+  unsigned int num_buckets = (n + 3) / 4;
+  if (num_buckets == 0) {
+    num_buckets = 1;
+  }
+  /* keep the table at most 80% full, so seeds are quick to find */
+  unsigned int num_slots = 1;
+  while (num_slots < n + n / 4) {
+    num_slots <<= 1;
+  }
+
+  uint32_t *bucket_seeds = u_alloc(num_buckets, sizeof(uint32_t), true);
+  uint32_t *slots = u_alloc(num_slots, sizeof(uint32_t), true);
+  if (!Maf_BuildDirectory(writer, bucket_seeds, num_buckets, slots, num_slots)) {
+    u_free(bucket_seeds);
+    u_free(slots);
+    return false;
+  }
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    LogWarn("Failed to open, \"%s\"!\n", path);
+    u_free(bucket_seeds);
+    u_free(slots);
+    return false;
+  }
+
+  MafHeader header;
+  memset(&header, 0, sizeof(MafHeader));
+  uint64_t offset = sizeof(MafHeader);
+  bool status = (fwrite(&header, sizeof(MafHeader), 1, fp) == 1);
+
+  MafEntry *entries = u_alloc(n > 0 ? n : 1, sizeof(MafEntry), true);
+  uint32_t names_size = 0;
+  UScratchMark mark = u_scratch_mark();
+  uint8_t *buf = u_scratch_alloc(MAF_COPY_SIZE);
+  for (unsigned int i = 0; i < n && status; ++i) {
+    status = Maf_WritePadding(fp, &offset);
+    entries[i].offset = offset;
+    entries[i].name_offset = names_size;
+    names_size += (uint32_t) strlen(writer->entries[i].name) + 1;
+    uint64_t size = 0;
+    status = status && Maf_WriteEntryData(fp, writer->entries[i].source_path, buf, &size);
+    entries[i].size = size;
+    offset += size;
+  }
+  u_scratch_release(mark);
+
+  memcpy(header.ident, MAF_IDENTIFIER, 3);
+  header.version = MAF_VERSION;
+  header.num_entries = n;
+  header.num_buckets = num_buckets;
+  header.num_slots = num_slots;
+  header.names_size = names_size + 1;
+
+  status = status && Maf_WritePadding(fp, &offset);
+  header.entries_offset = offset;
+  status = status && (n == 0 || fwrite(entries, sizeof(MafEntry), n, fp) == n);
+  offset += (uint64_t) n * sizeof(MafEntry);
+
+  header.buckets_offset = offset;
+  status = status && fwrite(bucket_seeds, sizeof(uint32_t), num_buckets, fp) == num_buckets;
+  offset += (uint64_t) num_buckets * sizeof(uint32_t);
+
+  header.slots_offset = offset;
+  status = status && fwrite(slots, sizeof(uint32_t), num_slots, fp) == num_slots;
+  offset += (uint64_t) num_slots * sizeof(uint32_t);
+
+  header.names_offset = offset;
+  for (unsigned int i = 0; i < n && status; ++i) {
+    const char *name = writer->entries[i].name;
+    status = (fwrite(name, 1, strlen(name) + 1, fp) == strlen(name) + 1);
+  }
+  /* terminator, so the table is never empty */
+  status = status && fputc('\0', fp) != EOF;
+
+  status = status && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(MafHeader), 1, fp) == 1;
+
+  u_fclose(fp);
+  u_free(entries);
+  u_free(bucket_seeds);
+  u_free(slots);
+
+  if (!status) {
+    LogWarn("Failed to write archive, \"%s\"!\n", path);
+    plDeleteFile(path);
+  }
+
+  return status;
+}
@@ -0,0 +1,109 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Machinor Archive Format
+ *
+ * An entire mod packed into a single file, so it can be
+ * mapped into memory and read from without going back to
+ * the disk for every lookup.
+ *
+ * MafHeader
+ * File data, each aligned to 16 bytes, in the same order as the entries
+ * MafEntry entries[num_entries], sorted by name
+ * uint32_t bucket_seeds[num_buckets]
+ * uint32_t slots[num_slots]
+ * char names[names_size]
+ *
+ * Names are stored lowercase, with forward slashes and relative
+ * to the root of the mod. A lookup hashes the name to pick a
+ * bucket, then hashes it again with that bucket's seed to get
+ * its slot. The writer picks seeds so that no two names share
+ * a slot, so finding an entry never needs to probe.
+ */
+
+#define MAF_IDENTIFIER  "MAF"
+#define MAF_VERSION     1
+#define MAF_EXTENSION   "maf"
+
+#define MAF_ALIGNMENT   16
+#define MAF_EMPTY_SLOT  UINT32_MAX
+
+PL_EXTERN_C
+
+typedef struct __attribute__((packed)) MafHeader {
+  char ident[3];
+  uint8_t version;
+  uint32_t num_entries;
+  uint32_t num_buckets;
+  uint32_t num_slots;       /* always a power of two */
+  uint64_t entries_offset;
+  uint64_t buckets_offset;
+  uint64_t slots_offset;
+  uint64_t names_offset;
+  uint32_t names_size;
+  uint32_t padding;
+} MafHeader;
+
+typedef struct __attribute__((packed)) MafEntry {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t name_offset;     /* into the names table, null terminated */
+  uint32_t padding;
+} MafEntry;
+
+uint32_t Maf_HashName(const char *name, uint32_t seed);
+
+/************************************************************/
+/* Reading */
+
+/* Points straight into the archive's data */
+typedef struct MafArchive {
+  const uint8_t *data;
+  size_t size;
+
+  const MafEntry *entries;
+  unsigned int num_entries;
+
+  const uint32_t *bucket_seeds;
+  unsigned int num_buckets;
+
+  const uint32_t *slots;
+  unsigned int num_slots;
+
+  const char *names;
+} MafArchive;
+
+bool Maf_OpenMemory(MafArchive *archive, const void *data, size_t size);
+
+const MafEntry *Maf_FindEntry(const MafArchive *archive, const char *name);
+const char *Maf_GetEntryName(const MafArchive *archive, const MafEntry *entry);
+const void *Maf_GetEntryData(const MafArchive *archive, const MafEntry *entry);
+
+/************************************************************/
+/* Writing */
+
+typedef struct MafWriter MafWriter;
+
+MafWriter *Maf_CreateWriter(void);
+void Maf_DestroyWriter(MafWriter *writer);
+
+void Maf_AddFile(MafWriter *writer, const char *name, const char *source_path);
+bool Maf_WriteFile(MafWriter *writer, const char *path);
+
+PL_EXTERN_C_END
@@ -23,6 +23,22 @@
 /************************************************************/
 /* PSX Min Model Format */
 
+#define MIN_HEADER_SIZE 16
+
+static bool Min_ReadUInt32(const MinHandle *handle, size_t offset, uint32_t *out) {
+  if (offset + sizeof(uint32_t) > handle->size) {
+    return false;
+  }
+
+  memcpy(out, handle->data + offset, sizeof(uint32_t));
+  return true;
+}
+
+/**
+ * @brief Loads the given Min into memory and validates it, without copying out the faces or vertices
+ * @param path Path to the Min file
+ * @return Returns a new handle on success, null on fail
+ */
 MinHandle *Min_LoadFile(const char *path) {
   PLFile *fp = plOpenFile(path, false);
   if (fp == NULL) {
@@ -30,37 +46,83 @@ MinHandle *Min_LoadFile(const char *path) {
     return NULL;
   }
 
-  plFileSeek(fp, 16, PL_SEEK_CUR);
+  MinHandle *handle = u_alloc(1, sizeof(MinHandle), true);
+  handle->size = plGetFileSize(fp);
+  handle->data = u_alloc(handle->size + 1, 1, true);
+  size_t rsize = plReadFile(fp, handle->data, 1, handle->size);
+  plCloseFile(fp);
+  if (rsize != handle->size) {
+    LogWarn("Failed to read Min \"%s\", aborting!\n", path);
+    Min_DestroyHandle(handle);
+    return NULL;
+  }
 
-  uint32_t num_triangles;
-  if (plReadFile(fp, &num_triangles, sizeof(uint32_t), 1) != 1) {
+  size_t offset = MIN_HEADER_SIZE;
+  uint32_t num_faces;
+  if (!Min_ReadUInt32(handle, offset, &num_faces)) {
     LogWarn("Failed to get number of triangles, \"%s\"!\n", path);
+    Min_DestroyHandle(handle);
+    return NULL;
+  }
+  offset += sizeof(uint32_t);
+
+  if (num_faces == 0 || num_faces >= FAC_MAX_TRIANGLES ||
+      offset + (size_t) num_faces * sizeof(MinFace) > handle->size) {
+    LogWarn("Invalid number of triangles in \"%s\" (%u/%d)!\n", path, num_faces, FAC_MAX_TRIANGLES);
+    Min_DestroyHandle(handle);
+    return NULL;
   }
 
-  if (num_triangles == 0 || num_triangles >= FAC_MAX_TRIANGLES) {
-    plCloseFile(fp);
-    LogWarn("Invalid number of triangles in \"%s\" (%d/%d)!\n", path, num_triangles, FAC_MAX_TRIANGLES);
+  handle->faces = (const MinFace *) (handle->data + offset);
+  handle->num_faces = num_faces;
+  offset += num_faces * sizeof(MinFace);
+
+  /* followed by an unknown 32-bit value */
+  offset += sizeof(int32_t);
+
+  uint32_t num_vertices;
+  if (!Min_ReadUInt32(handle, offset, &num_vertices)) {
+    LogWarn("Failed to get number of vertices, \"%s\"!\n", path);
+    Min_DestroyHandle(handle);
     return NULL;
   }
+  offset += sizeof(uint32_t);
 
-  struct __attribute__((packed)) {
-#if 0
-    int8_t      uv_coords[6];
-    uint16_t    vertex_indices[3];
-    uint16_t    normal_indices[3];
-    uint16_t    unknown0;
-    uint32_t    texture_index;
-    uint16_t    unknown1[4];
-#else
-    char u0[24];
-#endif
-  } triangles[num_triangles];
-  static_assert(sizeof(*triangles) == 24, "invalid struct size");
-  if (plReadFile(fp, triangles, sizeof(*triangles), num_triangles) != num_triangles) {
-    plCloseFile(fp);
-    LogWarn("Failed to get %u triangles, \"%s\", aborting!\n", num_triangles, path);
+  if (num_vertices == 0 || num_vertices >= VTX_MAX_VERTICES ||
+      offset + (size_t) num_vertices * sizeof(MinVertex) > handle->size) {
+    LogWarn("Invalid number of vertices in \"%s\" (%u/%d)!\n", path, num_vertices, VTX_MAX_VERTICES);
+    Min_DestroyHandle(handle);
     return NULL;
   }
-  // todo
-  return NULL;
+
+  handle->vertices = (const MinVertex *) (handle->data + offset);
+  handle->num_vertices = num_vertices;
+  offset += num_vertices * sizeof(MinVertex);
+
+  if (offset != handle->size) {
+    LogDebug("Unexpected %u bytes at the end of \"%s\"\n", (unsigned int) (handle->size - offset), path);
+  }
+
+  /* the layout of each face is still a guess, so make sure it's sane */
+  for (unsigned int i = 0; i < handle->num_faces; ++i) {
+    for (unsigned int j = 0; j < 3; ++j) {
+      if (handle->faces[i].vertex_indices[j] >= handle->num_vertices) {
+        LogWarn("Invalid vertex index in \"%s\" (%u/%u)!\n",
+                path, handle->faces[i].vertex_indices[j], handle->num_vertices);
+        Min_DestroyHandle(handle);
+        return NULL;
+      }
+    }
+  }
+
+  return handle;
+}
+
+void Min_DestroyHandle(MinHandle *handle) {
+  if (handle == NULL) {
+    return;
+  }
+
+  u_free(handle->data);
+  u_free(handle);
 }
@@ -0,0 +1,229 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <PL/platform_filesystem.h>
+
+#include "util.h"
+#include "mmf.h"
+
+/************************************************************/
+/* Machinor Model Format */
+
+static size_t Mmf_Align(size_t size) {
+  return (size + (MMF_CHUNK_ALIGNMENT - 1)) & ~((size_t) MMF_CHUNK_ALIGNMENT - 1);
+}
+
+static const void *Mmf_GetChunk(const MmfHandle *handle, uint64_t offset, const char *ident, size_t element_size,
+                                unsigned int *count) {
+  if (offset + sizeof(MmfChunkHeader) > handle->file.size || (offset % MMF_CHUNK_ALIGNMENT) != 0) {
+    return NULL;
+  }
+
+  const MmfChunkHeader *chunk = (const MmfChunkHeader *) ((const uint8_t *) handle->file.data + offset);
+  if (strncmp(chunk->ident, ident, 3) != 0) {
+    return NULL;
+  }
+
+  if (offset + sizeof(MmfChunkHeader) + chunk->length > handle->file.size ||
+      (uint64_t) chunk->count * element_size > chunk->length) {
+    return NULL;
+  }
+
+  *count = chunk->count;
+  return chunk + 1;
+}
+
+/**
+ * Opens the given cooked model, returns NULL if it doesn't
+ * exist, is invalid or was cooked from different source files.
+ * The sources match if their size and either their modification
+ * times or, when provided, their hash are the same.
+ */
+MmfHandle *Mmf_OpenFile(const char *path, const MmfSourceStamp *stamp) {
+  MmfHandle *handle = u_alloc(1, sizeof(MmfHandle), true);
+  if (!u_map_file(path, &handle->file)) {
+    u_free(handle);
+    return NULL;
+  }
+
+  const MmfHeader *header = handle->file.data;
+  if (handle->file.size < sizeof(MmfHeader) ||
+      strncmp(header->ident, MMF_IDENTIFIER, 3) != 0 ||
+      header->version != MMF_VERSION ||
+      sizeof(MmfHeader) + header->num_chunks * sizeof(uint64_t) > handle->file.size) {
+    Mmf_CloseFile(handle);
+    return NULL;
+  }
+
+  bool same_time = (stamp->time != 0 && header->source_time == stamp->time);
+  bool same_hash = (stamp->has_hash && header->source_hash == stamp->hash);
+  if (header->source_size != stamp->size || !(same_time || same_hash)) {
+    Mmf_CloseFile(handle);
+    return NULL;
+  }
+
+  const uint64_t *offsets = (const uint64_t *) (header + 1);
+  const void *bounds = NULL;
+  for (unsigned int i = 0; i < header->num_chunks; ++i) {
+    const void *chunk;
+    unsigned int count;
+    if ((chunk = Mmf_GetChunk(handle, offsets[i], MMF_VERTICES_IDENTIFIER, sizeof(MmfVertex), &count)) != NULL) {
+      handle->model.vertices = chunk;
+      handle->model.num_vertices = count;
+    } else if ((chunk = Mmf_GetChunk(handle, offsets[i], MMF_INDICES_IDENTIFIER, sizeof(uint32_t), &count)) != NULL) {
+      handle->model.indices = chunk;
+      handle->model.num_indices = count;
+    } else if ((chunk = Mmf_GetChunk(handle, offsets[i], MMF_TEXTURES_IDENTIFIER, sizeof(MmfTexture), &count)) != NULL) {
+      handle->model.textures = chunk;
+      handle->model.num_textures = count;
+    } else if ((chunk = Mmf_GetChunk(handle, offsets[i], MMF_BOUNDS_IDENTIFIER, sizeof(MmfBounds), &count)) != NULL
+               && count == 1) {
+      bounds = chunk;
+    } else {
+      LogWarn("Unknown or invalid chunk in \"%s\" (%u)!\n", path, i);
+      Mmf_CloseFile(handle);
+      return NULL;
+    }
+  }
+
+  if (handle->model.vertices == NULL || handle->model.indices == NULL ||
+      handle->model.num_indices == 0 || (handle->model.num_indices % 3) != 0) {
+    LogWarn("Missing vertices or indices in \"%s\"!\n", path);
+    Mmf_CloseFile(handle);
+    return NULL;
+  }
+
+  for (unsigned int i = 0; i < handle->model.num_indices; ++i) {
+    if (handle->model.indices[i] >= handle->model.num_vertices) {
+      LogWarn("Invalid index in \"%s\" (%u/%u)!\n", path, handle->model.indices[i], handle->model.num_vertices);
+      Mmf_CloseFile(handle);
+      return NULL;
+    }
+  }
+
+  if (bounds != NULL) {
+    memcpy(&handle->model.bounds, bounds, sizeof(MmfBounds));
+  }
+
+  return handle;
+}
+
+void Mmf_CloseFile(MmfHandle *handle) {
+  if (handle == NULL) {
+    return;
+  }
+
+  u_unmap_file(&handle->file);
+  u_free(handle);
+}
+
+static bool Mmf_WriteChunk(FILE *fp, const char *ident, const void *data, size_t element_size, unsigned int count) {
+  MmfChunkHeader chunk;
+  memset(&chunk, 0, sizeof(MmfChunkHeader));
+  memcpy(chunk.ident, ident, 3);
+  chunk.length = (uint32_t) Mmf_Align(element_size * count);
+  chunk.count = count;
+  if (fwrite(&chunk, sizeof(MmfChunkHeader), 1, fp) != 1) {
+    return false;
+  }
+
+  if (count > 0 && fwrite(data, element_size, count, fp) != count) {
+    return false;
+  }
+
+  static const uint8_t padding[MMF_CHUNK_ALIGNMENT] = {0};
+  size_t pad = chunk.length - element_size * count;
+  return (pad == 0 || fwrite(padding, 1, pad, fp) == pad);
+}
+
+bool Mmf_WriteFile(const MmfModel *model, const char *path, const MmfSourceStamp *stamp) {
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    LogWarn("Failed to open, \"%s\"!\n", path);
+    return false;
+  }
+
+  struct {
+    const char *ident;
+    const void *data;
+    size_t element_size;
+    unsigned int count;
+  } chunks[] = {
+      {MMF_VERTICES_IDENTIFIER, model->vertices, sizeof(MmfVertex), model->num_vertices},
+      {MMF_INDICES_IDENTIFIER, model->indices, sizeof(uint32_t), model->num_indices},
+      {MMF_TEXTURES_IDENTIFIER, model->textures, sizeof(MmfTexture), model->num_textures},
+      {MMF_BOUNDS_IDENTIFIER, &model->bounds, sizeof(MmfBounds), 1},
+  };
+
+  MmfHeader header;
+  memcpy(header.ident, MMF_IDENTIFIER, 3);
+  header.version = MMF_VERSION;
+  header.num_chunks = plArrayElements(chunks);
+  header.source_size = stamp->size;
+  header.source_hash = stamp->hash;
+  header.source_time = stamp->time;
+
+  uint64_t offsets[plArrayElements(chunks)];
+  uint64_t offset = Mmf_Align(sizeof(MmfHeader) + sizeof(offsets));
+  for (unsigned int i = 0; i < plArrayElements(chunks); ++i) {
+    offsets[i] = offset;
+    offset += sizeof(MmfChunkHeader) + Mmf_Align(chunks[i].element_size * chunks[i].count);
+  }
+
+  static const uint8_t padding[MMF_CHUNK_ALIGNMENT] = {0};
+  size_t pad = offsets[0] - (sizeof(MmfHeader) + sizeof(offsets));
+  bool status = (fwrite(&header, sizeof(MmfHeader), 1, fp) == 1 &&
+                 fwrite(offsets, sizeof(offsets), 1, fp) == 1 &&
+                 (pad == 0 || fwrite(padding, 1, pad, fp) == pad));
+  for (unsigned int i = 0; i < plArrayElements(chunks) && status; ++i) {
+    status = Mmf_WriteChunk(fp, chunks[i].ident, chunks[i].data, chunks[i].element_size, chunks[i].count);
+  }
+
+  u_fclose(fp);
+
+  if (!status) {
+    LogWarn("Failed to write model cache, \"%s\"!\n", path);
+    plDeleteFile(path);
+  }
+
+  return status;
+}
+
+/**
+ * Rewrites the stamp of an existing cooked model in place, for when
+ * its sources were touched without actually changing.
+ */
+bool Mmf_UpdateStamp(const char *path, const MmfSourceStamp *stamp) {
+  FILE *fp = fopen(path, "r+b");
+  if (fp == NULL) {
+    return false;
+  }
+
+  MmfHeader header;
+  bool status = (fread(&header, sizeof(MmfHeader), 1, fp) == 1 &&
+                 strncmp(header.ident, MMF_IDENTIFIER, 3) == 0 &&
+                 header.version == MMF_VERSION);
+  if (status) {
+    header.source_size = stamp->size;
+    header.source_hash = stamp->hash;
+    header.source_time = stamp->time;
+    status = (fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(MmfHeader), 1, fp) == 1);
+  }
+
+  u_fclose(fp);
+  return status;
+}
@@ -0,0 +1,127 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Machinor Model Format
+ *
+ * Cooked model data, laid out so it can be mapped straight
+ * into memory and used without any further parsing.
+ *
+ * MmfHeader
+ * uint64_t chunk_offsets[num_chunks]
+ * MmfChunkHeader + data, for each chunk
+ *
+ * Chunks are aligned to 16 bytes and each begins with
+ * an MmfChunkHeader, which is followed by its data.
+ */
+
+#define MMF_IDENTIFIER  "MMF"
+#define MMF_VERSION     5
+
+#define MMF_CHUNK_ALIGNMENT 16
+
+PL_EXTERN_C
+
+typedef struct __attribute__((packed)) MmfHeader {
+  char ident[3];
+  uint8_t version;
+  uint32_t num_chunks;
+  uint32_t source_size;   /* combined size of the files the model was cooked from */
+  uint32_t source_hash;   /* and their hash, so we know when to cook again */
+  uint32_t source_time;   /* hash of their modification times, checked before the above */
+} MmfHeader;
+
+typedef struct __attribute__((packed)) MmfChunkHeader {
+  char ident[3];
+  uint8_t padding0;
+  uint32_t length;        /* length of data following the header, in bytes */
+  uint32_t count;         /* number of elements in the chunk */
+  uint32_t padding1;
+} MmfChunkHeader;
+
+/* Vertices Chunk */
+
+#define MMF_VERTICES_IDENTIFIER "VTX"
+
+typedef struct __attribute__((packed)) MmfVertex {
+  float position[3];
+  float normal[3];
+  float st[2];            /* in texels, relative to the texture it uses */
+  uint8_t colour[4];
+  uint16_t bone_index;
+  uint16_t texture_index; /* index into textures chunk */
+} MmfVertex;
+
+/* Indices Chunk */
+
+#define MMF_INDICES_IDENTIFIER  "IDX"
+
+/* Textures Chunk */
+
+#define MMF_TEXTURES_IDENTIFIER "TEX"
+
+typedef struct __attribute__((packed)) MmfTexture {
+  char name[16];
+} MmfTexture;
+
+/* Bounds Chunk */
+
+#define MMF_BOUNDS_IDENTIFIER   "BND"
+
+typedef struct __attribute__((packed)) MmfBounds {
+  float mins[3];
+  float maxs[3];
+} MmfBounds;
+
+/************************************************************/
+
+typedef struct MmfModel {
+  const MmfVertex *vertices;
+  unsigned int num_vertices;
+
+  const uint32_t *indices;
+  unsigned int num_indices;
+
+  const MmfTexture *textures;
+  unsigned int num_textures;
+
+  MmfBounds bounds;
+} MmfModel;
+
+/* Identifies the files a model was cooked from. Their size and
+ * modification times are checked first, so they only need to be
+ * hashed when those don't match, such as after being touched. */
+typedef struct MmfSourceStamp {
+  uint32_t size;
+  uint32_t time;          /* 0 if unknown */
+  uint32_t hash;
+  bool has_hash;
+} MmfSourceStamp;
+
+typedef struct MmfHandle {
+  MmfModel model;
+  UMappedFile file;
+} MmfHandle;
+
+MmfHandle *Mmf_OpenFile(const char *path, const MmfSourceStamp *stamp);
+void Mmf_CloseFile(MmfHandle *handle);
+
+bool Mmf_WriteFile(const MmfModel *model, const char *path, const MmfSourceStamp *stamp);
+bool Mmf_UpdateStamp(const char *path, const MmfSourceStamp *stamp);
+
+PL_EXTERN_C_END
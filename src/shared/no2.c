@@ -20,48 +20,103 @@
 
 #include "util.h"
 #include "vtx.h"
+#include "fac.h"
 #include "no2.h"
 
 /************************************************************/
 /* No2 Normals Format */
 
+typedef struct __attribute__((packed)) No2Coord {
+  float v[3];
+  float bone_index;
+} No2Coord;
+
 /**
- * @brief Loads in vertex normal data
+ * @brief Loads in the normal table, which faces index into via FacTriangle::normal_indices
  * @param path Path to the NO2 file
- * @param vertex_data Pointer to an existing VtxHandle which will be filled with normal data
- * @return Returns vertex_data on success, null on fail
+ * @param context Allocator and error sink to use, or null for the defaults
+ * @return Returns a new handle on success, null on fail
  */
-VtxHandle *No2_LoadFile(const char *path, VtxHandle *vertex_data) {
+No2Handle *No2_LoadNormals(const char *path, const ULoaderContext *context) {
   PLFile *fp = plOpenFile(path, false);
   if (fp == NULL) {
-    LogWarn("Failed to load no2 \"%s\"!\n", path);
+    LoaderError(context, "Failed to load no2 \"%s\"!\n", path);
     return NULL;
   }
 
-  typedef struct __attribute__((packed)) No2Coord {
-    float v[3];
-    float bone_index;
-  } No2Coord;
   unsigned int num_normals = (unsigned int) (plGetFileSize(fp) / sizeof(No2Coord));
-  if (num_normals != vertex_data->num_vertices || num_normals == 0) {
-    LogWarn("Invalid number of normals in \"%s\" (%d/%d)!\n", path, num_normals, vertex_data->num_vertices);
+  /* at most, there'll be one for each corner of every triangle */
+  if (num_normals == 0 || num_normals > FAC_MAX_TRIANGLES * 3) {
+    LoaderError(context, "Invalid number of normals in \"%s\" (%d)!\n", path, num_normals);
     plCloseFile(fp);
     return NULL;
   }
 
-  No2Coord normals[num_normals];
+  UScratchMark mark = u_scratch_mark();
+  No2Coord *normals = u_scratch_alloc(num_normals * sizeof(No2Coord));
   unsigned int rnum_normals = plReadFile(fp, normals, sizeof(No2Coord), num_normals);
   plCloseFile(fp);
   if (rnum_normals != num_normals) {
-    LogWarn("Failed to read in all normals from \"%s\"!\n", path);
+    LoaderError(context, "Failed to read in all normals from \"%s\"!\n", path);
+    u_scratch_release(mark);
+    return NULL;
+  }
+
+  No2Handle *handle = u_loader_alloc(context, 1, sizeof(No2Handle));
+  PLVector3 *out = u_loader_alloc(context, num_normals, sizeof(PLVector3));
+  if (handle == NULL || out == NULL) {
+    u_loader_free(context, handle);
+    u_loader_free(context, out);
+    u_scratch_release(mark);
+    LoaderError(context, "Failed to allocate %u normals for \"%s\"!\n", num_normals, path);
+    return NULL;
+  }
+
+  handle->normals = out;
+  handle->num_normals = num_normals;
+  for (unsigned int i = 0; i < num_normals; ++i) {
+    handle->normals[i].x = normals[i].v[0];
+    handle->normals[i].y = normals[i].v[1];
+    handle->normals[i].z = normals[i].v[2];
+  }
+
+  u_scratch_release(mark);
+
+  return handle;
+}
+
+void No2_DestroyHandle(No2Handle *handle, const ULoaderContext *context) {
+  if (handle == NULL) {
+    return;
+  }
+
+  u_loader_free(context, handle->normals);
+  u_loader_free(context, handle);
+}
+
+/**
+ * @brief Loads in vertex normal data, assuming one normal per vertex
+ * @param path Path to the NO2 file
+ * @param vertex_data Pointer to an existing VtxHandle which will be filled with normal data
+ * @return Returns vertex_data on success, null on fail
+ */
+VtxHandle *No2_LoadFile(const char *path, VtxHandle *vertex_data) {
+  No2Handle *handle = No2_LoadNormals(path, NULL);
+  if (handle == NULL) {
+    return NULL;
+  }
+
+  if (handle->num_normals != vertex_data->num_vertices) {
+    LogWarn("Invalid number of normals in \"%s\" (%d/%d)!\n", path, handle->num_normals, vertex_data->num_vertices);
+    No2_DestroyHandle(handle, NULL);
     return NULL;
   }
 
   for (unsigned int i = 0; i < vertex_data->num_vertices; ++i) {
-    vertex_data->vertices[i].normal.x = normals[i].v[0];
-    vertex_data->vertices[i].normal.y = normals[i].v[1];
-    vertex_data->vertices[i].normal.z = normals[i].v[2];
+    vertex_data->vertices[i].normal = handle->normals[i];
   }
 
+  No2_DestroyHandle(handle, NULL);
+
   return vertex_data;
 }
@@ -19,6 +19,15 @@
 
 PL_EXTERN_C
 
+typedef struct No2Handle {
+  struct PLVector3 *normals;
+  unsigned int num_normals;
+} No2Handle;
+
+/* Reentrant, context may be NULL for the defaults */
+No2Handle *No2_LoadNormals(const char *path, const ULoaderContext *context);
+void No2_DestroyHandle(No2Handle *handle, const ULoaderContext *context);
+
 typedef struct VtxHandle VtxHandle;
 VtxHandle *No2_LoadFile(const char *path, VtxHandle *vertex_data);
 
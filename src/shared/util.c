@@ -15,6 +15,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdarg.h>
+
 #include <PL/platform_filesystem.h>
 
 #include "util.h"
@@ -23,6 +25,13 @@
 # include "../engine/engine.h"
 #endif
 
+#if !defined(_WIN32)
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
 /****************************************************/
 /* Logs */
 
@@ -74,30 +83,218 @@ void* u_alloc( size_t num, size_t size, bool abort_on_fail ) {
 	return mem;
 }
 
+/**
+ * FNV-1a hash of the given data. Pass U_HASH_SEED to start a new hash,
+ * or the result of a previous call to continue it.
+ */
+uint32_t u_hash( const void* data, size_t size, uint32_t seed ) {
+	const uint8_t* p = data;
+	uint32_t hash = seed;
+	for ( size_t i = 0; i < size; ++i ) {
+		hash ^= p[ i ];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/****************************************************/
+/* Scratch Arena */
+
+#if defined( _MSC_VER )
+#	define U_THREAD_LOCAL __declspec( thread )
+#else
+#	define U_THREAD_LOCAL _Thread_local
+#endif
+
+#define U_SCRATCH_ALIGNMENT     16
+#define U_SCRATCH_MIN_BLOCK     ( 64 * 1024 )
+/* Don't hold on to any more than this between loads */
+#define U_SCRATCH_MAX_RETAINED  ( 8 * 1024 * 1024 )
+
+typedef struct UScratchBlock {
+	struct UScratchBlock* prev;
+	size_t size;
+	size_t used;
+} UScratchBlock;
+
+#define U_SCRATCH_HEADER_SIZE   ( ( sizeof( UScratchBlock ) + U_SCRATCH_ALIGNMENT - 1 ) & ~( size_t ) ( U_SCRATCH_ALIGNMENT - 1 ) )
+
+static U_THREAD_LOCAL UScratchBlock* scratchBlock = NULL;
+
+static UScratchBlock* u_scratch_new_block( size_t size, UScratchBlock* prev ) {
+	UScratchBlock* block = u_alloc( 1, U_SCRATCH_HEADER_SIZE + size, true );
+	block->prev = prev;
+	block->size = size;
+	block->used = 0;
+	return block;
+}
+
+/**
+ * Allocates temporary memory for the current thread, which
+ * stays valid until released back past it via u_scratch_release.
+ */
+void* u_scratch_alloc( size_t size ) {
+	size = ( size + U_SCRATCH_ALIGNMENT - 1 ) & ~( size_t ) ( U_SCRATCH_ALIGNMENT - 1 );
+	if ( scratchBlock == NULL || scratchBlock->used + size > scratchBlock->size ) {
+		size_t blockSize = U_SCRATCH_MIN_BLOCK;
+		if ( scratchBlock != NULL && scratchBlock->size * 2 > blockSize ) {
+			blockSize = scratchBlock->size * 2;
+		}
+		if ( size > blockSize ) {
+			blockSize = size;
+		}
+
+		scratchBlock = u_scratch_new_block( blockSize, scratchBlock );
+	}
+
+	void* ptr = ( uint8_t* ) scratchBlock + U_SCRATCH_HEADER_SIZE + scratchBlock->used;
+	scratchBlock->used += size;
+	return ptr;
+}
+
+UScratchMark u_scratch_mark( void ) {
+	UScratchMark mark;
+	mark.block = scratchBlock;
+	mark.used = ( scratchBlock != NULL ) ? scratchBlock->used : 0;
+	return mark;
+}
+
+/**
+ * Release everything allocated since the given mark. Once
+ * everything has been released, any extra blocks are merged
+ * into one, so the next load of the same size won't need
+ * to allocate anything.
+ */
+void u_scratch_release( UScratchMark mark ) {
+	// Marks taken before the arena was first used point at nothing, and
+	// those taken after at the start of the first block, both mean the bottom
+	const UScratchBlock* markBlock = mark.block;
+	bool bottom = ( markBlock == NULL ) || ( markBlock->prev == NULL && mark.used == 0 );
+	if ( !bottom ) {
+		while ( scratchBlock != mark.block ) {
+			UScratchBlock* prev = scratchBlock->prev;
+			free( scratchBlock );
+			scratchBlock = prev;
+		}
+
+		scratchBlock->used = mark.used;
+		return;
+	}
+
+	if ( scratchBlock == NULL ) {
+		return;
+	}
+
+	if ( scratchBlock->prev == NULL ) {
+		scratchBlock->used = 0;
+		return;
+	}
+
+	size_t total = 0;
+	while ( scratchBlock != NULL ) {
+		UScratchBlock* prev = scratchBlock->prev;
+		total += scratchBlock->size;
+		free( scratchBlock );
+		scratchBlock = prev;
+	}
+
+	if ( total > U_SCRATCH_MAX_RETAINED ) {
+		total = U_SCRATCH_MAX_RETAINED;
+	}
+	scratchBlock = u_scratch_new_block( total, NULL );
+}
+
+/**
+ * Frees everything held by the current thread's arena,
+ * should be called before a worker thread exits.
+ */
+void u_scratch_shutdown( void ) {
+	while ( scratchBlock != NULL ) {
+		UScratchBlock* prev = scratchBlock->prev;
+		free( scratchBlock );
+		scratchBlock = prev;
+	}
+}
+
+/****************************************************/
+/* Loader Context */
+
+void* u_loader_alloc( const ULoaderContext* context, size_t num, size_t size ) {
+	if ( context == NULL || context->alloc == NULL ) {
+		return u_alloc( num, size, true );
+	}
+
+	return context->alloc( num, size, context->user );
+}
+
+void u_loader_free( const ULoaderContext* context, void* ptr ) {
+	if ( ptr == NULL ) {
+		return;
+	}
+
+	if ( context == NULL || context->free == NULL ) {
+		free( ptr );
+		return;
+	}
+
+	context->free( ptr, context->user );
+}
+
+/**
+ * Passes an error on to the context's error callback, or the log
+ * if there isn't one. Use the LoaderError macro rather than this.
+ */
+void u_loader_report( const ULoaderContext* context, const char* function, const char* format, ... ) {
+	char message[ 512 ];
+	va_list args;
+	va_start( args, format );
+	vsnprintf( message, sizeof( message ), format, args );
+	va_end( args );
+
+	if ( context == NULL || context->error == NULL ) {
+		plLogMessage( LOG_LEVEL_WARNING, "(%s) %s", function, message );
+		return;
+	}
+
+	context->error( message, context->user );
+}
+
 /****************************************************/
 /* Filesystem */
 
-const char* u_scan( const char* path, const char** preference ) {
-	static char find[PL_SYSTEM_MAX_PATH];
+/**
+ * Finds the first of the given extensions that exists for the path,
+ * writing the result into out. Safe to call from any thread.
+ */
+bool u_scan_r( const char* path, const char** preference, char* out, size_t out_size ) {
 	while ( *preference != NULL ) {
-		snprintf( find, sizeof( find ), "%s.%s", path, *preference );
-		if ( plFileExists( find ) ) {
-			//LogDebug( "Found \"%s\"\n", find );
-			return find;
+		snprintf( out, out_size, "%s.%s", path, *preference );
+		if ( plFileExists( out ) ) {
+			return true;
 		}
 		preference++;
 	}
 
-	LogDebug( "Failed to find \"%s\"\n", path );
-	return "";
+	if ( out_size > 0 ) {
+		out[ 0 ] = '\0';
+	}
+
+	return false;
 }
 
-const char* u_find2( const char* path, const char** preference, bool abort_on_fail ) {
-	static char out[PL_SYSTEM_MAX_PATH];
-	memset( out, 0, sizeof( out ) );
+const char* u_scan( const char* path, const char** preference ) {
+	static U_THREAD_LOCAL char find[PL_SYSTEM_MAX_PATH];
+	if ( !u_scan_r( path, preference, find, sizeof( find ) ) ) {
+		LogDebug( "Failed to find \"%s\"\n", path );
+		return "";
+	}
+
+	return find;
+}
 
-	strncpy( out, u_scan( path, preference ), sizeof( out ) );
-	if ( plIsEmptyString( out ) ) {
+const char* u_find2( const char* path, const char** preference, bool abort_on_fail ) {
+	static U_THREAD_LOCAL char out[PL_SYSTEM_MAX_PATH];
+	if ( !u_scan_r( path, preference, out, sizeof( out ) ) ) {
 		if ( abort_on_fail ) {
 			Error( "Failed to find \"%s\"!\n", path );
 		}
@@ -106,6 +303,67 @@ const char* u_find2( const char* path, const char** preference, bool abort_on_fa
 		return NULL;
 	}
 
-	//LogDebug( "Found \"%s\"\n", out );
 	return out;
 }
+
+bool u_map_file( const char* path, UMappedFile* out ) {
+	memset( out, 0, sizeof( UMappedFile ) );
+
+#if !defined(_WIN32)
+	int fd = open( path, O_RDONLY );
+	if ( fd == -1 ) {
+		return false;
+	}
+
+	struct stat buf;
+	if ( fstat( fd, &buf ) != 0 || buf.st_size <= 0 ) {
+		close( fd );
+		return false;
+	}
+
+	void* data = mmap( NULL, ( size_t ) buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( data == MAP_FAILED ) {
+		return false;
+	}
+
+	out->data = data;
+	out->size = ( size_t ) buf.st_size;
+	out->mapped = true;
+	return true;
+#else
+	PLFile* file = plOpenFile( path, false );
+	if ( file == NULL ) {
+		return false;
+	}
+
+	out->size = plGetFileSize( file );
+	out->data = u_alloc( out->size, 1, true );
+	if ( plReadFile( file, out->data, 1, out->size ) != out->size ) {
+		plCloseFile( file );
+		u_free( out->data );
+		out->size = 0;
+		return false;
+	}
+
+	plCloseFile( file );
+	return true;
+#endif
+}
+
+void u_unmap_file( UMappedFile* file ) {
+	if ( file->data == NULL ) {
+		return;
+	}
+
+#if !defined(_WIN32)
+	if ( file->mapped ) {
+		munmap( file->data, file->size );
+	} else
+#endif
+	{
+		free( file->data );
+	}
+
+	memset( file, 0, sizeof( UMappedFile ) );
+}
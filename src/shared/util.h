@@ -70,11 +70,56 @@ void u_init_logs(const char* log_path);
 void* u_realloc(void* ptr, size_t new_size, bool abort_on_fail);
 void* u_alloc(size_t num, size_t size, bool abort_on_fail);
 
+#define U_HASH_SEED 2166136261u
+uint32_t u_hash(const void* data, size_t size, uint32_t seed);
+
+/* Per-thread arena for temporary allocations, such as when
+ * loading files. Take a mark before allocating anything and
+ * release back to it once done. */
+typedef struct UScratchMark {
+  void* block;
+  size_t used;
+} UScratchMark;
+void* u_scratch_alloc(size_t size);
+UScratchMark u_scratch_mark(void);
+void u_scratch_release(UScratchMark mark);
+void u_scratch_shutdown(void);
+
+/* Passed to the format loaders, so several files can be decoded
+ * at once from different threads. Any callback left NULL falls
+ * back to the default, being u_alloc, free and the log - though
+ * alloc and free should always be provided together. The log
+ * isn't reentrant, so provide an error callback for workers. */
+typedef struct ULoaderContext {
+  void* (* alloc)(size_t num, size_t size, void* user);
+  void (* free)(void* ptr, void* user);
+  void (* error)(const char* message, void* user);
+  void* user;
+} ULoaderContext;
+void* u_loader_alloc(const ULoaderContext* context, size_t num, size_t size);
+void u_loader_free(const ULoaderContext* context, void* ptr);
+void u_loader_report(const ULoaderContext* context, const char* function, const char* format, ...);
+
+#define LoaderError(CONTEXT, FORMAT, ...) u_loader_report((CONTEXT), PL_FUNCTION, FORMAT, ## __VA_ARGS__)
+
+/* The returned path is only valid on the calling thread, until
+ * the next call. Use u_scan_r to provide your own buffer. */
 const char* u_scan(const char* path, const char** preference);
+bool u_scan_r(const char* path, const char** preference, char* out, size_t out_size);
 const char* u_find2(const char* path, const char** preference, bool abort_on_fail);
 
 FILE* u_open(const char* path, const char* mode, bool abort_on_fail);
 
+/* Maps the whole file into memory, read-only. Falls back to
+ * reading it into a buffer where mmap isn't available. */
+typedef struct UMappedFile {
+  void* data;
+  size_t size;
+  bool mapped;
+} UMappedFile;
+bool u_map_file(const char* path, UMappedFile* out);
+void u_unmap_file(UMappedFile* file);
+
 PL_EXTERN_C_END
 
 #ifdef _DEBUG
@@ -24,10 +24,10 @@
 /************************************************************/
 /* Vtx Vertex Format */
 
-VtxHandle* Vtx_LoadFile(const char* path) {
+VtxHandle* Vtx_LoadFile(const char* path, const ULoaderContext* context) {
   PLFile* vtx_file = plOpenFile(path, false);
   if (vtx_file == NULL) {
-    LogWarn("Failed to load Vtx \"%s\", aborting!\n", path);
+    LoaderError(context, "Failed to load Vtx \"%s\", aborting!\n", path);
     return NULL;
   }
 
@@ -40,40 +40,54 @@ VtxHandle* Vtx_LoadFile(const char* path) {
 	unsigned int num_vertices = ( unsigned int ) ( plGetFileSize( vtx_file ) / sizeof( VtxCoord ) );
   if (num_vertices >= VTX_MAX_VERTICES) {
     plCloseFile(vtx_file);
-    LogWarn("Invalid number of vertices in \"%s\" (%d/%d)!\n", path, num_vertices, VTX_MAX_VERTICES);
+    LoaderError(context, "Invalid number of vertices in \"%s\" (%d/%d)!\n", path, num_vertices, VTX_MAX_VERTICES);
     return NULL;
   }
 
-  VtxCoord vertices[num_vertices];
+  if (num_vertices == 0) {
+    plCloseFile(vtx_file);
+    LoaderError(context, "No vertices found in Vtx \"%s\"!\n", path);
+    return NULL;
+  }
+
+  UScratchMark mark = u_scratch_mark();
+  VtxCoord *vertices = u_scratch_alloc(num_vertices * sizeof(VtxCoord));
   unsigned int rnum_vertices = plReadFile(vtx_file, vertices, sizeof(VtxCoord), num_vertices);
   plCloseFile(vtx_file);
 
-  if (num_vertices == 0) {
-    LogWarn("No vertices found in Vtx \"%s\"!\n", path);
+  if (rnum_vertices != num_vertices) {
+    u_scratch_release(mark);
+    LoaderError(context, "Failed to read in all vertices from \"%s\", aborting!\n", path);
     return NULL;
   }
 
-  if (rnum_vertices != num_vertices) {
-    LogWarn("Failed to read in all vertices from \"%s\", aborting!\n", path);
+  VtxHandle* handle = u_loader_alloc(context, 1, sizeof(VtxHandle));
+  PLVertex* out = u_loader_alloc(context, num_vertices, sizeof(PLVertex));
+  if (handle == NULL || out == NULL) {
+    u_loader_free(context, handle);
+    u_loader_free(context, out);
+    u_scratch_release(mark);
+    LoaderError(context, "Failed to allocate %u vertices for \"%s\"!\n", num_vertices, path);
     return NULL;
   }
 
-  VtxHandle* handle = u_alloc(1, sizeof(VtxHandle), true);
-  handle->vertices = u_alloc(num_vertices, sizeof(PLVertex), true);
+  handle->vertices = out;
   handle->num_vertices = num_vertices;
   for (unsigned int i = 0; i < num_vertices; ++i) {
     handle->vertices[i].position = PLVector3(vertices[i].v[0], vertices[i].v[1], vertices[i].v[2]);
     handle->vertices[i].bone_index = vertices[i].bone_index;
     handle->vertices[i].colour = PL_COLOUR_WHITE;
   }
+
+  u_scratch_release(mark);
   return handle;
 }
 
-void Vtx_DestroyHandle(VtxHandle* handle) {
+void Vtx_DestroyHandle(VtxHandle* handle, const ULoaderContext* context) {
   if (handle == NULL) {
     return;
   }
 
-  u_free(handle->vertices);
-  u_free(handle);
+  u_loader_free(context, handle->vertices);
+  u_loader_free(context, handle);
 }
@@ -26,7 +26,8 @@ typedef struct VtxHandle {
   unsigned int num_vertices;
 } VtxHandle;
 
-VtxHandle *Vtx_LoadFile(const char *path);
-void Vtx_DestroyHandle(VtxHandle *handle);
+/* Reentrant, context may be NULL for the defaults */
+VtxHandle *Vtx_LoadFile(const char *path, const ULoaderContext *context);
+void Vtx_DestroyHandle(VtxHandle *handle, const ULoaderContext *context);
 
 PL_EXTERN_C_END
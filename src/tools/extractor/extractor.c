@@ -16,16 +16,22 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <time.h>
+
 #include <PL/platform_package.h>
 
 #include "extractor.h"
+#include "jobs.h"
+#include "manifest.h"
 
 #include "../../shared/fac.h"
 #include "../../shared/vtx.h"
 #include "../../shared/no2.h"
+#include "../../shared/maf.h"
 
 static char g_input_path[PL_SYSTEM_MAX_PATH] = { '\0' };
 static char g_output_path[PL_SYSTEM_MAX_PATH];
+static bool g_pack_output = false;
 
 //#define PARANOID_DATA
 //#define EXPORT_NORMALS
@@ -76,6 +82,22 @@ static void ConvertImageToPng( const char* path ) {
 	plFreeImage( &image );
 }
 
+static void ConvertImageJob( void* data ) {
+	char* path = data;
+	ConvertImageToPng( path );
+	u_free( path );
+}
+
+/**
+ * Queues the image up to be converted on one of the workers.
+ * Wait on the counter before touching the file again.
+ */
+static void QueueImageConversion( const char* path, JobCounter* counter ) {
+	char* copy = u_alloc( strlen( path ) + 1, 1, true );
+	strcpy( copy, path );
+	Jobs_Submit( ConvertImageJob, copy, counter );
+}
+
 typedef struct ModelConversionData {
 	const char* mad;
 	const char* mtd;
@@ -109,31 +131,101 @@ static ModelConversionData pc_conversion_data[] = {
 	{ "/Chars/SKYDOME.MAD", NULL, "mods/how/skys/" },
 };
 
-static void ConvertModelData( void ) {
-	for ( unsigned long i = 0; i < plArrayElements( pc_conversion_data ); ++i ) {
-		char path[PL_SYSTEM_MAX_PATH];
-		snprintf( path, sizeof( path ), "%s%s", g_input_path, pc_conversion_data[ i ].mad );
-		PLPackage* package = plLoadPackage( path );
-		if ( package == NULL ) {
-			LogWarn( "Failed to load MAD package, \"%s\" (%s)!\n", path, plGetError() );
+static void ConvertModelPackage( const ModelConversionData* data ) {
+	char path[PL_SYSTEM_MAX_PATH];
+	snprintf( path, sizeof( path ), "%s%s", g_input_path, data->mad );
+	PLPackage* package = plLoadPackage( path );
+	if ( package == NULL ) {
+		LogWarn( "Failed to load MAD package, \"%s\" (%s)!\n", path, plGetError() );
+		return;
+	}
+
+	/* Write the files out to the destination. I'm lazy and we'll delete it once we're done anyway. */
+	UScratchMark mark = u_scratch_mark();
+	char ( *model_paths )[PL_SYSTEM_MAX_PATH] = u_scratch_alloc( package->table_size * PL_SYSTEM_MAX_PATH );
+	unsigned int num_models = 0;
+	for ( unsigned int j = 0; j < package->table_size; ++j ) {
+		char out[PL_SYSTEM_MAX_PATH];
+		snprintf( out,
+				  sizeof( out ),
+				  "%s%s",
+				  data->out,
+				  pl_strtolower( package->table[ j ].fileName ) );
+
+		char dir[PL_SYSTEM_MAX_PATH];
+		const char* filename = plGetFileName( out );
+		strncpy( dir, out, strlen( out ) - strlen( filename ) );
+		dir[ strlen( out ) - strlen( filename ) ] = '\0';
+		if ( plCreatePath( dir ) ) {
+			PLFile* fp = plLoadPackageFile( package, package->table[ j ].fileName );
+			if ( !plWriteFile( out, plGetFileData( fp ), package->table[ j ].fileSize ) ) {
+				LogWarn( "Failed to write model, \"%s\" (%s)!\n", out, plGetError() );
+			}
+			plCloseFile( fp );
+		} else {
+			LogWarn( "Failed to create output directory, \"%s\" (%s)!\n", dir, plGetError() );
+		}
+
+		// skydome is a special case
+		if ( pl_strcasecmp( filename, "skydomeu.fac" ) == 0 || pl_strcasecmp( filename, "skydome.fac" ) == 0 ) {
 			continue;
 		}
 
-		/* Write the files out to the destination. I'm lazy and we'll delete it once we're done anyway. */
-		char model_paths[package->table_size][PL_SYSTEM_MAX_PATH];
-		unsigned int num_models = 0;
+		const char* ext = plGetFileExtension( package->table[ j ].fileName );
+		if ( pl_strcasecmp( ext, "fac" ) == 0 ) {
+			plStripExtension( model_paths[ num_models++ ], PL_SYSTEM_MAX_PATH - 1, out );
+		}
+	}
+
+	plDestroyPackage( package );
+
+	/* Now we need to load each fac, fetch each index for each texture and figure out
+	 * the true name for that texture by comparing against the mtd. */
+
+	if ( data->mtd != NULL ) {
+		JobCounter counter = JOB_COUNTER_INIT;
+		snprintf( path, sizeof( path ), "%s%s", g_input_path, data->mtd );
+		package = plLoadPackage( path );
+		if ( package == NULL ) {
+			LogWarn( "Failed to load MTD package, \"%s\" (%s)!\n", data->mtd, plGetError() );
+		}
+
+		// write all the textures out
 		for ( unsigned int j = 0; j < package->table_size; ++j ) {
 			char out[PL_SYSTEM_MAX_PATH];
 			snprintf( out,
 					  sizeof( out ),
 					  "%s%s",
-					  pc_conversion_data[ i ].out,
+					  data->out,
 					  pl_strtolower( package->table[ j ].fileName ) );
-
 			char dir[PL_SYSTEM_MAX_PATH];
 			const char* filename = plGetFileName( out );
 			strncpy( dir, out, strlen( out ) - strlen( filename ) );
 			dir[ strlen( out ) - strlen( filename ) ] = '\0';
+
+#if defined( PARANOID_DATA ) // paranoid check, doesn't happen...
+			if(plFileExists(out)) {
+			  LogInfo("The file \"%s\" already exists, comparing...\n", out);
+
+			  size_t size = plGetLocalFileSize(out);
+			  FILE *fp = fopen(out, "rb");
+			  char *data = u_alloc(size, 1, true);
+			  fread(data, 1, size, fp);
+			  fclose(fp);
+
+			  uint32_t crc_a;
+			  pl_crc32(package->table[j].file.data, package->table[j].fileSize, &crc_a);
+			  uint32_t crc_b;
+			  pl_crc32(data, size, &crc_b);
+			  if(crc_a != crc_b) {
+				LogWarn("Files are different, renaming second file!\n");
+				while(plFileExists(out)) {
+				  strcat(out, "_");
+				}
+			  }
+			}
+#endif
+
 			if ( plCreatePath( dir ) ) {
 				PLFile* fp = plLoadPackageFile( package, package->table[ j ].fileName );
 				if ( !plWriteFile( out, plGetFileData( fp ), package->table[ j ].fileSize ) ) {
@@ -144,159 +236,159 @@ static void ConvertModelData( void ) {
 				LogWarn( "Failed to create output directory, \"%s\" (%s)!\n", dir, plGetError() );
 			}
 
-			// skydome is a special case
-			if ( pl_strcasecmp( filename, "skydomeu.fac" ) == 0 || pl_strcasecmp( filename, "skydome.fac" ) == 0 ) {
-				continue;
-			}
-
-			const char* ext = plGetFileExtension( package->table[ j ].fileName );
-			if ( pl_strcasecmp( ext, "fac" ) == 0 ) {
-				plStripExtension( model_paths[ num_models++ ], PL_SYSTEM_MAX_PATH - 1, out );
-			}
+			QueueImageConversion( out, &counter );
 		}
 
-		plDestroyPackage( package );
+		Jobs_Wait( &counter );
+	}
 
-		/* Now we need to load each fac, fetch each index for each texture and figure out
-		 * the true name for that texture by comparing against the mtd. */
+	/* and now we go through again, converting everything as we do so */
+	for ( unsigned int j = 0; j < num_models; ++j ) {
+		char fac_path[PL_SYSTEM_MAX_PATH];
+		snprintf( fac_path, PL_SYSTEM_MAX_PATH, "%s.fac", model_paths[ j ] );
+		if ( !plFileExists( fac_path ) ) {
+			LogWarn( "Failed to find FAC file, \"%s\"!\n", fac_path );
+			continue;
+		}
 
-		if ( pc_conversion_data[ i ].mtd != NULL ) {
-			snprintf( path, sizeof( path ), "%s%s", g_input_path, pc_conversion_data[ i ].mtd );
-			package = plLoadPackage( path );
-			if ( package == NULL ) {
-				LogWarn( "Failed to load MTD package, \"%s\" (%s)!\n", pc_conversion_data[ i ].mtd, plGetError() );
-			}
+#if defined( EXPORT_NORMALS )
+		char vtx_path[PL_SYSTEM_MAX_PATH];
+		snprintf( vtx_path, PL_SYSTEM_MAX_PATH, "%s.vtx", model_paths[ j ] );
+		if ( !plFileExists( vtx_path ) ) {
+			LogWarn( "Failed to find VTX file, \"%s\"!\n", vtx_path );
+			continue;
+		}
 
-			// write all the textures out
-			for ( unsigned int j = 0; j < package->table_size; ++j ) {
-				char out[PL_SYSTEM_MAX_PATH];
-				snprintf( out,
-						  sizeof( out ),
-						  "%s%s",
-						  pc_conversion_data[ i ].out,
-						  pl_strtolower( package->table[ j ].fileName ) );
-				char dir[PL_SYSTEM_MAX_PATH];
-				const char* filename = plGetFileName( out );
-				strncpy( dir, out, strlen( out ) - strlen( filename ) );
-				dir[ strlen( out ) - strlen( filename ) ] = '\0';
+		char no2_path[PL_SYSTEM_MAX_PATH];
+		snprintf( no2_path, PL_SYSTEM_MAX_PATH, "%s.no2", model_paths[ j ] );
+		if ( !plFileExists( no2_path ) ) {
+			LogWarn( "Failed to find NO2 file, \"%s\"!\n", no2_path );
+			continue;
+		}
 
-#if defined( PARANOID_DATA ) // paranoid check, doesn't happen...
-				if(plFileExists(out)) {
-				  LogInfo("The file \"%s\" already exists, comparing...\n", out);
-
-				  size_t size = plGetLocalFileSize(out);
-				  FILE *fp = fopen(out, "rb");
-				  char *data = u_alloc(size, 1, true);
-				  fread(data, 1, size, fp);
-				  fclose(fp);
-
-				  uint32_t crc_a;
-				  pl_crc32(package->table[j].file.data, package->table[j].fileSize, &crc_a);
-				  uint32_t crc_b;
-				  pl_crc32(data, size, &crc_b);
-				  if(crc_a != crc_b) {
-					LogWarn("Files are different, renaming second file!\n");
-					while(plFileExists(out)) {
-					  strcat(out, "_");
-					}
-				  }
-				}
+		bool generate_normals = false;
+		VtxHandle* vtx = Vtx_LoadFile( vtx_path, NULL );
+		if ( No2_LoadFile( no2_path, vtx ) == NULL ) {
+			generate_normals = true;
+		}
 #endif
 
-				if ( plCreatePath( dir ) ) {
-					PLFile* fp = plLoadPackageFile( package, package->table[ j ].fileName );
-					if ( !plWriteFile( out, plGetFileData( fp ), package->table[ j ].fileSize ) ) {
-						LogWarn( "Failed to write model, \"%s\" (%s)!\n", out, plGetError() );
-					}
-					plCloseFile( fp );
-				} else {
-					LogWarn( "Failed to create output directory, \"%s\" (%s)!\n", dir, plGetError() );
-				}
+		// we'll resize this later...
+		FacTextureIndex* table = u_alloc( package->table_size, sizeof( FacTextureIndex ), true );
+		unsigned int table_size = 0;
 
-				ConvertImageToPng( out );
-			}
-		}
-
-		/* and now we go through again, converting everything as we do so */
-		for ( unsigned int j = 0; j < num_models; ++j ) {
-			char fac_path[PL_SYSTEM_MAX_PATH];
-			snprintf( fac_path, PL_SYSTEM_MAX_PATH, "%s.fac", model_paths[ j ] );
-			if ( !plFileExists( fac_path ) ) {
-				LogWarn( "Failed to find FAC file, \"%s\"!\n", fac_path );
+		FacHandle* fac = Fac_LoadFile( fac_path, NULL );
+		for ( unsigned int k = 0; k < fac->num_triangles; ++k ) {
+			uint32_t texture_index = fac->triangles[ k ].texture_index;
+			if ( texture_index >= package->table_size ) {
+				LogWarn( "Out of bounds texture index, \"%s\"!\n", fac_path );
 				continue;
 			}
 
-#if defined( EXPORT_NORMALS )
-			char vtx_path[PL_SYSTEM_MAX_PATH];
-			snprintf( vtx_path, PL_SYSTEM_MAX_PATH, "%s.vtx", model_paths[ j ] );
-			if ( !plFileExists( vtx_path ) ) {
-				LogWarn( "Failed to find VTX file, \"%s\"!\n", vtx_path );
-				continue;
+			// attempt to add it to the table
+			char texture_name[16];
+			strncpy( texture_name, package->table[ texture_index ].fileName,
+					 strlen( package->table[ texture_index ].fileName ) - 4 );
+			texture_name[ strlen( package->table[ texture_index ].fileName ) - 4 ] = '\0';
+			pl_strtolower( texture_name );
+			unsigned int l;
+			for ( l = 0; l < package->table_size; ++l ) {
+				if ( table[ l ].name[ 0 ] == '\0' ) {
+					strncpy( table[ l ].name, texture_name, sizeof( table[ l ].name ) );
+					table_size++;
+					break;
+				} else if ( strncmp( table[ l ].name, texture_name, sizeof( table[ l ].name ) ) == 0 ) {
+					break;
+				}
 			}
 
-			char no2_path[PL_SYSTEM_MAX_PATH];
-			snprintf( no2_path, PL_SYSTEM_MAX_PATH, "%s.no2", model_paths[ j ] );
-			if ( !plFileExists( no2_path ) ) {
-				LogWarn( "Failed to find NO2 file, \"%s\"!\n", no2_path );
-				continue;
+			if ( table_size > package->table_size ) {
+				Error( "Invalid" );
 			}
 
-			bool generate_normals = false;
-			VtxHandle* vtx = Vtx_LoadFile( vtx_path );
-			if ( No2_LoadFile( no2_path, vtx ) == NULL ) {
-				generate_normals = true;
-			}
-#endif
+			// replace the original id so it matches with the index in our table
+			fac->triangles[ k ].texture_index = l;
+		}
 
-			// we'll resize this later...
-			FacTextureIndex* table = u_alloc( package->table_size, sizeof( FacTextureIndex ), true );
-			unsigned int table_size = 0;
+		fac->texture_table = u_alloc( table_size, sizeof( FacTextureIndex ), true );
+		fac->texture_table_size = table_size;
+		memcpy( fac->texture_table, table, sizeof( FacTextureIndex ) * table_size );
+		u_free( table );
 
-			FacHandle* fac = Fac_LoadFile( fac_path );
-			for ( unsigned int k = 0; k < fac->num_triangles; ++k ) {
-				uint32_t texture_index = fac->triangles[ k ].texture_index;
-				if ( texture_index >= package->table_size ) {
-					LogWarn( "Out of bounds texture index, \"%s\"!\n", fac_path );
-					continue;
-				}
+		// write out the fac and replace it (we'll append the table to the end)
+		snprintf( fac_path, PL_SYSTEM_MAX_PATH, "%s.fac", model_paths[ j ] );
+		Fac_WriteFile( fac, fac_path );
+	}
 
-				// attempt to add it to the table
-				char texture_name[16];
-				strncpy( texture_name, package->table[ texture_index ].fileName,
-						 strlen( package->table[ texture_index ].fileName ) - 4 );
-				texture_name[ strlen( package->table[ texture_index ].fileName ) - 4 ] = '\0';
-				pl_strtolower( texture_name );
-				unsigned int l;
-				for ( l = 0; l < package->table_size; ++l ) {
-					if ( table[ l ].name[ 0 ] == '\0' ) {
-						strncpy( table[ l ].name, texture_name, sizeof( table[ l ].name ) );
-						table_size++;
-						break;
-					} else if ( strncmp( table[ l ].name, texture_name, sizeof( table[ l ].name ) ) == 0 ) {
-						break;
-					}
-				}
+	u_scratch_release( mark );
+}
 
-				if ( table_size > package->table_size ) {
-					Error( "Invalid" );
-				}
+/**
+ * Packages sharing an output directory can overwrite each
+ * other's files, so they're converted in order by one job.
+ */
+static bool UpdateModelManifest( const char* source, const char* output, bool check ) {
+	if ( source == NULL ) {
+		return true;
+	}
 
-				// replace the original id so it matches with the index in our table
-				fac->triangles[ k ].texture_index = l;
-			}
+	char key[PL_SYSTEM_MAX_PATH];
+	snprintf( key, sizeof( key ), "model:%s", source );
+	char path[PL_SYSTEM_MAX_PATH];
+	snprintf( path, sizeof( path ), "%s%s", g_input_path, source );
+	if ( check ) {
+		return Manifest_IsUpToDate( key, path, output );
+	}
+
+	Manifest_Update( key, path, output );
+	return true;
+}
 
-			fac->texture_table = u_alloc( table_size, sizeof( FacTextureIndex ), true );
-			fac->texture_table_size = table_size;
-			memcpy( fac->texture_table, table, sizeof( FacTextureIndex ) * table_size );
-			u_free( table );
+static void ConvertModelGroupJob( void* data ) {
+	const ModelConversionData* first = data;
+	const ModelConversionData* end = pc_conversion_data + plArrayElements( pc_conversion_data );
 
-			// write out the fac and replace it (we'll append the table to the end)
-			snprintf( fac_path, PL_SYSTEM_MAX_PATH, "%s.fac", model_paths[ j ] );
-			Fac_WriteFile( fac, fac_path );
+	// If anything in the group has changed, the whole group needs redoing
+	bool upToDate = true;
+	for ( const ModelConversionData* i = first; i < end && upToDate; ++i ) {
+		if ( strcmp( i->out, first->out ) == 0 ) {
+			upToDate = UpdateModelManifest( i->mad, i->out, true ) && UpdateModelManifest( i->mtd, i->out, true );
+		}
+	}
+
+	if ( upToDate ) {
+		Manifest_MarkSkipped();
+		return;
+	}
+
+	for ( const ModelConversionData* i = first; i < end; ++i ) {
+		if ( strcmp( i->out, first->out ) == 0 ) {
+			ConvertModelPackage( i );
+			UpdateModelManifest( i->mad, i->out, false );
+			UpdateModelManifest( i->mtd, i->out, false );
 		}
 	}
 }
 
+static void ConvertModelData( void ) {
+	JobCounter counter = JOB_COUNTER_INIT;
+	for ( unsigned long i = 0; i < plArrayElements( pc_conversion_data ); ++i ) {
+		bool first = true;
+		for ( unsigned long j = 0; j < i; ++j ) {
+			if ( strcmp( pc_conversion_data[ j ].out, pc_conversion_data[ i ].out ) == 0 ) {
+				first = false;
+				break;
+			}
+		}
+
+		if ( first ) {
+			Jobs_Submit( ConvertModelGroupJob, &pc_conversion_data[ i ], &counter );
+		}
+	}
+
+	Jobs_Wait( &counter );
+}
+
 /////////////////////////////////////////////////////////////
 /* Extraction process for initial setup */
 
@@ -313,13 +405,17 @@ static void ExtractPtgPackage( const char* input_path, const char* output_path )
 	}
 
 	uint32_t num_textures = 0;
-	if ( fread( &num_textures, sizeof( uint32_t ), 1, file ) != 1 ) {
+	if ( fread( &num_textures, sizeof( uint32_t ), 1, file ) != 1 || num_textures == 0 ) {
 		LogWarn( "Invalid PTG file, failed to get number of textures!\n" );
+		u_fclose( file );
+		return;
 	}
 
 	size_t tim_size = ( plGetLocalFileSize( input_path ) - sizeof( num_textures ) ) / num_textures;
+	JobCounter counter = JOB_COUNTER_INIT;
+	UScratchMark mark = u_scratch_mark();
+	uint8_t* tim = u_scratch_alloc( tim_size );
 	for ( unsigned int i = 0; i < num_textures; ++i ) {
-		uint8_t tim[tim_size];
 		if ( fread( tim, tim_size, 1, file ) != 1 ) {
 			LogInfo( "Failed to read Tim, \"%d\"!\n", i );
 			continue;
@@ -330,10 +426,13 @@ static void ExtractPtgPackage( const char* input_path, const char* output_path )
 		if ( !plWriteFile( out_path, tim, tim_size ) ) {
 			LogWarn( "Failed to write file, \"%s\" (%s)!\n", out_path, plGetError() );
 		}
-		ConvertImageToPng( out_path );
+		QueueImageConversion( out_path, &counter );
 	}
 
+	u_scratch_release( mark );
 	u_fclose( file );
+
+	Jobs_Wait( &counter );
 }
 
 static void ExtractMadPackage( const char* input_path, const char* output_path ) {
@@ -348,6 +447,7 @@ static void ExtractMadPackage( const char* input_path, const char* output_path )
 		return;
 	}
 
+	JobCounter counter = JOB_COUNTER_INIT;
 	for ( unsigned int i = 0; i < package->table_size; i++ ) {
 		char out[PL_SYSTEM_MAX_PATH];
 		snprintf( out, sizeof( out ) - 1, "%s%s", output_path, pl_strtolower( package->table[ i ].fileName ) );
@@ -359,11 +459,13 @@ static void ExtractMadPackage( const char* input_path, const char* output_path )
 
 		const char* ext = plGetFileExtension( out );
 		if ( strcmp( ext, "tim" ) == 0 ) {
-			ConvertImageToPng( out );
+			QueueImageConversion( out, &counter );
 		}
 	}
 
 	plDestroyPackage( package );
+
+	Jobs_Wait( &counter );
 }
 
 /************************************************************/
@@ -455,6 +557,17 @@ static void MergeTextureTargets( void ) {
 	LogInfo( "Merging %d texture targets...\n", num_texture_targets );
 	for ( unsigned int i = 0; i < num_texture_targets; ++i ) {
 		TextureMerge* merge = &texture_targets[ i ];
+
+		// The pieces are deleted once merged, so if none are left then it's already done
+		bool hasTargets = false;
+		for ( unsigned int j = 0; j < merge->num_textures && !hasTargets; ++j ) {
+			hasTargets = plFileExists( merge->targets[ j ].path );
+		}
+		if ( !hasTargets && plFileExists( merge->output ) ) {
+			Manifest_MarkSkipped();
+			continue;
+		}
+
 		LogInfo( "Generating %s\n", merge->output );
 		PLImage
 			* output = plCreateImage( NULL, merge->width, merge->height, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
@@ -510,58 +623,238 @@ static IOPath pc_package_paths[] = {
 #include "pc_package_paths.h"
 };
 
-static void ProcessPackagePaths( const char* in, const char* out, const IOPath* paths, unsigned int length ) {
-	for ( unsigned int i = 0; i < length; ++i ) {
-		char output_path[PL_SYSTEM_MAX_PATH];
-		snprintf( output_path, sizeof( output_path ), "%s%s", out, paths[ i ].output );
-		if ( !plCreatePath( output_path ) ) {
-			LogWarn( "%s\n", plGetError() );
-			continue;
+typedef struct PathJob {
+	const char* in, * out;
+	const IOPath* paths;
+	unsigned int length;
+	unsigned int index;
+} PathJob;
+
+static void ProcessPackagePath( const char* in, const char* out, const IOPath* path ) {
+	char output_path[PL_SYSTEM_MAX_PATH];
+	snprintf( output_path, sizeof( output_path ), "%s%s", out, path->output );
+	if ( !plCreatePath( output_path ) ) {
+		LogWarn( "%s\n", plGetError() );
+		return;
+	}
+
+	char input_path[PL_SYSTEM_MAX_PATH];
+	snprintf( input_path, sizeof( input_path ), "%s%s", in, path->input );
+	LogInfo( "Copying %s to %s\n", input_path, output_path );
+	const char* ext = plGetFileExtension( input_path );
+	if ( pl_strncasecmp( ext, "PTG", 3 ) == 0 ) {
+		ExtractPtgPackage( input_path, output_path );
+	} else {
+		ExtractMadPackage( input_path, output_path );
+	}
+}
+
+/**
+ * Extracts every package sharing the same output directory, in
+ * order, so that the last one to write a file always wins.
+ */
+static bool UpdatePackageManifest( const PathJob* job, const IOPath* path, bool check ) {
+	char key[PL_SYSTEM_MAX_PATH];
+	snprintf( key, sizeof( key ), "package:%s", path->input );
+	char input_path[PL_SYSTEM_MAX_PATH];
+	snprintf( input_path, sizeof( input_path ), "%s%s", job->in, path->input );
+	char output_path[PL_SYSTEM_MAX_PATH];
+	snprintf( output_path, sizeof( output_path ), "%s%s", job->out, path->output );
+	if ( check ) {
+		return Manifest_IsUpToDate( key, input_path, output_path );
+	}
+
+	Manifest_Update( key, input_path, output_path );
+	return true;
+}
+
+static void ProcessPackageGroupJob( void* data ) {
+	const PathJob* job = data;
+	const char* output = job->paths[ job->index ].output;
+
+	bool upToDate = true;
+	for ( unsigned int i = job->index; i < job->length && upToDate; ++i ) {
+		if ( strcmp( job->paths[ i ].output, output ) == 0 ) {
+			upToDate = UpdatePackageManifest( job, &job->paths[ i ], true );
 		}
+	}
 
-		char input_path[PL_SYSTEM_MAX_PATH];
-		snprintf( input_path, sizeof( input_path ), "%s%s", in, paths[ i ].input );
-		LogInfo( "Copying %s to %s\n", input_path, output_path );
-		const char* ext = plGetFileExtension( input_path );
-		if ( pl_strncasecmp( ext, "PTG", 3 ) == 0 ) {
-			ExtractPtgPackage( input_path, output_path );
-		} else {
-			ExtractMadPackage( input_path, output_path );
+	if ( upToDate ) {
+		Manifest_MarkSkipped();
+		return;
+	}
+
+	for ( unsigned int i = job->index; i < job->length; ++i ) {
+		if ( strcmp( job->paths[ i ].output, output ) == 0 ) {
+			ProcessPackagePath( job->in, job->out, &job->paths[ i ] );
+			UpdatePackageManifest( job, &job->paths[ i ], false );
 		}
 	}
 }
 
-static void ProcessCopyPaths( const char* in, const char* out, const IOPath* paths, unsigned int length ) {
+static void ProcessPackagePaths( const char* in, const char* out, const IOPath* paths, unsigned int length ) {
+	JobCounter counter = JOB_COUNTER_INIT;
+	PathJob* jobs = u_alloc( length, sizeof( PathJob ), true );
 	for ( unsigned int i = 0; i < length; ++i ) {
-		char output_path[PL_SYSTEM_MAX_PATH];
-		snprintf( output_path, sizeof( output_path ), "%s%s", out, paths[ i ].output );
-
-		// Fudge the path if it's one of the audio tracks
-		char* p = strstr( output_path, "sku1/" );
-		if ( p != NULL ) {
-			strncpy( p, region_idents[ version_info.region ], 3 );
-			memmove( p + 3, p + 4, strlen( p + 4 ) + 1 );
+		bool first = true;
+		for ( unsigned int j = 0; j < i; ++j ) {
+			if ( strcmp( paths[ j ].output, paths[ i ].output ) == 0 ) {
+				first = false;
+				break;
+			}
 		}
 
-		if ( !plCreatePath( output_path ) ) {
-			LogWarn( "Failed to create path, \"%s\" (%s)!\n", output_path, plGetError() );
+		if ( !first ) {
 			continue;
 		}
 
-		strncat( output_path, plGetFileName( paths[ i ].input ), sizeof( output_path ) - strlen( output_path ) - 1 );
-		pl_strtolower( output_path );
+		jobs[ i ] = ( PathJob ) { in, out, paths, length, i };
+		Jobs_Submit( ProcessPackageGroupJob, &jobs[ i ], &counter );
+	}
+
+	Jobs_Wait( &counter );
+	u_free( jobs );
+}
+
+static void ProcessCopyPathJob( void* data ) {
+	const PathJob* job = data;
+	const IOPath* path = &job->paths[ job->index ];
+
+	char output_path[PL_SYSTEM_MAX_PATH];
+	snprintf( output_path, sizeof( output_path ), "%s%s", job->out, path->output );
+
+	// Fudge the path if it's one of the audio tracks
+	char* p = strstr( output_path, "sku1/" );
+	if ( p != NULL ) {
+		strncpy( p, region_idents[ version_info.region ], 3 );
+		memmove( p + 3, p + 4, strlen( p + 4 ) + 1 );
+	}
+
+	if ( !plCreatePath( output_path ) ) {
+		LogWarn( "Failed to create path, \"%s\" (%s)!\n", output_path, plGetError() );
+		return;
+	}
+
+	strncat( output_path, plGetFileName( path->input ), sizeof( output_path ) - strlen( output_path ) - 1 );
+	pl_strtolower( output_path );
+
+	char input_path[PL_SYSTEM_MAX_PATH];
+	snprintf( input_path, sizeof( input_path ), "%s%s", job->in, path->input );
+
+	char key[PL_SYSTEM_MAX_PATH];
+	snprintf( key, sizeof( key ), "copy:%s", path->input );
+	if ( Manifest_IsUpToDate( key, input_path, output_path ) ) {
+		Manifest_MarkSkipped();
+		return;
+	}
+
+	LogInfo( "Copying %s to %s\n", input_path, output_path );
+	plCopyFile( input_path, output_path );
+	if ( plFileExists( output_path ) ) {
+		Manifest_Update( key, input_path, output_path );
+	}
+}
 
-		char input_path[PL_SYSTEM_MAX_PATH];
-		snprintf( input_path, sizeof( input_path ), "%s%s", in, paths[ i ].input );
-		LogInfo( "Copying %s to %s\n", input_path, output_path );
-		plCopyFile( input_path, output_path );
+/* Every copy has a unique destination, so these can all go at once */
+static void ProcessCopyPaths( const char* in, const char* out, const IOPath* paths, unsigned int length ) {
+	JobCounter counter = JOB_COUNTER_INIT;
+	PathJob* jobs = u_alloc( length, sizeof( PathJob ), true );
+	for ( unsigned int i = 0; i < length; ++i ) {
+		jobs[ i ] = ( PathJob ) { in, out, paths, length, i };
+		Jobs_Submit( ProcessCopyPathJob, &jobs[ i ], &counter );
 	}
+
+	Jobs_Wait( &counter );
+	u_free( jobs );
+}
+
+/************************************************************/
+/* Archive Packing */
+
+static MafWriter* pack_writer = NULL;
+static size_t pack_root_length = 0;
+
+static void AddFileToArchive( const char* path ) {
+	Maf_AddFile( pack_writer, path + pack_root_length, path );
+}
+
+/**
+ * Packs everything extracted for the given mod into a single archive
+ * alongside its directory. The loose files are left in place, so the
+ * manifest can still tell what's up to date on the next run.
+ */
+static void PackModArchive( const char* mod ) {
+	char root[PL_SYSTEM_MAX_PATH];
+	snprintf( root, sizeof( root ), "%s/mods/%s", g_output_path, mod );
+	char archive_path[PL_SYSTEM_MAX_PATH];
+	snprintf( archive_path, sizeof( archive_path ), "%s/mods/%s." MAF_EXTENSION, g_output_path, mod );
+
+	pack_writer = Maf_CreateWriter();
+	pack_root_length = strlen( root );
+	plScanDirectory( root, NULL, AddFileToArchive, true );
+
+	LogInfo( "Packing \"%s\" into \"%s\"...\n", root, archive_path );
+	if ( !Maf_WriteFile( pack_writer, archive_path ) ) {
+		LogWarn( "Failed to pack \"%s\"!\n", root );
+	}
+
+	Maf_DestroyWriter( pack_writer );
+	pack_writer = NULL;
+}
+
+/************************************************************/
+/* Stage Timings */
+
+typedef struct StageTiming {
+	const char* name;
+	double start, seconds;
+	unsigned int skipped;
+} StageTiming;
+
+#define MAX_STAGES  8
+static StageTiming stage_timings[MAX_STAGES];
+static unsigned int num_stage_timings = 0;
+
+static double GetSeconds( void ) {
+	struct timespec ts;
+	timespec_get( &ts, TIME_UTC );
+	return ( double ) ts.tv_sec + ( double ) ts.tv_nsec / 1e9;
+}
+
+static void BeginStage( const char* name ) {
+	StageTiming* stage = &stage_timings[ num_stage_timings ];
+	stage->name = name;
+	stage->skipped = Manifest_GetNumSkipped();
+	stage->start = GetSeconds();
+}
+
+/* Saves the manifest as we go, so an interrupted run keeps its progress */
+static void EndStage( void ) {
+	StageTiming* stage = &stage_timings[ num_stage_timings ];
+	stage->seconds = GetSeconds() - stage->start;
+	stage->skipped = Manifest_GetNumSkipped() - stage->skipped;
+	if ( num_stage_timings < MAX_STAGES - 1 ) {
+		num_stage_timings++;
+	}
+
+	Manifest_Save();
+}
+
+static void PrintStageTimings( void ) {
+	double total = 0.0;
+	LogInfo( "Stage timings (%u worker threads):\n", Jobs_GetNumThreads() );
+	for ( unsigned int i = 0; i < num_stage_timings; ++i ) {
+		LogInfo( "  %-10s %8.2fs (%u up to date)\n",
+				 stage_timings[ i ].name, stage_timings[ i ].seconds, stage_timings[ i ].skipped );
+		total += stage_timings[ i ].seconds;
+	}
+	LogInfo( "  %-10s %8.2fs\n", "total", total );
 }
 
 int main( int argc, char** argv ) {
 	if ( argc == 1 ) {
 		printf( "Invalid number of arguments ...\n"
-				"  extractor <game_path> -<out_path>\n" );
+				"  extractor <game_path> -<out_path> [--pack]\n" );
 		return EXIT_SUCCESS;
 	}
 
@@ -590,7 +883,9 @@ int main( int argc, char** argv ) {
 #endif
 
 	for ( int i = 1; i < argc; ++i ) {
-		if ( argv[ i ][ 0 ] == '-' ) {
+		if ( strcmp( argv[ i ], "--pack" ) == 0 ) {
+			g_pack_output = true;
+		} else if ( argv[ i ][ 0 ] == '-' ) {
 			strncpy( g_output_path, argv[ i ] + 1, sizeof( g_output_path ) );
 		} else {
 			strncpy( g_input_path, argv[ i ], sizeof( g_input_path ) );
@@ -618,21 +913,49 @@ int main( int argc, char** argv ) {
 		Error( "Unsupported platform!\n" );
 	}
 
+	Jobs_Initialize( 0 );
+
+	char manifest_path[PL_SYSTEM_MAX_PATH];
+	snprintf( manifest_path, sizeof( manifest_path ), "%s/" MANIFEST_FILENAME, g_output_path );
+	Manifest_Load( manifest_path );
+
 	if ( version_info.platform == PLATFORM_PC || version_info.platform == PLATFORM_PC_DIGITAL ) {
+		BeginStage( "packages" );
 		ProcessPackagePaths( g_input_path, g_output_path, pc_package_paths, plArrayElements( pc_package_paths ) );
+		EndStage();
+
+		BeginStage( "copy" );
 		ProcessCopyPaths( g_input_path, g_output_path, pc_copy_paths, plArrayElements( pc_copy_paths ) );
+		EndStage();
 
 		if ( version_info.platform == PLATFORM_PC_DIGITAL ) {
 			// They've done us the honors for the digital version
+			BeginStage( "music" );
 			ProcessCopyPaths( g_input_path, g_output_path, pc_music_paths, plArrayElements( pc_music_paths ) );
+			EndStage();
 		} else {
 			// todo: rip the disc...
 		}
 	}
 
+	BeginStage( "merge" );
 	MergeTextureTargets();
+	EndStage();
 
+	BeginStage( "models" );
 	ConvertModelData();
+	EndStage();
+
+	if ( g_pack_output ) {
+		BeginStage( "pack" );
+		PackModArchive( "how" );
+		EndStage();
+	}
+
+	PrintStageTimings();
+
+	Jobs_Shutdown();
+	Manifest_Shutdown();
 
 	LogInfo( "Complete!\n" );
 	return EXIT_SUCCESS;
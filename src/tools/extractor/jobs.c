@@ -0,0 +1,192 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+
+#if defined( _WIN32 )
+#	include <windows.h>
+#else
+#	include <unistd.h>
+#endif
+
+#include "extractor.h"
+#include "jobs.h"
+
+#define JOBS_MAX_QUEUED     256
+#define JOBS_MAX_THREADS    32
+
+typedef struct Job {
+	JobFunction function;
+	void* data;
+	JobCounter* counter;
+} Job;
+
+static pthread_mutex_t jobMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobQueuedCondition = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t jobDoneCondition = PTHREAD_COND_INITIALIZER;
+
+static Job jobQueue[JOBS_MAX_QUEUED];
+static unsigned int jobQueueHead = 0;
+static unsigned int jobQueueCount = 0;
+
+static pthread_t jobThreads[JOBS_MAX_THREADS];
+static unsigned int numJobThreads = 0;
+static bool jobsShuttingDown = false;
+
+/* Must be called with the mutex held */
+static bool Jobs_Pop( Job* job ) {
+	if ( jobQueueCount == 0 ) {
+		return false;
+	}
+
+	*job = jobQueue[ jobQueueHead ];
+	jobQueueHead = ( jobQueueHead + 1 ) % JOBS_MAX_QUEUED;
+	jobQueueCount--;
+	return true;
+}
+
+static void Jobs_Run( Job* job ) {
+	job->function( job->data );
+
+	pthread_mutex_lock( &jobMutex );
+	if ( job->counter != NULL ) {
+		job->counter->pending--;
+	}
+	pthread_cond_broadcast( &jobDoneCondition );
+	pthread_mutex_unlock( &jobMutex );
+}
+
+static void* Jobs_WorkerThread( void* arg ) {
+	u_unused( arg );
+
+	pthread_mutex_lock( &jobMutex );
+	for ( ;; ) {
+		Job job;
+		if ( Jobs_Pop( &job ) ) {
+			pthread_mutex_unlock( &jobMutex );
+			Jobs_Run( &job );
+			pthread_mutex_lock( &jobMutex );
+			continue;
+		}
+
+		if ( jobsShuttingDown ) {
+			break;
+		}
+
+		pthread_cond_wait( &jobQueuedCondition, &jobMutex );
+	}
+	pthread_mutex_unlock( &jobMutex );
+
+	u_scratch_shutdown();
+	return NULL;
+}
+
+static unsigned int Jobs_GetNumProcessors( void ) {
+#if defined( _WIN32 )
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return ( unsigned int ) info.dwNumberOfProcessors;
+#else
+	long num = sysconf( _SC_NPROCESSORS_ONLN );
+	return ( num > 0 ) ? ( unsigned int ) num : 1;
+#endif
+}
+
+/**
+ * Starts up the worker threads. Pass 0 to use one less than the number
+ * of processors, since the main thread helps out while it waits.
+ */
+void Jobs_Initialize( unsigned int num_threads ) {
+	if ( num_threads == 0 ) {
+		num_threads = Jobs_GetNumProcessors() - 1;
+	}
+	if ( num_threads > JOBS_MAX_THREADS ) {
+		num_threads = JOBS_MAX_THREADS;
+	}
+
+	jobsShuttingDown = false;
+	for ( numJobThreads = 0; numJobThreads < num_threads; ++numJobThreads ) {
+		if ( pthread_create( &jobThreads[ numJobThreads ], NULL, Jobs_WorkerThread, NULL ) != 0 ) {
+			LogWarn( "Failed to create worker thread, continuing with %u!\n", numJobThreads );
+			break;
+		}
+	}
+}
+
+/**
+ * Runs anything that's left and then stops the worker threads.
+ */
+void Jobs_Shutdown( void ) {
+	pthread_mutex_lock( &jobMutex );
+	jobsShuttingDown = true;
+	pthread_cond_broadcast( &jobQueuedCondition );
+	pthread_mutex_unlock( &jobMutex );
+
+	for ( unsigned int i = 0; i < numJobThreads; ++i ) {
+		pthread_join( jobThreads[ i ], NULL );
+	}
+	numJobThreads = 0;
+}
+
+unsigned int Jobs_GetNumThreads( void ) {
+	return numJobThreads;
+}
+
+/**
+ * Queues the given function to be run on a worker. The counter, if
+ * provided, is incremented now and decremented once the job is done.
+ */
+void Jobs_Submit( JobFunction function, void* data, JobCounter* counter ) {
+	Job job = { function, data, counter };
+
+	pthread_mutex_lock( &jobMutex );
+	if ( counter != NULL ) {
+		counter->pending++;
+	}
+
+	// Nowhere to put it, so do it ourselves
+	if ( numJobThreads == 0 || jobQueueCount == JOBS_MAX_QUEUED ) {
+		pthread_mutex_unlock( &jobMutex );
+		Jobs_Run( &job );
+		return;
+	}
+
+	jobQueue[ ( jobQueueHead + jobQueueCount ) % JOBS_MAX_QUEUED ] = job;
+	jobQueueCount++;
+	pthread_cond_signal( &jobQueuedCondition );
+	pthread_mutex_unlock( &jobMutex );
+}
+
+/**
+ * Blocks until everything submitted against the counter is done,
+ * running any queued jobs in the meantime.
+ */
+void Jobs_Wait( JobCounter* counter ) {
+	pthread_mutex_lock( &jobMutex );
+	while ( counter->pending > 0 ) {
+		Job job;
+		if ( Jobs_Pop( &job ) ) {
+			pthread_mutex_unlock( &jobMutex );
+			Jobs_Run( &job );
+			pthread_mutex_lock( &jobMutex );
+			continue;
+		}
+
+		pthread_cond_wait( &jobDoneCondition, &jobMutex );
+	}
+	pthread_mutex_unlock( &jobMutex );
+}
@@ -0,0 +1,43 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Job Pool
+ *
+ * Fixed pool of worker threads, fed through a bounded
+ * queue. If the queue is full, the job is run by
+ * whoever submitted it instead, so memory use stays
+ * bounded and nested submissions can't deadlock.
+ * Anyone waiting on a counter helps run queued jobs
+ * until it reaches zero.
+ */
+
+typedef void (*JobFunction)(void *data);
+
+typedef struct JobCounter {
+  unsigned int pending;
+} JobCounter;
+#define JOB_COUNTER_INIT { 0 }
+
+void Jobs_Initialize(unsigned int num_threads);
+void Jobs_Shutdown(void);
+
+unsigned int Jobs_GetNumThreads(void);
+
+void Jobs_Submit(JobFunction function, void *data, JobCounter *counter);
+void Jobs_Wait(JobCounter *counter);
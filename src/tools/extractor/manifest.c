@@ -0,0 +1,300 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "extractor.h"
+#include "manifest.h"
+
+#define MANIFEST_VERSION    1
+#define MANIFEST_READ_SIZE  ( 64 * 1024 )
+
+typedef struct ManifestEntry {
+	char* key;
+	char* output;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t hash;
+} ManifestEntry;
+
+static pthread_mutex_t manifestMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char manifestPath[PL_SYSTEM_MAX_PATH];
+
+/* Open addressing, keyed on the hash of the entry's key */
+static ManifestEntry* manifestEntries = NULL;
+static unsigned int manifestCapacity = 0;
+static unsigned int numManifestEntries = 0;
+
+static unsigned int numSkipped = 0;
+
+static char* Manifest_CopyString( const char* string ) {
+	char* copy = u_alloc( strlen( string ) + 1, 1, true );
+	strcpy( copy, string );
+	return copy;
+}
+
+/* Must be called with the mutex held */
+static ManifestEntry* Manifest_FindSlot( const char* key ) {
+	unsigned int mask = manifestCapacity - 1;
+	unsigned int i = u_hash( key, strlen( key ), U_HASH_SEED ) & mask;
+	while ( manifestEntries[ i ].key != NULL && strcmp( manifestEntries[ i ].key, key ) != 0 ) {
+		i = ( i + 1 ) & mask;
+	}
+	return &manifestEntries[ i ];
+}
+
+static void Manifest_Grow( void ) {
+	ManifestEntry* oldEntries = manifestEntries;
+	unsigned int oldCapacity = manifestCapacity;
+
+	manifestCapacity = ( oldCapacity == 0 ) ? 4096 : oldCapacity * 2;
+	manifestEntries = u_alloc( manifestCapacity, sizeof( ManifestEntry ), true );
+	for ( unsigned int i = 0; i < oldCapacity; ++i ) {
+		if ( oldEntries[ i ].key != NULL ) {
+			*Manifest_FindSlot( oldEntries[ i ].key ) = oldEntries[ i ];
+		}
+	}
+
+	u_free( oldEntries );
+}
+
+/* Must be called with the mutex held, takes ownership of the strings */
+static void Manifest_Set( char* key, char* output, uint64_t size, int64_t mtime, uint32_t hash ) {
+	if ( ( numManifestEntries + 1 ) * 2 > manifestCapacity ) {
+		Manifest_Grow();
+	}
+
+	ManifestEntry* entry = Manifest_FindSlot( key );
+	if ( entry->key == NULL ) {
+		numManifestEntries++;
+	} else {
+		u_free( entry->key );
+		u_free( entry->output );
+	}
+
+	entry->key = key;
+	entry->output = output;
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->hash = hash;
+}
+
+static bool Manifest_StatFile( const char* path, uint64_t* size, int64_t* mtime ) {
+	struct stat buf;
+	if ( stat( path, &buf ) != 0 ) {
+		return false;
+	}
+
+	*size = ( uint64_t ) buf.st_size;
+	*mtime = ( int64_t ) buf.st_mtime;
+	return true;
+}
+
+static bool Manifest_HashFile( const char* path, uint32_t* hash ) {
+	FILE* fp = fopen( path, "rb" );
+	if ( fp == NULL ) {
+		return false;
+	}
+
+	UScratchMark mark = u_scratch_mark();
+	uint8_t* buf = u_scratch_alloc( MANIFEST_READ_SIZE );
+	*hash = U_HASH_SEED;
+	size_t length;
+	while ( ( length = fread( buf, 1, MANIFEST_READ_SIZE, fp ) ) > 0 ) {
+		*hash = u_hash( buf, length, *hash );
+	}
+	u_scratch_release( mark );
+
+	u_fclose( fp );
+	return true;
+}
+
+static bool Manifest_OutputExists( const char* output ) {
+	struct stat buf;
+	return plIsEmptyString( output ) || stat( output, &buf ) == 0;
+}
+
+/**
+ * Loads the manifest from the given path, if there is one.
+ */
+void Manifest_Load( const char* path ) {
+	snprintf( manifestPath, sizeof( manifestPath ), "%s", path );
+
+	FILE* fp = fopen( path, "r" );
+	if ( fp == NULL ) {
+		LogInfo( "No manifest found at \"%s\", extracting everything\n", path );
+		return;
+	}
+
+	unsigned int version;
+	if ( fscanf( fp, "OHEXM %u\n", &version ) != 1 || version != MANIFEST_VERSION ) {
+		LogWarn( "Unexpected manifest version in \"%s\", ignoring it!\n", path );
+		u_fclose( fp );
+		return;
+	}
+
+	/* key, size, modification time, hash and output, tab separated */
+	char line[PL_SYSTEM_MAX_PATH * 2 + 64];
+	pthread_mutex_lock( &manifestMutex );
+	while ( fgets( line, sizeof( line ), fp ) != NULL ) {
+		line[ strcspn( line, "\r\n" ) ] = '\0';
+
+		char* fields[5];
+		char* p = line;
+		unsigned int numFields = 0;
+		for ( ; numFields < 5; ++numFields ) {
+			fields[ numFields ] = p;
+			p = strchr( p, '\t' );
+			if ( p == NULL ) {
+				numFields++;
+				break;
+			}
+			*p++ = '\0';
+		}
+
+		if ( numFields != 5 || plIsEmptyString( fields[ 0 ] ) ) {
+			continue;
+		}
+
+		Manifest_Set( Manifest_CopyString( fields[ 0 ] ), Manifest_CopyString( fields[ 4 ] ),
+					  strtoull( fields[ 1 ], NULL, 10 ),
+					  strtoll( fields[ 2 ], NULL, 10 ),
+					  ( uint32_t ) strtoul( fields[ 3 ], NULL, 16 ) );
+	}
+	LogInfo( "Loaded %u entries from \"%s\"\n", numManifestEntries, path );
+	pthread_mutex_unlock( &manifestMutex );
+
+	u_fclose( fp );
+}
+
+/**
+ * Writes the manifest back out. It's written to a temporary file
+ * first, so an interrupted run can't leave a truncated manifest.
+ */
+void Manifest_Save( void ) {
+	if ( plIsEmptyString( manifestPath ) ) {
+		return;
+	}
+
+	char tmpPath[PL_SYSTEM_MAX_PATH];
+	snprintf( tmpPath, sizeof( tmpPath ), "%s.tmp", manifestPath );
+	FILE* fp = fopen( tmpPath, "w" );
+	if ( fp == NULL ) {
+		LogWarn( "Failed to write manifest, \"%s\"!\n", tmpPath );
+		return;
+	}
+
+	pthread_mutex_lock( &manifestMutex );
+	fprintf( fp, "OHEXM %u\n", MANIFEST_VERSION );
+	for ( unsigned int i = 0; i < manifestCapacity; ++i ) {
+		const ManifestEntry* entry = &manifestEntries[ i ];
+		if ( entry->key == NULL ) {
+			continue;
+		}
+
+		fprintf( fp, "%s\t%llu\t%lld\t%08x\t%s\n", entry->key,
+				 ( unsigned long long ) entry->size, ( long long ) entry->mtime, entry->hash, entry->output );
+	}
+	pthread_mutex_unlock( &manifestMutex );
+
+	u_fclose( fp );
+
+	remove( manifestPath );
+	if ( rename( tmpPath, manifestPath ) != 0 ) {
+		LogWarn( "Failed to replace manifest, \"%s\"!\n", manifestPath );
+	}
+}
+
+void Manifest_Shutdown( void ) {
+	pthread_mutex_lock( &manifestMutex );
+	for ( unsigned int i = 0; i < manifestCapacity; ++i ) {
+		u_free( manifestEntries[ i ].key );
+		u_free( manifestEntries[ i ].output );
+	}
+	u_free( manifestEntries );
+	manifestCapacity = numManifestEntries = 0;
+	pthread_mutex_unlock( &manifestMutex );
+}
+
+/**
+ * Returns true if the source matches what was recorded under the key
+ * and the output recorded alongside it still exists. The source is
+ * only hashed if its size matches but its modification time doesn't.
+ */
+bool Manifest_IsUpToDate( const char* key, const char* source, const char* output ) {
+	uint64_t size;
+	int64_t mtime;
+	if ( !Manifest_StatFile( source, &size, &mtime ) || !Manifest_OutputExists( output ) ) {
+		return false;
+	}
+
+	pthread_mutex_lock( &manifestMutex );
+	ManifestEntry* entry = ( manifestCapacity > 0 ) ? Manifest_FindSlot( key ) : NULL;
+	if ( entry == NULL || entry->key == NULL || entry->size != size || strcmp( entry->output, output ) != 0 ) {
+		pthread_mutex_unlock( &manifestMutex );
+		return false;
+	}
+
+	if ( entry->mtime == mtime ) {
+		pthread_mutex_unlock( &manifestMutex );
+		return true;
+	}
+
+	uint32_t recordedHash = entry->hash;
+	pthread_mutex_unlock( &manifestMutex );
+
+	// Only touched, e.g. copied from another install, so check the contents
+	uint32_t hash;
+	if ( !Manifest_HashFile( source, &hash ) || hash != recordedHash ) {
+		return false;
+	}
+
+	Manifest_Update( key, source, output );
+	return true;
+}
+
+/**
+ * Records the current state of the source under the given key,
+ * once whatever it produces has been written out.
+ */
+void Manifest_Update( const char* key, const char* source, const char* output ) {
+	uint64_t size;
+	int64_t mtime;
+	uint32_t hash;
+	if ( !Manifest_StatFile( source, &size, &mtime ) || !Manifest_HashFile( source, &hash ) ) {
+		return;
+	}
+
+	pthread_mutex_lock( &manifestMutex );
+	Manifest_Set( Manifest_CopyString( key ), Manifest_CopyString( output ), size, mtime, hash );
+	pthread_mutex_unlock( &manifestMutex );
+}
+
+void Manifest_MarkSkipped( void ) {
+	pthread_mutex_lock( &manifestMutex );
+	numSkipped++;
+	pthread_mutex_unlock( &manifestMutex );
+}
+
+unsigned int Manifest_GetNumSkipped( void ) {
+	pthread_mutex_lock( &manifestMutex );
+	unsigned int num = numSkipped;
+	pthread_mutex_unlock( &manifestMutex );
+	return num;
+}
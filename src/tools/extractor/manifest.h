@@ -0,0 +1,39 @@
+/* OpenHoW
+ * Copyright (C) 2017-2020 Mark Sowden <markelswo@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/* Manifest
+ *
+ * Records the size, modification time and hash of every
+ * source the extractor has processed, along with what
+ * it produced, so later runs can skip anything that
+ * hasn't changed. Delete the manifest to force a full
+ * extraction. Safe to use from the job workers.
+ */
+
+#define MANIFEST_FILENAME "extractor.manifest"
+
+void Manifest_Load(const char *path);
+void Manifest_Save(void);
+void Manifest_Shutdown(void);
+
+bool Manifest_IsUpToDate(const char *key, const char *source, const char *output);
+void Manifest_Update(const char *key, const char *source, const char *output);
+
+void Manifest_MarkSkipped(void);
+unsigned int Manifest_GetNumSkipped(void);